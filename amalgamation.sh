@@ -31,6 +31,7 @@ DEMOCPP="amalgamation_demo.cpp"
 ALL_PUBLIC_H="
 $SCRIPTPATH/include/roaring/roaring_version.h
 $SCRIPTPATH/include/roaring/roaring_types.h
+$SCRIPTPATH/include/roaring/memory.h
 $SCRIPTPATH/include/roaring/roaring.h
 "
 
@@ -48,6 +49,7 @@ $SCRIPTPATH/cpp/roaring64map.hh
 ALL_PRIVATE_H="
 $SCRIPTPATH/include/roaring/isadetection.h
 $SCRIPTPATH/include/roaring/portability.h
+$SCRIPTPATH/include/roaring/memory_pool.h
 $SCRIPTPATH/include/roaring/containers/perfparameters.h
 $SCRIPTPATH/include/roaring/containers/container_defs.h
 $SCRIPTPATH/include/roaring/array_util.h
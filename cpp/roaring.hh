@@ -10,6 +10,7 @@ A C++ header for Roaring Bitmaps.
 #include <new>
 #include <stdexcept>
 #include <string>
+#include <type_traits>
 
 #if !defined(ROARING_EXCEPTIONS)
 // Note that __cpp_exceptions is required by C++98 and we require C++11 and better.
@@ -91,7 +92,7 @@ class Roaring {
      * The pointer to the C struct will be invalid after the call.
      */
     explicit Roaring(roaring_bitmap_t *s) noexcept : roaring (*s) {
-        free(s);  // deallocate the passed-in pointer
+        roaring_free(s);  // deallocate the passed-in pointer
     }
 
     /**
@@ -137,6 +138,17 @@ class Roaring {
         api::roaring_bitmap_add_many(&roaring, n_args, vals);
     }
 
+    typedef api::roaring_bulk_context_t BulkContext;
+
+    /**
+     * Add value x, reusing the container cached in the context when x has
+     * the same 16 high bits as the previous value. The context must be
+     * value-initialized (`BulkContext ctx{};`) and only used with this bitmap.
+     */
+    void addBulk(BulkContext &context, uint32_t x) {
+        api::roaring_bitmap_add_bulk(&roaring, &context, x);
+    }
+
     /**
      * Remove value x
      *
@@ -170,6 +182,23 @@ class Roaring {
         return api::roaring_bitmap_contains(&roaring, x);
     }
 
+    /**
+     * Check if value x is present, reusing the container cached in the
+     * context (see addBulk).
+     */
+    bool containsBulk(BulkContext &context, uint32_t x) const {
+        return api::roaring_bitmap_contains_bulk(&roaring, &context, x);
+    }
+
+    /**
+     * Check which of the n_args values are present: bit i of out_bits (room
+     * for (n_args + 63) / 64 words) is set if vals[i] is in the bitmap.
+     */
+    void containsMany(size_t n_args, const uint32_t *vals,
+                      uint64_t *out_bits) const {
+        api::roaring_bitmap_contains_many(&roaring, n_args, vals, out_bits);
+    }
+
     /**
     * Check if all values from x (included) to y (excluded) are present
     */
@@ -353,6 +382,47 @@ class Roaring {
         api::roaring_iterate(&roaring, iterator, ptr);
     }
 
+    /**
+     * Iterate over the bitmap elements, calling f(value) for each of them in
+     * increasing order while it returns true. Unlike the function pointer
+     * version, f can be inlined: the values are decoded by blocks (see
+     * roaring_iterate_batch) and f is called from a plain loop.
+     * Returns true if f returned true throughout, false otherwise or if
+     * memory is lacking.
+     */
+    template <typename Function>
+    bool iterate(Function &&f) const {
+        typedef typename std::remove_reference<Function>::type function_type;
+        return api::roaring_iterate_batch(
+            &roaring,
+            [](const uint32_t *values, size_t count, void *fptr) -> bool {
+                function_type &fn = *static_cast<function_type *>(fptr);
+                for (size_t k = 0; k < count; ++k) {
+                    if (!fn(values[k])) return false;
+                }
+                return true;
+            },
+            1024, const_cast<void *>(static_cast<const void *>(&f)));
+    }
+
+    /**
+     * Iterate over the bitmap elements by blocks of up to bufSize values,
+     * see roaring_iterate_batch.
+     */
+    bool iterateBatch(api::roaring_batch_iterator iterator, size_t bufSize,
+                      void *ptr) const {
+        return api::roaring_iterate_batch(&roaring, iterator, bufSize, ptr);
+    }
+
+    /**
+     * Calls visitor with a read-only view of each container's storage, see
+     * roaring_visit_containers.
+     */
+    bool visitContainers(api::roaring_container_visitor visitor,
+                         void *ptr) const {
+        return api::roaring_visit_containers(&roaring, visitor, ptr);
+    }
+
     /**
      * Selects the value at index rnk in the bitmap, where the smallest value
      * is at index 0.
@@ -617,13 +687,29 @@ class Roaring {
         return api::roaring_bitmap_get_copy_on_write(&roaring);
     }
 
+    /**
+     * Whether or not we keep an index of the cardinalities, which makes
+     * cardinality(), rank() and select() fast on large bitmaps (see
+     * roaring_bitmap_set_cardinality_index).
+     */
+    void setCardinalityIndex(bool val) {
+        api::roaring_bitmap_set_cardinality_index(&roaring, val);
+    }
+
+    /**
+     * Whether or not the index of the cardinalities is active.
+     */
+    bool getCardinalityIndex() const {
+        return api::roaring_bitmap_get_cardinality_index(&roaring);
+    }
+
     /**
      * computes the logical or (union) between "n" bitmaps (referenced by a
      * pointer).
      */
     static Roaring fastunion(size_t n, const Roaring **inputs) {
         const roaring_bitmap_t **x =
-            (const roaring_bitmap_t **)malloc(n * sizeof(roaring_bitmap_t *));
+            (const roaring_bitmap_t **)roaring_malloc(n * sizeof(roaring_bitmap_t *));
         if (x == NULL) {
             ROARING_TERMINATE("failed memory alloc in fastunion");
         }
@@ -631,11 +717,11 @@ class Roaring {
 
         roaring_bitmap_t *c_ans = api::roaring_bitmap_or_many(n, x);
         if (c_ans == NULL) {
-            free(x);
+            roaring_free(x);
             ROARING_TERMINATE("failed memory alloc in fastunion");
         }
         Roaring ans(c_ans);
-        free(x);
+        roaring_free(x);
         return ans;
     }
 
@@ -766,6 +852,114 @@ inline RoaringSetBitForwardIterator &Roaring::end() const {
     return e;
 }
 
+/**
+ * Goes through the values of the intersection of several bitmaps without
+ * computing it (see roaring_create_intersection_iterator). A default
+ * constructed iterator is exhausted and can serve as the end:
+ *
+ *     for (RoaringIntersectionIterator i(n, inputs);
+ *          i != RoaringIntersectionIterator(); ++i) {}
+ *
+ * The bitmaps must outlive the iterator and not be modified meanwhile.
+ */
+class RoaringIntersectionIterator final {
+   public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef uint32_t *pointer;
+    typedef uint32_t &reference_type;
+    typedef uint32_t value_type;
+    typedef int32_t difference_type;
+    typedef RoaringIntersectionIterator type_of_iterator;
+
+    RoaringIntersectionIterator() noexcept : i(nullptr) {}
+
+    RoaringIntersectionIterator(size_t n, const Roaring **inputs) {
+        const api::roaring_bitmap_t **x =
+            (const api::roaring_bitmap_t **)roaring_malloc(
+                (n + 1) * sizeof(api::roaring_bitmap_t *));
+        if (x == nullptr) {
+            ROARING_TERMINATE("failed memory alloc in intersection iterator");
+        }
+        for (size_t k = 0; k < n; ++k) x[k] = &inputs[k]->roaring;
+        i = api::roaring_create_intersection_iterator(n, x);
+        roaring_free(x);
+        if (i == nullptr) {
+            ROARING_TERMINATE("failed memory alloc in intersection iterator");
+        }
+    }
+
+    RoaringIntersectionIterator(const RoaringIntersectionIterator &o)
+        : i(nullptr) {
+        if (o.i != nullptr) {
+            i = api::roaring_copy_intersection_iterator(o.i);
+            if (i == nullptr) {
+                ROARING_TERMINATE("failed memory alloc in intersection iterator");
+            }
+        }
+    }
+
+    RoaringIntersectionIterator(RoaringIntersectionIterator &&o) noexcept
+        : i(o.i) {
+        o.i = nullptr;
+    }
+
+    RoaringIntersectionIterator &operator=(RoaringIntersectionIterator o) {
+        std::swap(i, o.i);
+        return *this;
+    }
+
+    ~RoaringIntersectionIterator() {
+        if (i != nullptr) api::roaring_free_intersection_iterator(i);
+    }
+
+    bool hasValue() const { return i != nullptr && i->has_value; }
+
+    /**
+     * Provides the current value of the intersection.
+     */
+    value_type operator*() const { return i->current_value; }
+
+    /**
+    * Move the iterator to the first value >= val.
+    */
+    void equalorlarger(uint32_t val) {
+        if (i != nullptr) {
+            api::roaring_move_intersection_iterator_equalorlarger(i, val);
+        }
+    }
+
+    /**
+     * Reads up to count values into buf, returns the number read.
+     */
+    uint32_t read(uint32_t *buf, uint32_t count) {
+        if (i == nullptr) return 0;
+        return api::roaring_read_intersection_iterator(i, buf, count);
+    }
+
+    type_of_iterator &operator++() {  // ++i, must returned inc. value
+        if (i != nullptr) api::roaring_advance_intersection_iterator(i);
+        return *this;
+    }
+
+    type_of_iterator operator++(int) {  // i++, must return orig. value
+        RoaringIntersectionIterator orig(*this);
+        ++*this;
+        return orig;
+    }
+
+    bool operator==(const RoaringIntersectionIterator &o) const {
+        if (!hasValue() || !o.hasValue()) return hasValue() == o.hasValue();
+        return **this == *o;
+    }
+
+    bool operator!=(const RoaringIntersectionIterator &o) const {
+        return !(*this == o);
+    }
+
+   private:
+    api::roaring_intersection_iterator_t *i;
+};
+
 }  // namespace roaring
 
 #endif /* INCLUDE_ROARING_HH_ */
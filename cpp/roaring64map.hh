@@ -61,17 +61,24 @@ class Roaring64Map {
 
     Roaring64Map(const Roaring64Map& r)
       : roarings(r.roarings),
-        copyOnWrite(r.copyOnWrite) { }
+        copyOnWrite(r.copyOnWrite) {
+        // the index is not copied with the 32-bit bitmaps
+        if (r.cardinalityIndex) setCardinalityIndex(true);
+    }
 
     Roaring64Map(Roaring64Map&& r)
       : roarings(r.roarings),
-        copyOnWrite(r.copyOnWrite) { }
+        copyOnWrite(r.copyOnWrite) {
+        if (r.cardinalityIndex) setCardinalityIndex(true);
+    }
 
 	/**
 	 * Assignment operator.
 	 */
 	Roaring64Map &operator=(const Roaring64Map &r) {
 		roarings = r.roarings;
+		totalCardinality = unknownCardinality;
+		if (cardinalityIndex) setCardinalityIndex(true);
 		return *this;
 	}
 
@@ -94,10 +101,19 @@ class Roaring64Map {
      *
      */
     void add(uint32_t x) {
+        if (cardinalityIndex) {
+            // keeps the cached cardinality up to date
+            addChecked(x);
+            return;
+        }
         roarings[0].add(x);
         roarings[0].setCopyOnWrite(copyOnWrite);
     }
     void add(uint64_t x) {
+        if (cardinalityIndex) {
+            addChecked(x);
+            return;
+        }
         roarings[highBytes(x)].add(lowBytes(x));
         roarings[highBytes(x)].setCopyOnWrite(copyOnWrite);
     }
@@ -109,11 +125,15 @@ class Roaring64Map {
     bool addChecked(uint32_t x) {
         bool result = roarings[0].addChecked(x);
         roarings[0].setCopyOnWrite(copyOnWrite);
+        if (cardinalityIndex) roarings[0].setCardinalityIndex(true);
+        if (result) adjustCardinality(1);
         return result;
     }
     bool addChecked(uint64_t x) {
         bool result = roarings[highBytes(x)].addChecked(lowBytes(x));
         roarings[highBytes(x)].setCopyOnWrite(copyOnWrite);
+        if (cardinalityIndex) roarings[highBytes(x)].setCardinalityIndex(true);
+        if (result) adjustCardinality(1);
         return result;
     }
 
@@ -122,24 +142,29 @@ class Roaring64Map {
      *
      */
     void addMany(size_t n_args, const uint32_t *vals) {
-        for (size_t lcv = 0; lcv < n_args; lcv++) {
-            roarings[0].add(vals[lcv]);
-            roarings[0].setCopyOnWrite(copyOnWrite);
-        }
+        for (size_t lcv = 0; lcv < n_args; lcv++) add(vals[lcv]);
     }
     void addMany(size_t n_args, const uint64_t *vals) {
-        for (size_t lcv = 0; lcv < n_args; lcv++) {
-            roarings[highBytes(vals[lcv])].add(lowBytes(vals[lcv]));
-            roarings[highBytes(vals[lcv])].setCopyOnWrite(copyOnWrite);
-        }
+        for (size_t lcv = 0; lcv < n_args; lcv++) add(vals[lcv]);
     }
 
     /**
      * Remove value x
      *
      */
-    void remove(uint32_t x) { roarings[0].remove(x); }
+    void remove(uint32_t x) {
+        if (cardinalityIndex) {
+            // keeps the cached cardinality up to date
+            removeChecked(x);
+            return;
+        }
+        roarings[0].remove(x);
+    }
     void remove(uint64_t x) {
+        if (cardinalityIndex) {
+            removeChecked(x);
+            return;
+        }
         auto roaring_iter = roarings.find(highBytes(x));
         if (roaring_iter != roarings.cend())
             roaring_iter->second.remove(lowBytes(x));
@@ -150,13 +175,16 @@ class Roaring64Map {
      * Returns true if a new value was removed, false if the value was not existing.
      */
     bool removeChecked(uint32_t x) {
-        return roarings[0].removeChecked(x);
+        bool result = roarings[0].removeChecked(x);
+        if (result) adjustCardinality(-1);
+        return result;
     }
     bool removeChecked(uint64_t x) {
         auto roaring_iter = roarings.find(highBytes(x));
-        if (roaring_iter != roarings.cend())
-            return roaring_iter->second.removeChecked(lowBytes(x));
-        return false;
+        if (roaring_iter == roarings.cend()) return false;
+        bool result = roaring_iter->second.removeChecked(lowBytes(x));
+        if (result) adjustCardinality(-1);
+        return result;
     }
 
 	/**
@@ -164,6 +192,7 @@ class Roaring64Map {
      */
 	void clear() {
 		roarings.clear();
+		totalCardinality = unknownCardinality;
 	}
 
     /**
@@ -219,6 +248,7 @@ class Roaring64Map {
      * modified.
      */
     Roaring64Map &operator&=(const Roaring64Map &r) {
+        totalCardinality = unknownCardinality;
         for (auto &map_entry : roarings) {
             if (r.roarings.count(map_entry.first) == 1)
                 map_entry.second &= r.roarings.at(map_entry.first);
@@ -235,6 +265,7 @@ class Roaring64Map {
      * modified.
      */
     Roaring64Map &operator-=(const Roaring64Map &r) {
+        totalCardinality = unknownCardinality;
         for (auto &map_entry : roarings) {
             if (r.roarings.count(map_entry.first) == 1)
                 map_entry.second -= r.roarings.at(map_entry.first);
@@ -250,10 +281,14 @@ class Roaring64Map {
      * See also the fastunion function to aggregate many bitmaps more quickly.
      */
     Roaring64Map &operator|=(const Roaring64Map &r) {
+        totalCardinality = unknownCardinality;
         for (const auto &map_entry : r.roarings) {
             if (roarings.count(map_entry.first) == 0) {
                 roarings[map_entry.first] = map_entry.second;
                 roarings[map_entry.first].setCopyOnWrite(copyOnWrite);
+                if (cardinalityIndex) {
+                    roarings[map_entry.first].setCardinalityIndex(true);
+                }
             } else
                 roarings[map_entry.first] |= map_entry.second;
         }
@@ -267,10 +302,14 @@ class Roaring64Map {
      * modified.
      */
     Roaring64Map &operator^=(const Roaring64Map &r) {
+        totalCardinality = unknownCardinality;
         for (const auto &map_entry : r.roarings) {
             if (roarings.count(map_entry.first) == 0) {
                 roarings[map_entry.first] = map_entry.second;
                 roarings[map_entry.first].setCopyOnWrite(copyOnWrite);
+                if (cardinalityIndex) {
+                    roarings[map_entry.first].setCardinalityIndex(true);
+                }
             } else
                 roarings[map_entry.first] ^= map_entry.second;
         }
@@ -280,7 +319,10 @@ class Roaring64Map {
     /**
      * Exchange the content of this bitmap with another.
      */
-    void swap(Roaring64Map &r) { roarings.swap(r.roarings); }
+    void swap(Roaring64Map &r) {
+        roarings.swap(r.roarings);
+        totalCardinality = r.totalCardinality = unknownCardinality;
+    }
 
     /**
      * Get the cardinality of the bitmap (number of elements).
@@ -298,12 +340,15 @@ class Roaring64Map {
                               "unable to represent in a 64-bit integer");
 #endif
         }
-        return std::accumulate(
+        if (totalCardinality != unknownCardinality) return totalCardinality;
+        const uint64_t total = std::accumulate(
             roarings.cbegin(), roarings.cend(), (uint64_t)0,
             [](uint64_t previous,
                const std::pair<uint32_t, Roaring> &map_entry) {
                 return previous + map_entry.second.cardinality();
             });
+        if (cardinalityIndex) totalCardinality = total;
+        return total;
     }
 
     /**
@@ -441,6 +486,7 @@ class Roaring64Map {
         uint32_t start_low = lowBytes(range_start);
         uint32_t end_high = highBytes(range_end);
         uint32_t end_low = lowBytes(range_end);
+        totalCardinality = unknownCardinality;
 
         if (start_high == end_high) {
             roarings[start_high].flip(start_low, end_low);
@@ -450,17 +496,22 @@ class Roaring64Map {
         // to avoid a clash with the Windows.h header under Windows
         roarings[start_high].flip(start_low,
                                   (std::numeric_limits<uint32_t>::max)());
+        if (cardinalityIndex) roarings[start_high].setCardinalityIndex(true);
         roarings[start_high++].setCopyOnWrite(copyOnWrite);
 
         for (; start_high <= highBytes(range_end) - 1; ++start_high) {
             roarings[start_high].flip((std::numeric_limits<uint32_t>::min)(),
                                       (std::numeric_limits<uint32_t>::max)());
             roarings[start_high].setCopyOnWrite(copyOnWrite);
+            if (cardinalityIndex) {
+                roarings[start_high].setCardinalityIndex(true);
+            }
         }
 
         roarings[start_high].flip((std::numeric_limits<uint32_t>::min)(),
                                   end_low);
         roarings[start_high].setCopyOnWrite(copyOnWrite);
+        if (cardinalityIndex) roarings[start_high].setCardinalityIndex(true);
     }
 
     /**
@@ -829,6 +880,26 @@ class Roaring64Map {
      */
     bool getCopyOnWrite() const { return copyOnWrite; }
 
+    /**
+     * Whether or not the 32-bit bitmaps keep an index of their cardinalities
+     * (see Roaring::setCardinalityIndex). The total cardinality is then
+     * cached as well, and kept up to date by the insertions and removals of
+     * values.
+     */
+    void setCardinalityIndex(bool val) {
+        cardinalityIndex = val;
+        totalCardinality = unknownCardinality;
+        std::for_each(roarings.begin(), roarings.end(),
+                      [=](std::pair<const uint32_t, Roaring> &map_entry) {
+                          map_entry.second.setCardinalityIndex(val);
+                      });
+    }
+
+    /**
+     * Whether or not the index of the cardinalities is active.
+     */
+    bool getCardinalityIndex() const { return cardinalityIndex; }
+
     /**
      * computes the logical or (union) between "n" bitmaps (referenced by a
      * pointer).
@@ -870,6 +941,16 @@ class Roaring64Map {
    private:
     std::map<uint32_t, Roaring> roarings{}; // The empty constructor silences warnings from pedantic static analyzers.
     bool copyOnWrite{false};
+    bool cardinalityIndex{false};
+    // cached value of cardinality(), only kept with cardinalityIndex
+    static const uint64_t unknownCardinality =
+        (std::numeric_limits<uint64_t>::max)();
+    mutable uint64_t totalCardinality{unknownCardinality};
+    void adjustCardinality(int64_t delta) {
+        if (totalCardinality != unknownCardinality) {
+            totalCardinality += (uint64_t)delta;
+        }
+    }
     static uint32_t highBytes(const uint64_t in) { return uint32_t(in >> 32); }
     static uint32_t lowBytes(const uint64_t in) { return uint32_t(in); }
     static uint64_t uniteBytes(const uint32_t highBytes,
@@ -126,7 +126,7 @@ int32_t intersect_vector16(const uint16_t *__restrict__ A, size_t s_a,
                            uint16_t *C);
 
 /**
- * Compute the cardinality of the intersection using SSE4 instructions
+ * Compute the cardinality of the intersection using SSE4 (or NEON) instructions
  */
 int32_t intersect_vector16_cardinality(const uint16_t *__restrict__ A,
                                        size_t s_a,
@@ -203,20 +203,20 @@ size_t union_uint32(const uint32_t *set_1, size_t size_1, const uint32_t *set_2,
                     size_t size_2, uint32_t *buffer);
 
 /**
- * A fast SSE-based union function.
+ * A fast SSE-based (or NEON-based) union function.
  */
 uint32_t union_vector16(const uint16_t *__restrict__ set_1, uint32_t size_1,
                         const uint16_t *__restrict__ set_2, uint32_t size_2,
                         uint16_t *__restrict__ buffer);
 /**
- * A fast SSE-based XOR function.
+ * A fast SSE-based (or NEON-based) XOR function.
  */
 uint32_t xor_vector16(const uint16_t *__restrict__ array1, uint32_t length1,
                       const uint16_t *__restrict__ array2, uint32_t length2,
                       uint16_t *__restrict__ output);
 
 /**
- * A fast SSE-based difference function.
+ * A fast SSE-based (or NEON-based) difference function.
  */
 int32_t difference_vector16(const uint16_t *__restrict__ A, size_t s_a,
                             const uint16_t *__restrict__ B, size_t s_b,
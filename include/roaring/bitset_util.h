@@ -180,12 +180,26 @@ size_t bitset_extract_setbits(const uint64_t *words, size_t length,
  *bitset_extract_setbits_uint16
  * when the density of the bitset is high.
  *
- * This function uses SSE decoding.
+ * This function uses SSE decoding (NEON on ARM).
  */
 size_t bitset_extract_setbits_sse_uint16(const uint64_t *words, size_t length,
                                          uint16_t *out, size_t outcapacity,
                                          uint16_t base);
 
+#if CROARING_COMPILER_SUPPORTS_AVX512
+/*
+ * Same as bitset_extract_setbits_uint16, using the AVX-512 VBMI2 compress
+ * instruction for the words with many bits set (see
+ * AVX512_EXTRACT_MIN_WORD_CARDINALITY).
+ *
+ * Check croaring_avx512() before calling it: bitset_extract_setbits_uint16
+ * does so and calls it when it can.
+ */
+size_t bitset_extract_setbits_avx512_uint16(const uint64_t *words,
+                                            size_t length, uint16_t *out,
+                                            uint16_t base);
+#endif
+
 /*
  * Given a bitset containing "length" 64-bit words, write out the position
  * of all the set bits to "out",  values start at "base"
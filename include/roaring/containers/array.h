@@ -415,6 +415,16 @@ inline int array_container_index_equalorlarger(const array_container_t *arr, uin
     }
 }
 
+/*
+ * Adds 'offset' to all values: those that stay below 1<<16 go to a new
+ * container written to *loc, the others (minus 1<<16) to a new container
+ * written to *hic. Either pointer may be NULL if that part is not wanted.
+ * Nothing is written for an empty part. Assumes offset > 0.
+ */
+void array_container_offset(const array_container_t *c,
+                            container_t **loc, container_t **hic,
+                            uint16_t offset);
+
 /*
  * Adds all values in range [min,max] using hint:
  *   nvals_less is the number of array values less than $min
@@ -366,6 +366,32 @@ int bitset_container_xor_nocard(const bitset_container_t *src_1,
                                 const bitset_container_t *src_2,
                                 bitset_container_t *dst);
 
+/* Counts, for every value, how many of the `count' bitsets in `srcs' contain
+ * it, and writes the low `nslices' (1 to 64) bits of the counts as bit slices:
+ * bit s of the counts of the values in word w goes to
+ * slices[s * BITSET_CONTAINER_SIZE_IN_WORDS + w]. Slice 0 is thus the odd
+ * parity (exclusive or) of the inputs and slice 1 the "twos" bit. The first
+ * slice may be the words of one of the inputs. */
+void bitset_container_count_many(const bitset_container_t **srcs,
+                                 size_t count, uint64_t *slices,
+                                 size_t nslices);
+
+/* Same as bitset_container_count_many, but adds the counts to those already
+ * held by `slices' (modulo 2^nslices). No slice may be one of the inputs. */
+void bitset_container_count_many_add(const bitset_container_t **srcs,
+                                     size_t count, uint64_t *slices,
+                                     size_t nslices);
+
+/* Computes the exclusive or of the `count' (at least one) bitsets in `srcs'
+ * into `dst' and return the cardinality. Each input is read once and `dst' is
+ * written once; `dst' may be one of the inputs. */
+int bitset_container_xor_many(const bitset_container_t **srcs, size_t count,
+                              bitset_container_t *dst);
+
+/* Same as bitset_container_xor_many, but does not update the cardinality. */
+int bitset_container_xor_many_nocard(const bitset_container_t **srcs,
+                                     size_t count, bitset_container_t *dst);
+
 /* Computes the and not of bitsets `src_1' and `src_2' into `dst' and return the
  * cardinality. */
 int bitset_container_andnot(const bitset_container_t *src_1,
@@ -492,6 +518,15 @@ int bitset_container_rank(const bitset_container_t *container, uint16_t x);
 /* Returns the index of the first value equal or larger than x, or -1 */
 int bitset_container_index_equalorlarger(const bitset_container_t *container, uint16_t x);
 
+/*
+ * Adds 'offset' to all values, splitting the result in a low and a high
+ * bitset, see array_container_offset. The results may hold few values.
+ * Assumes offset > 0.
+ */
+void bitset_container_offset(const bitset_container_t *c,
+                             container_t **loc, container_t **hic,
+                             uint16_t offset);
+
 #ifdef __cplusplus
 } } }  // extern "C" { namespace roaring { namespace internal {
 #endif
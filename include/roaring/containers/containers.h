@@ -18,6 +18,12 @@
 #include <roaring/containers/run.h>
 #include <roaring/bitset_util.h>
 
+#if defined(__cplusplus)
+#include <atomic>
+#elif !(defined(_MSC_VER) && !defined(__clang__))
+#include <stdatomic.h>
+#endif
+
 #ifdef __cplusplus
 extern "C" { namespace roaring { namespace internal {
 #endif
@@ -56,10 +62,61 @@ extern "C" { namespace roaring { namespace internal {
  * with reference counting.
  */
 
+/*
+ * The reference count of a shared container is atomic, so that bitmaps sharing
+ * containers (copy-on-write copies) may be freed or modified by different
+ * threads. Like isadetection.h, we use std::atomic in C++, C11 atomics in C,
+ * and the Interlocked intrinsics with Visual Studio, which lacks C11 atomics.
+ */
+#if defined(__cplusplus)
+typedef std::atomic<uint32_t> croaring_refcount_t;
+
+static inline void croaring_refcount_inc(croaring_refcount_t *val) {
+    val->fetch_add(1, std::memory_order_relaxed);
+}
+
+static inline bool croaring_refcount_dec(croaring_refcount_t *val) {
+    return val->fetch_sub(1, std::memory_order_acq_rel) == 1;
+}
+
+static inline uint32_t croaring_refcount_get(const croaring_refcount_t *val) {
+    return val->load(std::memory_order_acquire);
+}
+#elif defined(_MSC_VER) && !defined(__clang__)
+typedef volatile long croaring_refcount_t;
+
+static inline void croaring_refcount_inc(croaring_refcount_t *val) {
+    _InterlockedIncrement(val);
+}
+
+static inline bool croaring_refcount_dec(croaring_refcount_t *val) {
+    return _InterlockedDecrement(val) == 0;
+}
+
+static inline uint32_t croaring_refcount_get(const croaring_refcount_t *val) {
+    return (uint32_t)_InterlockedOr((croaring_refcount_t *)val, 0);
+}
+#else
+typedef _Atomic(uint32_t) croaring_refcount_t;
+
+static inline void croaring_refcount_inc(croaring_refcount_t *val) {
+    atomic_fetch_add_explicit(val, 1, memory_order_relaxed);
+}
+
+static inline bool croaring_refcount_dec(croaring_refcount_t *val) {
+    return atomic_fetch_sub_explicit(val, 1, memory_order_acq_rel) == 1;
+}
+
+static inline uint32_t croaring_refcount_get(const croaring_refcount_t *val) {
+    return atomic_load_explicit((croaring_refcount_t *)val,
+                                memory_order_acquire);
+}
+#endif
+
 STRUCT_CONTAINER(shared_container_s) {
     container_t *container;
     uint8_t typecode;
-    uint32_t counter;  // to be managed atomically
+    croaring_refcount_t counter;  // managed with the croaring_refcount_* functions
 };
 
 typedef struct shared_container_s shared_container_t;
@@ -2447,6 +2504,18 @@ static inline container_t *container_remove_range(
      }
 }
 
+/**
+ * Adds 'offset' (> 0) to all values of the container. The values that stay
+ * below 1<<16 go to a new container written to *lo, the others (minus 1<<16)
+ * to a new container written to *hi, and their types to *lo_type and
+ * *hi_type. Either of lo and hi may be NULL if that part is not wanted.
+ * Nothing is written for an empty part.
+ */
+void container_add_offset(const container_t *c, uint8_t type,
+                          container_t **lo, uint8_t *lo_type,
+                          container_t **hi, uint8_t *hi_type,
+                          uint16_t offset);
+
 #ifdef __cplusplus
 } } }  // extern "C" { namespace roaring { namespace internal {
 #endif
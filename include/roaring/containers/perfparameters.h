@@ -33,6 +33,20 @@ enum { ARRAY_DEFAULT_INIT_SIZE = 0 };
 #define LAZY_OR_BITSET_CONVERSION_TO_FULL true
 #endif
 
+/* parallel operations give each thread at least this many containers (both
+ * inputs together), otherwise they run on fewer threads: creating and joining
+ * a thread costs about as much as a few dozen container operations, so a
+ * thread must have thousands of them to pay off */
+enum { PARALLEL_MIN_CONTAINERS_PER_THREAD = 4096 };
+
+/* bitset_extract_setbits_avx512_uint16 decodes the words with at least this
+ * many bits set with vpcompressw, and the sparser ones bit by bit */
+enum { AVX512_EXTRACT_MIN_WORD_CARDINALITY = 3 };
+
+/* roaring_bitmap_contains_many groups unsorted probes by key when it is given
+ * at least this many of them, otherwise it looks them up one at a time */
+enum { CONTAINS_MANY_GROUPING_MIN_PROBES = 1024 };
+
 /* automatically attempt to convert a bitset to a full run */
 #ifndef OR_BITSET_CONVERSION_TO_FULL
 #define OR_BITSET_CONVERSION_TO_FULL true
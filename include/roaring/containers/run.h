@@ -576,6 +576,14 @@ inline int run_container_index_equalorlarger(const run_container_t *arr, uint16_
     return -1;
 }
 
+/*
+ * Adds 'offset' to all values, splitting the result in a low and a high
+ * container, see array_container_offset. Assumes offset > 0.
+ */
+void run_container_offset(const run_container_t *c,
+                          container_t **loc, container_t **hic,
+                          uint16_t offset);
+
 /*
  * Add all values in range [min, max] using hint.
  */
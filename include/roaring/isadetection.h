@@ -65,6 +65,8 @@ enum croaring_instruction_set {
   CROARING_BMI1 = 0x20,
   CROARING_BMI2 = 0x40,
   CROARING_ALTIVEC = 0x80,
+  // AVX-512 F, DQ, BW, VL, VBMI2, BITALG and VPOPCNTDQ, all enabled by the OS
+  CROARING_AVX512 = 0x100,
   CROARING_UNINITIALIZED = 0x8000
 };
 
@@ -118,6 +120,17 @@ static inline void cpuid(uint32_t *eax, uint32_t *ebx, uint32_t *ecx,
 #endif
 }
 
+// reads the XCR0 register, only valid if OSXSAVE is set
+static inline uint64_t xgetbv() {
+#if defined(_MSC_VER)
+  return _xgetbv(0);
+#else
+  uint32_t xcr0_lo, xcr0_hi;
+  __asm__("xgetbv\n\t" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+  return xcr0_lo | ((uint64_t)xcr0_hi << 32);
+#endif
+}
+
 static inline uint32_t dynamic_croaring_detect_supported_architectures() {
   uint32_t eax, ebx, ecx, edx;
   uint32_t host_isa = 0x0;
@@ -127,6 +140,13 @@ static inline uint32_t dynamic_croaring_detect_supported_architectures() {
   static uint32_t cpuid_bmi2_bit = 1 << 8;      ///< @private bit 8 of EBX for EAX=0x7
   static uint32_t cpuid_sse42_bit = 1 << 20;    ///< @private bit 20 of ECX for EAX=0x1
   static uint32_t cpuid_pclmulqdq_bit = 1 << 1; ///< @private bit  1 of ECX for EAX=0x1
+  static uint32_t cpuid_osxsave_bit = 1 << 27;  ///< @private bit 27 of ECX for EAX=0x1
+  static uint32_t cpuid_avx512_ebx_bits =
+      (1 << 16) | (1 << 17) | (1 << 30) | (1u << 31); ///< @private F, DQ, BW and VL in EBX for EAX=0x7
+  static uint32_t cpuid_avx512_ecx_bits =
+      (1 << 6) | (1 << 12) | (1 << 14); ///< @private VBMI2, BITALG and VPOPCNTDQ in ECX for EAX=0x7
+  static uint64_t xcr0_avx512_bits =
+      (1 << 1) | (1 << 2) | (1 << 5) | (1 << 6) | (1 << 7); ///< @private SSE, AVX, opmask and ZMM state
   // ECX for EAX=0x7
   eax = 0x7;
   ecx = 0x0;
@@ -141,6 +161,9 @@ static inline uint32_t dynamic_croaring_detect_supported_architectures() {
   if (ebx & cpuid_bmi2_bit) {
     host_isa |= CROARING_BMI2;
   }
+  const bool avx512_cpu =
+      ((ebx & cpuid_avx512_ebx_bits) == cpuid_avx512_ebx_bits) &&
+      ((ecx & cpuid_avx512_ecx_bits) == cpuid_avx512_ecx_bits);
 
   // EBX for EAX=0x1
   eax = 0x1;
@@ -154,6 +177,12 @@ static inline uint32_t dynamic_croaring_detect_supported_architectures() {
     host_isa |= CROARING_PCLMULQDQ;
   }
 
+  // the OS must also save the AVX-512 registers on context switches
+  if (avx512_cpu && (ecx & cpuid_osxsave_bit) &&
+      ((xgetbv() & xcr0_avx512_bits) == xcr0_avx512_bits)) {
+    host_isa |= CROARING_AVX512;
+  }
+
   return host_isa;
 }
 #else // fallback
@@ -212,6 +241,22 @@ static inline bool croaring_avx2() {
 }
 #endif
 
+#if defined(ROARING_DISABLE_AVX) || defined(ROARING_DISABLE_AVX512)
+static inline bool croaring_avx512() {
+  return false;
+}
+#elif defined(__AVX512F__) && defined(__AVX512DQ__) && defined(__AVX512BW__) && \
+    defined(__AVX512VL__) && defined(__AVX512VBMI2__) &&                        \
+    defined(__AVX512BITALG__) && defined(__AVX512VPOPCNTDQ__)
+static inline bool croaring_avx512() {
+  return true;
+}
+#else
+static inline bool croaring_avx512() {
+  return (croaring_detect_supported_architectures() & CROARING_AVX512) == CROARING_AVX512;
+}
+#endif
+
 
 #else // defined(__x86_64__) || defined(_M_AMD64) // x64
 
@@ -219,6 +264,10 @@ static inline bool croaring_avx2() {
   return false;
 }
 
+static inline bool croaring_avx512() {
+  return false;
+}
+
 static inline uint32_t croaring_detect_supported_architectures() {
     // no runtime dispatch
     return dynamic_croaring_detect_supported_architectures();
@@ -0,0 +1,127 @@
+/*
+ * memory.h
+ *
+ * Hooks through which all the memory of the library is allocated and freed.
+ */
+
+#ifndef INCLUDE_ROARING_MEMORY_H_
+#define INCLUDE_ROARING_MEMORY_H_
+
+#include <stddef.h>  // for `size_t`
+
+#ifdef __cplusplus
+extern "C" {  // like portability.h, in global scope, not a namespace
+#endif
+
+typedef void *(*roaring_malloc_p)(size_t);
+typedef void *(*roaring_realloc_p)(void *, size_t);
+typedef void *(*roaring_calloc_p)(size_t, size_t);
+typedef void (*roaring_free_p)(void *);
+typedef void *(*roaring_aligned_malloc_p)(size_t alignment, size_t size);
+typedef void (*roaring_aligned_free_p)(void *);
+
+typedef struct roaring_memory_s {
+    roaring_malloc_p malloc;
+    roaring_realloc_p realloc;
+    roaring_calloc_p calloc;
+    roaring_free_p free;
+    roaring_aligned_malloc_p aligned_malloc;
+    roaring_aligned_free_p aligned_free;
+} roaring_memory_t;
+
+/**
+ * Routes all the allocations of the library (bitmaps, containers, iterators,
+ * temporary buffers...) to the given functions, which must all be set and
+ * behave like their standard counterparts; aligned_malloc must return memory
+ * aligned on `alignment` bytes, a power of two.
+ *
+ * This should be called before any bitmap is created, as memory must be
+ * released with the functions that allocated it. It is not thread-safe.
+ */
+void roaring_init_memory_hook(roaring_memory_t memory_hook);
+
+void *roaring_malloc(size_t size);
+void *roaring_realloc(void *p, size_t new_size);
+void *roaring_calloc(size_t n_elements, size_t element_size);
+void roaring_free(void *p);
+void *roaring_aligned_malloc(size_t alignment, size_t size);
+void roaring_aligned_free(void *p);
+
+/**
+ * A bump allocator for short-lived bitmaps, such as the temporaries of a
+ * query. While an arena is current on a thread (see roaring_set_thread_arena),
+ * every allocation the library makes on that thread is carved out of it:
+ * containers, key arrays, bitmaps, iterators... Freeing such memory is a
+ * no-op, and all of it is released at once by roaring_arena_reset.
+ *
+ * The arena starts with the caller-supplied buffer and, once it is exhausted,
+ * grows by allocating blocks with the hooks above. The fields are private.
+ */
+typedef struct roaring_arena_s {
+    char *buffer;
+    size_t capacity;
+    size_t used;
+    struct roaring_arena_block_s *blocks;  // overflow, most recent first
+} roaring_arena_t;
+
+/**
+ * Initializes an arena over `buf`, which holds `size` bytes and must outlive
+ * the arena. `buf` may be NULL (with `size` zero) for a purely growing arena.
+ */
+void roaring_arena_init(roaring_arena_t *arena, void *buf, size_t size);
+
+/**
+ * Makes `arena` the current arena of the calling thread, or restores regular
+ * allocation if `arena` is NULL. Returns the previously current arena so that
+ * scopes can be nested.
+ *
+ * Memory allocated outside of the arena may still be freed or reallocated
+ * while it is current. The reverse is not true: bitmaps allocated from an
+ * arena may be read from anywhere, but must only be modified or freed while
+ * their arena is current, and become invalid when it is reset. Copy a result
+ * that must outlive the arena with roaring_bitmap_copy after leaving it. If the
+ * result has copy-on-write enabled, disable it before copying: the copy would
+ * otherwise share the containers of the arena, which dangle after the reset.
+ * The copy may enable copy-on-write again.
+ *
+ * Bitmaps allocated outside of the arena are not made to point into it: while
+ * it is current, their containers are cloned rather than shared with the
+ * results of copy-on-write operations. The parallel operations use only the
+ * calling thread while an arena is current on it.
+ */
+roaring_arena_t *roaring_set_thread_arena(roaring_arena_t *arena);
+
+/**
+ * Releases everything allocated from the arena at once: the buffer is reused
+ * from the start and the overflow blocks are freed. The arena may be current.
+ */
+void roaring_arena_reset(roaring_arena_t *arena);
+
+/**
+ * Containers can recycle their buffers (the 8 KB words of bitsets, the arrays
+ * of array and run containers up to 8 KB) through per-thread pools, so that a
+ * steady-state query loop makes almost no calls to the allocator. Array and
+ * run buffers are then sized in powers of two.
+ *
+ * Pooling is disabled by default. This sets how many bytes the pool of the
+ * calling thread may hold, releasing any excess; zero disables it again.
+ */
+void roaring_set_container_pool_limit(size_t max_bytes);
+
+/**
+ * Returns the buffers pooled by the calling thread to the allocator. Threads
+ * that enabled pooling should call it before they exit, and before the
+ * memory hooks are changed.
+ */
+void roaring_flush_container_pool(void);
+
+/**
+ * Returns how many bytes the pool of the calling thread currently holds.
+ */
+size_t roaring_container_pool_size_in_bytes(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // INCLUDE_ROARING_MEMORY_H_
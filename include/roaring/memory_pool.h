@@ -0,0 +1,62 @@
+/*
+ * memory_pool.h
+ *
+ * Per-thread pools of container buffers, see roaring_set_container_pool_limit,
+ * and what the library needs to know of the thread arena.
+ */
+
+#ifndef INCLUDE_ROARING_MEMORY_POOL_H_
+#define INCLUDE_ROARING_MEMORY_POOL_H_
+
+#include <stdbool.h>
+#include <stddef.h>  // for `size_t`
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {  // like memory.h, in global scope, not a namespace
+#endif
+
+/*
+ * Returns BITSET_CONTAINER_SIZE_IN_WORDS words aligned on 32 bytes, recycled
+ * if possible. Release them with roaring_pool_free_bitset_words.
+ */
+uint64_t *roaring_pool_malloc_bitset_words(void);
+void roaring_pool_free_bitset_words(uint64_t *words);
+
+/*
+ * Returns a buffer of at least `*size` bytes. When pooling is enabled, the
+ * size is rounded up to a power of two and `*size` is updated accordingly, so
+ * that the caller can use (and later release) the whole buffer.
+ */
+void *roaring_pool_malloc(size_t *size);
+
+/*
+ * Grows `p`, which holds `old_size` bytes, to at least `*size` bytes,
+ * preserving its content; `*size` is updated like by roaring_pool_malloc.
+ * On failure, returns NULL and leaves `p` allocated.
+ */
+void *roaring_pool_realloc(void *p, size_t old_size, size_t *size);
+
+/*
+ * Releases a buffer of `size` bytes obtained from roaring_pool_malloc,
+ * roaring_pool_realloc or roaring_malloc.
+ */
+void roaring_pool_free(void *p, size_t size);
+
+/*
+ * Whether an arena is current on the calling thread (see
+ * roaring_set_thread_arena).
+ */
+bool roaring_thread_has_arena(void);
+
+/*
+ * Whether an arena is current on the calling thread and `p` was not allocated
+ * from it: memory that outlives the arena must not be made to point into it.
+ */
+bool roaring_outlives_current_arena(const void *p);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // INCLUDE_ROARING_MEMORY_POOL_H_
@@ -139,6 +139,12 @@ static inline void tellmeall() {
          printf( "AVX2 not used\t");
        }
      }
+    if((config & CROARING_AVX512) == CROARING_AVX512) {
+        printf( "AVX-512 detected\t");
+    }
+    if(croaring_avx512()) {
+        printf( "AVX-512 usable\t");
+    }
     if((config & CROARING_SSE42) == CROARING_SSE42) {
         printf(" SSE4.2 detected\t");
     }
@@ -21,6 +21,7 @@
 #endif // !(defined(_XOPEN_SOURCE)) || (_XOPEN_SOURCE < 700)
 
 #include "isadetection.h"
+#include "memory.h"
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>  // will provide posix_memalign with _POSIX_C_SOURCE as defined above
@@ -268,11 +269,13 @@ static inline int hamming(uint64_t x) {
   _Pragma(STRINGIFY(                                                           \
       clang attribute push(__attribute__((target(T))), apply_to = function)))
 #define CROARING_UNTARGET_REGION _Pragma("clang attribute pop")
+#define CROARING_UNTARGET_AVX512 _Pragma("clang attribute pop")
 #elif defined(__GNUC__)
 // GCC is easier
 #define CROARING_TARGET_REGION(T)                                                       \
   _Pragma("GCC push_options") _Pragma(STRINGIFY(GCC target(T)))
 #define CROARING_UNTARGET_REGION _Pragma("GCC pop_options")
+#define CROARING_UNTARGET_AVX512 _Pragma("GCC pop_options")
 #endif // clang then gcc
 
 #endif // CROARING_IS_X64
@@ -282,9 +285,34 @@ static inline int hamming(uint64_t x) {
 #define CROARING_TARGET_REGION(T)
 #define CROARING_UNTARGET_REGION
 #endif
+#ifndef CROARING_UNTARGET_AVX512
+#define CROARING_UNTARGET_AVX512
+#endif
 
 #define CROARING_TARGET_AVX2 CROARING_TARGET_REGION("avx2,bmi,pclmul,lzcnt")
 
+// AVX-512 kernels need a compiler that knows about VBMI2, BITALG and
+// VPOPCNTDQ. They are still dispatched at runtime with croaring_avx512().
+#if defined(CROARING_IS_X64) && !defined(ROARING_DISABLE_AVX) &&               \
+    !defined(ROARING_DISABLE_AVX512) &&                                        \
+    ((defined(__clang_major__) && (__clang_major__ >= 8)) ||                   \
+     (defined(__GNUC__) && !defined(__clang__) && (__GNUC__ >= 8)) ||          \
+     (defined(_MSC_VER) && (_MSC_VER >= 1920)))
+#define CROARING_COMPILER_SUPPORTS_AVX512 1
+#endif
+
+#define CROARING_TARGET_AVX512 CROARING_TARGET_REGION("avx2,bmi,bmi2,popcnt,lzcnt,avx512f,avx512dq,avx512bw,avx512vl,avx512vbmi2,avx512bitalg,avx512vpopcntdq")
+
+#if defined(__AVX512F__) && defined(__AVX512DQ__) && defined(__AVX512BW__) && \
+    defined(__AVX512VL__) && defined(__AVX512VBMI2__) &&                        \
+    defined(__AVX512BITALG__) && defined(__AVX512VPOPCNTDQ__)
+// No need for runtime dispatching.
+#undef CROARING_TARGET_AVX512
+#define CROARING_TARGET_AVX512
+#undef CROARING_UNTARGET_AVX512
+#define CROARING_UNTARGET_AVX512
+#endif
+
 #ifdef __AVX2__
 // No need for runtime dispatching.
 // It is unnecessary and harmful to old clang to tag regions.
@@ -11,6 +11,7 @@
 
 #include <roaring/roaring_types.h>
 #include <roaring/roaring_version.h>
+#include <roaring/memory.h>
 
 #ifdef __cplusplus
 extern "C" { namespace roaring { namespace api {
@@ -68,6 +69,11 @@ roaring_bitmap_t *roaring_bitmap_of_ptr(size_t n_args, const uint32_t *vals);
  * Saves memory and avoids copies, but needs more care in a threaded context.
  * Most users should ignore this flag.
  *
+ * The shared containers are reference-counted atomically, so copies may be
+ * handed to other threads, which can then read, modify and free them
+ * independently. Making a copy, however, modifies the source bitmap: copies
+ * of a given bitmap must all be made by the thread that owns it.
+ *
  * Note: If you do turn this flag to 'true', enabling COW, then ensure that you
  * do so for all of your bitmaps, since interactions between bitmaps with and
  * without COW is unsafe.
@@ -84,6 +90,32 @@ static inline void roaring_bitmap_set_copy_on_write(roaring_bitmap_t* r,
     }
 }
 
+/*
+ * Whether you want to keep an index of the cumulative cardinality of the
+ * containers, which turns roaring_bitmap_rank(), roaring_bitmap_select(),
+ * roaring_bitmap_range_cardinality() and roaring_bitmap_range_uint32_array()
+ * into a binary search plus one container operation instead of a scan of the
+ * containers. It pays off for bitmaps with many containers. The total
+ * cardinality is cached as well, so that repeated calls to
+ * roaring_bitmap_get_cardinality() are O(1).
+ *
+ * The index is built by the first of these calls. Adding or removing a value
+ * in an existing container adjusts it; any other modification of the bitmap
+ * drops it. The cached total is instead kept up to date by the insertions and
+ * removals of values (roaring_bitmap_add(), roaring_bitmap_remove() and their
+ * _checked, _many and _bulk variants) and by the and, or, xor and andnot
+ * inplace operations; other modifications drop it. The flag is not copied with the bitmap. Frozen views
+ * (roaring_bitmap_frozen_view) always have an index, which cannot be disabled.
+ *
+ * Note: like copy-on-write, this flag makes queries write to the bitmap, so
+ * a bitmap with it should not be queried from several threads at once.
+ */
+static inline bool roaring_bitmap_get_cardinality_index(
+    const roaring_bitmap_t *r) {
+    return r->high_low_container.flags & ROARING_FLAG_CARD_INDEX;
+}
+void roaring_bitmap_set_cardinality_index(roaring_bitmap_t *r, bool enable);
+
 /**
  * Describe the inner structure of the bitmap.
  */
@@ -162,6 +194,53 @@ uint64_t roaring_bitmap_andnot_cardinality(const roaring_bitmap_t *r1,
 uint64_t roaring_bitmap_xor_cardinality(const roaring_bitmap_t *r1,
                                         const roaring_bitmap_t *r2);
 
+/**
+ * Versions of roaring_bitmap_and(), roaring_bitmap_or(), roaring_bitmap_xor()
+ * and roaring_bitmap_andnot() restricted to the values in the interval
+ * [range_start, range_end): the result is the same as that of the full
+ * operation followed by the removal of the values outside the interval, but
+ * only the containers in the interval are visited.
+ * Caller is responsible for freeing the result.
+ */
+roaring_bitmap_t *roaring_bitmap_and_in_range(const roaring_bitmap_t *r1,
+                                              const roaring_bitmap_t *r2,
+                                              uint64_t range_start,
+                                              uint64_t range_end);
+roaring_bitmap_t *roaring_bitmap_or_in_range(const roaring_bitmap_t *r1,
+                                             const roaring_bitmap_t *r2,
+                                             uint64_t range_start,
+                                             uint64_t range_end);
+roaring_bitmap_t *roaring_bitmap_xor_in_range(const roaring_bitmap_t *r1,
+                                              const roaring_bitmap_t *r2,
+                                              uint64_t range_start,
+                                              uint64_t range_end);
+roaring_bitmap_t *roaring_bitmap_andnot_in_range(const roaring_bitmap_t *r1,
+                                                 const roaring_bitmap_t *r2,
+                                                 uint64_t range_start,
+                                                 uint64_t range_end);
+
+/**
+ * Computes the size of the intersection, union, difference (andnot) and
+ * symmetric difference (xor) of two bitmaps restricted to the values in the
+ * interval [range_start, range_end), visiting only the containers in it.
+ */
+uint64_t roaring_bitmap_and_cardinality_in_range(const roaring_bitmap_t *r1,
+                                                 const roaring_bitmap_t *r2,
+                                                 uint64_t range_start,
+                                                 uint64_t range_end);
+uint64_t roaring_bitmap_or_cardinality_in_range(const roaring_bitmap_t *r1,
+                                                const roaring_bitmap_t *r2,
+                                                uint64_t range_start,
+                                                uint64_t range_end);
+uint64_t roaring_bitmap_andnot_cardinality_in_range(const roaring_bitmap_t *r1,
+                                                    const roaring_bitmap_t *r2,
+                                                    uint64_t range_start,
+                                                    uint64_t range_end);
+uint64_t roaring_bitmap_xor_cardinality_in_range(const roaring_bitmap_t *r1,
+                                                 const roaring_bitmap_t *r2,
+                                                 uint64_t range_start,
+                                                 uint64_t range_end);
+
 /**
  * Inplace version of `roaring_bitmap_and()`, modifies r1
  * r1 == r2 is allowed
@@ -169,6 +248,25 @@ uint64_t roaring_bitmap_xor_cardinality(const roaring_bitmap_t *r1,
 void roaring_bitmap_and_inplace(roaring_bitmap_t *r1,
                                 const roaring_bitmap_t *r2);
 
+/**
+ * Compute the intersection of 'number' bitmaps.
+ * Only keys common to all inputs are visited and containers are intersected
+ * from the smallest to the largest, stopping early on an empty result.
+ * Caller is responsible for freeing the result.
+ */
+roaring_bitmap_t *roaring_bitmap_and_many(size_t number,
+                                          const roaring_bitmap_t **rs);
+
+/**
+ * Compute the set of values that appear in at least 'threshold' of the
+ * 'number' bitmaps. A threshold of 0 or 1 is the union, a threshold equal to
+ * 'number' is the intersection and a larger threshold gives an empty bitmap.
+ * Caller is responsible for freeing the result.
+ */
+roaring_bitmap_t *roaring_bitmap_threshold_many(size_t number,
+                                                const roaring_bitmap_t **rs,
+                                                size_t threshold);
+
 /**
  * Computes the union between two bitmaps and returns new bitmap. The caller is
  * responsible for memory management.
@@ -232,6 +330,35 @@ roaring_bitmap_t *roaring_bitmap_andnot(const roaring_bitmap_t *r1,
 void roaring_bitmap_andnot_inplace(roaring_bitmap_t *r1,
                                    const roaring_bitmap_t *r2);
 
+/**
+ * Parallel versions of `roaring_bitmap_and()`, `roaring_bitmap_or()`,
+ * `roaring_bitmap_xor()` and `roaring_bitmap_andnot()`.
+ *
+ * The key space is split into up to `num_threads` ranges holding about the
+ * same number of containers, the ranges are processed concurrently and the
+ * results are spliced together. Every call starts and joins its own threads,
+ * so each thread is given thousands of containers: smaller inputs use fewer
+ * threads (inputs with fewer than 8192 containers in total use only the
+ * calling one), as do all calls made while an arena is current on the calling
+ * thread (see roaring_set_thread_arena). When the library is built with
+ * ROARING_DISABLE_THREADS, these are the sequential functions.
+ *
+ * The inputs must not be modified while the operation runs.
+ * Caller is responsible for freeing the result.
+ */
+roaring_bitmap_t *roaring_bitmap_and_parallel(const roaring_bitmap_t *r1,
+                                              const roaring_bitmap_t *r2,
+                                              uint32_t num_threads);
+roaring_bitmap_t *roaring_bitmap_or_parallel(const roaring_bitmap_t *r1,
+                                             const roaring_bitmap_t *r2,
+                                             uint32_t num_threads);
+roaring_bitmap_t *roaring_bitmap_xor_parallel(const roaring_bitmap_t *r1,
+                                              const roaring_bitmap_t *r2,
+                                              uint32_t num_threads);
+roaring_bitmap_t *roaring_bitmap_andnot_parallel(const roaring_bitmap_t *r1,
+                                                 const roaring_bitmap_t *r2,
+                                                 uint32_t num_threads);
+
 /**
  * TODO: consider implementing:
  *
@@ -260,6 +387,38 @@ void roaring_bitmap_add_many(roaring_bitmap_t *r, size_t n_args,
  */
 void roaring_bitmap_add(roaring_bitmap_t *r, uint32_t x);
 
+/**
+ * Caches the container touched last by roaring_bitmap_add_bulk() and
+ * roaring_bitmap_contains_bulk(), so that consecutive calls on values sharing
+ * their 16 high bits skip the key search, even across batches.
+ *
+ * Initialize it to zero (`roaring_bulk_context_t ctx = {0};`) and treat it as
+ * opaque. A context belongs to a single bitmap: any modification of that
+ * bitmap other than through roaring_bitmap_add_bulk() with the same context
+ * invalidates it (zero it again before reusing it).
+ */
+typedef struct roaring_bulk_context_s {
+    ROARING_CONTAINER_T *container;
+    int idx;
+    uint16_t key;
+    uint8_t typecode;
+} roaring_bulk_context_t;
+
+/**
+ * Add value x, reusing the container cached in 'context' when x has the same
+ * 16 high bits as the previous value.
+ */
+void roaring_bitmap_add_bulk(roaring_bitmap_t *r,
+                             roaring_bulk_context_t *context, uint32_t x);
+
+/**
+ * Check if value x is present, reusing the container cached in 'context'
+ * when x has the same 16 high bits as the previous value. Looking up values
+ * in increasing order is fastest.
+ */
+bool roaring_bitmap_contains_bulk(const roaring_bitmap_t *r,
+                                  roaring_bulk_context_t *context, uint32_t x);
+
 /**
  * Add value x
  * Returns true if a new value was added, false if the value already existed.
@@ -318,6 +477,15 @@ bool roaring_bitmap_remove_checked(roaring_bitmap_t *r, uint32_t x);
  */
 bool roaring_bitmap_contains(const roaring_bitmap_t *r, uint32_t val);
 
+/**
+ * Check which of the 'n' values are present: bit i of 'out_bits' (which must
+ * have room for (n + 63) / 64 words) is set if values[i] is in the bitmap,
+ * other bits are cleared. Much faster than repeated calls to
+ * roaring_bitmap_contains(), especially when the values are sorted.
+ */
+void roaring_bitmap_contains_many(const roaring_bitmap_t *r, size_t n,
+                                  const uint32_t *values, uint64_t *out_bits);
+
 /**
  * Check whether a range of values from range_start (included)
  * to range_end (excluded) is present
@@ -374,6 +542,19 @@ bool roaring_bitmap_range_uint32_array(const roaring_bitmap_t *r,
                                        size_t offset, size_t limit,
                                        uint32_t *ans);
 
+/**
+ * Writes to `ans` the values of the intersection of r1 and r2, skipping the
+ * first `offset` ones and stopping after `limit`, without building the
+ * intersection: the containers before the offset are only counted, and each
+ * of the others is intersected into a temporary container, decoded and freed.
+ * Returns the number of values written, at most `limit`, which is the room
+ * the caller must provide in `ans`.
+ */
+size_t roaring_bitmap_and_to_uint32_array(const roaring_bitmap_t *r1,
+                                          const roaring_bitmap_t *r2,
+                                          size_t offset, size_t limit,
+                                          uint32_t *ans);
+
 /**
  * Remove run-length encoding even when it is more space efficient.
  * Return whether a change was applied.
@@ -537,6 +718,68 @@ bool roaring_iterate(const roaring_bitmap_t *r, roaring_iterator iterator,
 bool roaring_iterate64(const roaring_bitmap_t *r, roaring_iterator64 iterator,
                        uint64_t high_bits, void *ptr);
 
+/**
+ * Iterate over the bitmap elements by blocks: the values are decoded a
+ * container at a time into a buffer of up to `buf_size` values, and the
+ * function iterator is called once per block, with the values in increasing
+ * order, their number (between 1 and buf_size) and ptr (can be NULL).
+ * This saves a call per value; a buffer holding 65536 values or more gets at
+ * least a whole container per call.
+ *
+ * Returns true if the iterator returned true throughout (so that all data
+ * points were necessarily visited), false otherwise or if buf_size is 0 or
+ * memory is lacking.
+ */
+bool roaring_iterate_batch(const roaring_bitmap_t *r,
+                           roaring_batch_iterator iterator, size_t buf_size,
+                           void *ptr);
+
+#define ROARING_CONTAINER_VIEW_BITSET 1
+#define ROARING_CONTAINER_VIEW_ARRAY 2
+#define ROARING_CONTAINER_VIEW_RUN 3
+
+/**
+ * A run of the values from `value` to `value + length` (inclusive).
+ */
+typedef struct roaring_rle16_s {
+    uint16_t value;
+    uint16_t length;
+} roaring_rle16_t;
+
+/**
+ * A read-only view of the internal storage of a container, which holds the
+ * values of the bitmap having `key` as their 16 high bits:
+ *  - ROARING_CONTAINER_VIEW_ARRAY: `array` holds `length` sorted 16-bit values
+ *  - ROARING_CONTAINER_VIEW_BITSET: `words` holds 1024 64-bit words, the value
+ *    v being present if bit v % 64 of words[v / 64] is set
+ *  - ROARING_CONTAINER_VIEW_RUN: `runs` holds `length` sorted, disjoint runs
+ * The unused pointers are NULL. The storage is that of the bitmap (within the
+ * buffer for frozen views), so it is only valid during the visit.
+ */
+typedef struct roaring_container_view_s {
+    uint16_t key;
+    uint8_t kind;  // ROARING_CONTAINER_VIEW_*
+    int32_t cardinality;
+    int32_t length;  // of array, words or runs
+    const uint16_t *array;
+    const uint64_t *words;
+    const roaring_rle16_t *runs;
+} roaring_container_view_t;
+
+typedef bool (*roaring_container_visitor)(const roaring_container_view_t *view,
+                                          void *param);
+
+/**
+ * Calls visitor once per container, in increasing key order, with a view of
+ * its storage and param (can be NULL), without decoding or copying it. This
+ * lets user code work directly on the compressed data.
+ *
+ * Returns true if the visitor returned true throughout (so that all
+ * containers were necessarily visited).
+ */
+bool roaring_visit_containers(const roaring_bitmap_t *r,
+                              roaring_container_visitor visitor, void *param);
+
 /**
  * Return true if the two bitmaps contain the same elements.
  */
@@ -634,6 +877,16 @@ roaring_bitmap_t *roaring_bitmap_flip(const roaring_bitmap_t *r1,
 void roaring_bitmap_flip_inplace(roaring_bitmap_t *r1, uint64_t range_start,
                                  uint64_t range_end);
 
+/**
+ * Returns a new bitmap holding the values of 'r' plus 'offset'; the values
+ * that would fall outside [0, UINT32_MAX] are dropped. When the offset is a
+ * multiple of 65536, only the container keys change and the containers are
+ * copied as they are (or shared, with copy-on-write); otherwise each container
+ * is shifted and split in two.
+ */
+roaring_bitmap_t *roaring_bitmap_add_offset(const roaring_bitmap_t *r,
+                                            int64_t offset);
+
 /**
  * Selects the element at index 'rank' where the smallest element is at index 0.
  * If the size of the roaring bitmap is strictly greater than rank, then this
@@ -783,6 +1036,190 @@ void roaring_free_uint32_iterator(roaring_uint32_iterator_t *it);
 uint32_t roaring_read_uint32_iterator(roaring_uint32_iterator_t *it,
                                       uint32_t* buf, uint32_t count);
 
+/**
+ * An iterator over the intersection of several bitmaps, which computes the
+ * intersection as it goes instead of building it: the iterators of the inputs
+ * leapfrog each other, each one jumping to the first value at least as large
+ * as the largest current value, so containers missing from any input are
+ * skipped as a whole. The inputs must not be modified while it is in use.
+ */
+typedef struct roaring_intersection_iterator_s {
+    size_t number;                         // of inputs
+    roaring_uint32_iterator_t *iterators;  // one per input
+    uint32_t current_value;
+    bool has_value;
+} roaring_intersection_iterator_t;
+
+/**
+ * Create an iterator over the intersection of 'number' bitmaps. If there is a
+ * value, then this iterator points to the first value and `it->has_value` is
+ * true. The value is in `it->current_value`. There is no value if number is 0.
+ * Caller is responsible for calling `roaring_free_intersection_iterator()`.
+ * Returns NULL if memory is lacking.
+ */
+roaring_intersection_iterator_t *roaring_create_intersection_iterator(
+    size_t number, const roaring_bitmap_t **x);
+
+/**
+ * Advance the iterator to the next value of the intersection, see
+ * `roaring_advance_uint32_iterator()`. Returns `it->has_value`.
+ */
+bool roaring_advance_intersection_iterator(
+    roaring_intersection_iterator_t *it);
+
+/**
+ * Move the iterator to the first value of the intersection >= `val`, see
+ * `roaring_move_uint32_iterator_equalorlarger()`. Returns `it->has_value`.
+ */
+bool roaring_move_intersection_iterator_equalorlarger(
+    roaring_intersection_iterator_t *it, uint32_t val);
+
+/**
+ * Reads the next values of the intersection into `buf`, with the same
+ * semantics as `roaring_read_uint32_iterator()`.
+ */
+uint32_t roaring_read_intersection_iterator(
+    roaring_intersection_iterator_t *it, uint32_t *buf, uint32_t count);
+
+/**
+ * Creates a copy of an iterator.
+ * Caller must free it.
+ */
+roaring_intersection_iterator_t *roaring_copy_intersection_iterator(
+    const roaring_intersection_iterator_t *it);
+
+/**
+ * Free memory following `roaring_create_intersection_iterator()`
+ */
+void roaring_free_intersection_iterator(roaring_intersection_iterator_t *it);
+
+/**
+ * Boolean expressions over bitmaps, evaluated lazily one 16-bit key at a time.
+ *
+ * An expression is a tree whose leaves refer to existing bitmaps and whose
+ * inner nodes are and/or/xor/andnot operators, e.g. `(A | B) & ~C` is
+ *
+ *     roaring_expr_andnot(roaring_expr_or(roaring_expr_leaf(A),
+ *                                         roaring_expr_leaf(B)),
+ *                         roaring_expr_leaf(C));
+ *
+ * Evaluating the expression only visits the keys that can contribute to the
+ * result (keys are pruned using the key arrays of the leaves) and combines
+ * the containers directly, without allocating intermediate bitmaps.
+ *
+ * Operator nodes take ownership of their operands; leaves do not own their
+ * bitmaps, which must outlive the expression and must not be modified while
+ * it is evaluated. An expression keeps cursors while it is being evaluated,
+ * so the same expression must not be evaluated from several threads at once.
+ */
+typedef struct roaring_expr_s roaring_expr_t;
+
+/**
+ * Create a leaf referring to `r` (which is not copied).
+ * Caller is responsible for calling `roaring_expr_free()` on the root.
+ */
+roaring_expr_t *roaring_expr_leaf(const roaring_bitmap_t *r);
+
+/**
+ * Create an operator node. The node takes ownership of its operands.
+ */
+roaring_expr_t *roaring_expr_and(roaring_expr_t *left, roaring_expr_t *right);
+roaring_expr_t *roaring_expr_or(roaring_expr_t *left, roaring_expr_t *right);
+roaring_expr_t *roaring_expr_xor(roaring_expr_t *left, roaring_expr_t *right);
+roaring_expr_t *roaring_expr_andnot(roaring_expr_t *left,
+                                    roaring_expr_t *right);
+
+/**
+ * Free an expression and all of its operands (but not the leaf bitmaps).
+ */
+void roaring_expr_free(roaring_expr_t *e);
+
+/**
+ * Evaluate the expression into a new bitmap.
+ * Caller is responsible for freeing the result.
+ */
+roaring_bitmap_t *roaring_expr_evaluate(roaring_expr_t *e);
+
+/**
+ * Compute the cardinality of the result of the expression, without
+ * materializing it.
+ */
+uint64_t roaring_expr_cardinality(roaring_expr_t *e);
+
+/**
+ * Check whether the result of the expression is non-empty, stopping at the
+ * first key with a non-empty result.
+ */
+bool roaring_expr_is_nonempty(roaring_expr_t *e);
+
+/**
+ * A bitmap mutated by a single writer thread and read concurrently, without
+ * locks, by up to `max_readers` reader threads.
+ *
+ * The writer modifies its working bitmap and publishes immutable versions of
+ * it. Publishing is a copy-on-write copy: the version shares its containers
+ * with the working bitmap, and only the containers the writer touches later
+ * are copied. A reader pins the latest version, reads it, and unpins it; a
+ * retired version is freed by the writer once no reader can still hold it
+ * (epoch-based reclamation).
+ *
+ * Readers identify themselves by a slot number in [0, max_readers), which
+ * each one must use exclusively, e.g. its thread index. Pinned versions must
+ * only be read: no function that modifies a bitmap may be called on them.
+ * Copy-on-write is disabled on published versions, so that operations taking
+ * them as inputs (copies, unions...) clone their containers rather than share
+ * them.
+ */
+typedef struct roaring_versioned_bitmap_s roaring_versioned_bitmap_t;
+
+/**
+ * Takes ownership of `r`, which becomes the working bitmap of the writer
+ * (copy-on-write is enabled on it), and publishes it as the first version.
+ * Returns NULL in case of failure, in which case the caller keeps `r`.
+ */
+roaring_versioned_bitmap_t *roaring_versioned_bitmap_create(
+    roaring_bitmap_t *r, size_t max_readers);
+
+/**
+ * Returns the working bitmap, which only the writer thread may access.
+ */
+roaring_bitmap_t *roaring_versioned_bitmap_working(
+    roaring_versioned_bitmap_t *v);
+
+/**
+ * Publishes the current state of the working bitmap as the latest version,
+ * then frees the retired versions that no reader can still hold. Called by
+ * the writer thread; returns false in case of allocation failure, in which
+ * case the previous version remains the latest.
+ */
+bool roaring_versioned_bitmap_publish(roaring_versioned_bitmap_t *v);
+
+/**
+ * Returns the number of published versions that have been replaced but not
+ * yet freed because readers may still hold them.
+ */
+size_t roaring_versioned_bitmap_retired_count(
+    const roaring_versioned_bitmap_t *v);
+
+/**
+ * Pins and returns the latest version for the reader of the given slot. It
+ * remains valid until the reader unpins it. A reader pins one version at a
+ * time. Lock-free and wait-free.
+ */
+const roaring_bitmap_t *roaring_versioned_bitmap_pin(
+    roaring_versioned_bitmap_t *v, size_t reader);
+
+/**
+ * Releases the version pinned by the reader of the given slot.
+ */
+void roaring_versioned_bitmap_unpin(roaring_versioned_bitmap_t *v,
+                                    size_t reader);
+
+/**
+ * Frees the working bitmap and all versions. No reader may hold a version.
+ */
+void roaring_versioned_bitmap_free(roaring_versioned_bitmap_t *v);
+
 #ifdef __cplusplus
 } } }  // extern "C" { namespace roaring { namespace api {
 #endif
@@ -72,6 +72,75 @@ void ra_clear_without_containers(roaring_array_t *r);
  */
 void ra_clear_containers(roaring_array_t *ra);
 
+/**
+ * When ROARING_FLAG_CARD_INDEX is set, returns an array whose i-th value is
+ * the total cardinality of the containers before the i-th one, building it
+ * if needed. Returns NULL otherwise (or if memory is lacking).
+ */
+const uint32_t *ra_get_card_index(const roaring_array_t *ra);
+
+/**
+ * Returns the index of the last container whose values have ranks starting
+ * at 'rank' or before, given the result of ra_get_card_index.
+ */
+static inline int32_t ra_card_index_lookup(const uint32_t *card_index,
+                                           int32_t size, uint64_t rank) {
+    int32_t low = 0, high = size - 1;
+    while (low < high) {
+        const int32_t middle = (low + high + 1) >> 1;
+        if (card_index[middle] <= rank) {
+            low = middle;
+        } else {
+            high = middle - 1;
+        }
+    }
+    return low;
+}
+
+void ra_free_card_index(roaring_array_t *ra);
+
+/**
+ * Value of ra->cardinality when the total cardinality is not cached.
+ */
+#define RA_UNKNOWN_CARDINALITY UINT64_MAX
+
+/**
+ * When ROARING_FLAG_CARD_INDEX is set, returns the total cardinality of the
+ * containers, computing and caching it if needed.
+ */
+uint64_t ra_get_cardinality(const roaring_array_t *ra);
+
+/**
+ * Returns the sum of the cardinalities of the containers at indexes
+ * [start, end), without any caching.
+ */
+uint64_t ra_containers_cardinality(const roaring_array_t *ra, int32_t start,
+                                   int32_t end);
+
+/**
+ * Drops the index of ra_get_card_index and the cached cardinality, which
+ * must be done whenever the content of the containers changes. Both only
+ * exist with ROARING_FLAG_CARD_INDEX, so other arrays pay a single branch.
+ * Frozen arrays cannot change, and their index lives in the frozen buffer:
+ * it is kept.
+ */
+static inline void ra_invalidate_card_index(roaring_array_t *ra) {
+    if ((ra->flags & (ROARING_FLAG_CARD_INDEX | ROARING_FLAG_FROZEN)) ==
+        ROARING_FLAG_CARD_INDEX) {
+        ra->cardinality = RA_UNKNOWN_CARDINALITY;
+        if (ra->card_index != NULL) ra_free_card_index(ra);
+    }
+}
+
+/**
+ * Records that the container at index i gained 'delta' values (lost, when it
+ * is negative) while keeping its key and position. Unlike
+ * ra_invalidate_card_index, this keeps the index of ra_get_card_index and the
+ * cached cardinality, so that adding values to a bitmap does not force the
+ * index to be rebuilt.
+ */
+void ra_card_index_adjust(roaring_array_t *ra, int32_t i, int64_t delta);
+
 /**
  * Get the index corresponding to a 16-bit key
  */
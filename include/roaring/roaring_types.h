@@ -6,6 +6,7 @@
 #define ROARING_TYPES_H
 
 #include <stdbool.h>
+#include <stddef.h>  // for `size_t`
 #include <stdint.h>
 
 #ifdef __cplusplus
@@ -42,6 +43,7 @@ extern "C" { namespace roaring { namespace api {
 
 #define ROARING_FLAG_COW UINT8_C(0x1)
 #define ROARING_FLAG_FROZEN UINT8_C(0x2)
+#define ROARING_FLAG_CARD_INDEX UINT8_C(0x4)
 
 /**
  * Roaring arrays are array-based key-value pairs having containers as values
@@ -59,12 +61,18 @@ typedef struct roaring_array_s {
     ROARING_CONTAINER_T **containers;  // Use container_t in non-API files!
     uint16_t *keys;
     uint8_t *typecodes;
+    // these two make roaring_bitmap_t larger than in 0.3.1: code embedding
+    // it (such as the C++ Roaring class) must be rebuilt against this header
+    uint32_t *card_index;  // lazily built, see ROARING_FLAG_CARD_INDEX
+    uint64_t cardinality;  // cached total, see ROARING_FLAG_CARD_INDEX
     uint8_t flags;
 } roaring_array_t;
 
 
 typedef bool (*roaring_iterator)(uint32_t value, void *param);
 typedef bool (*roaring_iterator64)(uint64_t value, void *param);
+typedef bool (*roaring_batch_iterator)(const uint32_t *values, size_t count,
+                                       void *param);
 
 /**
 *  (For advanced users.)
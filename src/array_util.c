@@ -16,7 +16,7 @@ extern "C" { namespace roaring { namespace internal {
 extern inline int32_t binarySearch(const uint16_t *array, int32_t lenarray,
                                    uint16_t ikey);
 
-#ifdef CROARING_IS_X64
+#if defined(CROARING_IS_X64) || defined(USENEON)
 // used by intersect_vector16
 ALIGNED(0x1000)
 static const uint8_t shuffle_mask16[] = {
@@ -362,6 +362,117 @@ static const uint8_t shuffle_mask16[] = {
     6,    7,    8,    9,    10,   11,   12,   13,   14,   15,   0xFF, 0xFF,
     0,    1,    2,    3,    4,    5,    6,    7,    8,    9,    10,   11,
     12,   13,   14,   15};
+#endif
+
+#ifdef CROARING_IS_X64
+#if CROARING_COMPILER_SUPPORTS_AVX512
+// when one array is at least this many times larger than the other one, the
+// AVX-512 kernels below beat _mm_cmpistrm (which wins on balanced inputs)
+#define AVX512_INTERSECT_SKEW 8
+
+CROARING_TARGET_AVX512
+/**
+ * Each value of the small array is broadcast and compared with the block of
+ * 32 values of the large array covering it: values of the small array that
+ * fall between two blocks cost nothing. Sets the bits of '*found' for the
+ * values of the block that appear in the small array and returns the
+ * position in 'small' of the first value past the block.
+ */
+static inline size_t _avx512_match_block(__m512i block, uint16_t block_max,
+                                         const uint16_t *small, size_t i_s,
+                                         size_t s_s, __mmask32 *found) {
+    __mmask32 mask = 0;
+    while (i_s < s_s && small[i_s] <= block_max) {
+        mask |= _mm512_cmpeq_epi16_mask(block, _mm512_set1_epi16(small[i_s]));
+        i_s++;
+    }
+    *found = mask;
+    return i_s;
+}
+
+// writes the values of 'v' selected by 'mask', contiguously, to 'out'
+static inline int _avx512_store_selected(__m512i v, __mmask32 mask,
+                                         uint16_t *out) {
+    const int n = _mm_popcnt_u32(mask);
+    _mm512_mask_storeu_epi16(out, _bzhi_u32(0xFFFFFFFF, n),
+                             _mm512_maskz_compress_epi16(mask, v));
+    return n;
+}
+
+// intersection of 'small' with 'large', which is much larger
+static int32_t _avx512_intersect_vector16(const uint16_t *__restrict__ large,
+                                          size_t s_l,
+                                          const uint16_t *__restrict__ small,
+                                          size_t s_s, uint16_t *C) {
+    size_t count = 0, i_l = 0, i_s = 0;
+    const size_t st_l = (s_l / 32) * 32;
+    while (i_l < st_l && i_s < s_s) {
+        const uint16_t block_max = large[i_l + 31];
+        if (small[i_s] > block_max) {
+            i_l += 32;
+            continue;
+        }
+        if (small[i_s] < large[i_l]) {
+            i_s++;
+            continue;
+        }
+        const __m512i block = _mm512_loadu_si512(large + i_l);
+        __mmask32 found;
+        i_s = _avx512_match_block(block, block_max, small, i_s, s_s, &found);
+        count += _avx512_store_selected(block, found, C + count);
+        i_l += 32;
+    }
+    return (int32_t)count + intersect_uint16(large + i_l, s_l - i_l,
+                                             small + i_s, s_s - i_s,
+                                             C + count);
+}
+
+static int32_t _avx512_intersect_vector16_cardinality(
+    const uint16_t *__restrict__ large, size_t s_l,
+    const uint16_t *__restrict__ small, size_t s_s) {
+    size_t count = 0, i_l = 0, i_s = 0;
+    const size_t st_l = (s_l / 32) * 32;
+    while (i_l < st_l && i_s < s_s) {
+        const uint16_t block_max = large[i_l + 31];
+        if (small[i_s] > block_max) {
+            i_l += 32;
+            continue;
+        }
+        if (small[i_s] < large[i_l]) {
+            i_s++;
+            continue;
+        }
+        const __m512i block = _mm512_loadu_si512(large + i_l);
+        __mmask32 found;
+        i_s = _avx512_match_block(block, block_max, small, i_s, s_s, &found);
+        count += _mm_popcnt_u32(found);
+        i_l += 32;
+    }
+    return (int32_t)count +
+           intersect_uint16_cardinality(large + i_l, s_l - i_l, small + i_s,
+                                        s_s - i_s);
+}
+
+// A \ B where A is much larger than B
+static int32_t _avx512_difference_vector16(const uint16_t *A, size_t s_a,
+                                           const uint16_t *B, size_t s_b,
+                                           uint16_t *C) {
+    size_t count = 0, i_a = 0, i_b = 0;
+    const size_t st_a = (s_a / 32) * 32;
+    for (; i_a < st_a; i_a += 32) {
+        const __m512i block = _mm512_loadu_si512(A + i_a);
+        const uint16_t block_max = A[i_a + 31];
+        __mmask32 found = 0;
+        while (i_b < s_b && B[i_b] < A[i_a]) i_b++;
+        i_b = _avx512_match_block(block, block_max, B, i_b, s_b, &found);
+        count += _avx512_store_selected(block, ~found, C + count);
+    }
+    return (int32_t)count + difference_uint16(A + i_a, (int)(s_a - i_a),
+                                               B + i_b, (int)(s_b - i_b),
+                                               C + count);
+}
+CROARING_UNTARGET_AVX512
+#endif // CROARING_COMPILER_SUPPORTS_AVX512
 
 /**
  * From Schlegel et al., Fast Sorted-Set Intersection using SIMD Instructions
@@ -371,6 +482,14 @@ CROARING_TARGET_AVX2
 int32_t intersect_vector16(const uint16_t *__restrict__ A, size_t s_a,
                            const uint16_t *__restrict__ B, size_t s_b,
                            uint16_t *C) {
+#if CROARING_COMPILER_SUPPORTS_AVX512
+    if (croaring_avx512()) {
+        if (s_a >= AVX512_INTERSECT_SKEW * s_b)
+            return _avx512_intersect_vector16(A, s_a, B, s_b, C);
+        if (s_b >= AVX512_INTERSECT_SKEW * s_a)
+            return _avx512_intersect_vector16(B, s_b, A, s_a, C);
+    }
+#endif
     size_t count = 0;
     size_t i_a = 0, i_b = 0;
     const int vectorlength = sizeof(__m128i) / sizeof(uint16_t);
@@ -451,6 +570,14 @@ int32_t intersect_vector16_cardinality(const uint16_t *__restrict__ A,
                                        size_t s_a,
                                        const uint16_t *__restrict__ B,
                                        size_t s_b) {
+#if CROARING_COMPILER_SUPPORTS_AVX512
+    if (croaring_avx512()) {
+        if (s_a >= AVX512_INTERSECT_SKEW * s_b)
+            return _avx512_intersect_vector16_cardinality(A, s_a, B, s_b);
+        if (s_b >= AVX512_INTERSECT_SKEW * s_a)
+            return _avx512_intersect_vector16_cardinality(B, s_b, A, s_a);
+    }
+#endif
     size_t count = 0;
     size_t i_a = 0, i_b = 0;
     const int vectorlength = sizeof(__m128i) / sizeof(uint16_t);
@@ -532,6 +659,11 @@ int32_t difference_vector16(const uint16_t *__restrict__ A, size_t s_a,
         if (A != C) memcpy(C, A, sizeof(uint16_t) * s_a);
         return (int32_t)s_a;
     }
+#if CROARING_COMPILER_SUPPORTS_AVX512
+    if (croaring_avx512() && s_a >= AVX512_INTERSECT_SKEW * s_b) {
+        return _avx512_difference_vector16(A, s_a, B, s_b, C);
+    }
+#endif
     // handle the leading zeroes, it is messy but it allows us to use the fast
     // _mm_cmpistrm instrinsic safely
     int32_t count = 0;
@@ -663,6 +795,230 @@ int32_t difference_vector16(const uint16_t *__restrict__ A, size_t s_a,
 CROARING_UNTARGET_REGION
 #endif  // CROARING_IS_X64
 
+#ifdef USENEON
+// bit i of the result is set if lane i of 'v' is set (_mm_movemask_epi8 over
+// 16-bit lanes)
+static inline uint32_t neon_movemask_u16(uint16x8_t v) {
+    static const uint16_t lane_bits[8] = {1, 2, 4, 8, 16, 32, 64, 128};
+    const uint64x2_t sums =
+        vpaddlq_u32(vpaddlq_u16(vandq_u16(v, vld1q_u16(lane_bits))));
+    return (uint32_t)(vgetq_lane_u64(sums, 0) + vgetq_lane_u64(sums, 1));
+}
+
+// same as _mm_shuffle_epi8 with a 16-byte key: out-of-range indexes (0xFF)
+// give zeroes
+static inline uint16x8_t neon_shuffle_u16(uint16x8_t v, const uint8_t *key) {
+    const uint8x16_t bytes = vreinterpretq_u8_u16(v);
+    uint8x8x2_t table;
+    table.val[0] = vget_low_u8(bytes);
+    table.val[1] = vget_high_u8(bytes);
+    const uint8x16_t k = vld1q_u8(key);
+    return vreinterpretq_u16_u8(vcombine_u8(vtbl2_u8(table, vget_low_u8(k)),
+                                            vtbl2_u8(table, vget_high_u8(k))));
+}
+
+// lanes of 'a' that appear anywhere in 'b', what _mm_cmpistrm computes for
+// intersect_vector16 on x64
+static inline uint16x8_t neon_found_in(uint16x8_t a, uint16x8_t b) {
+    uint16x8_t found = vceqq_u16(a, b);
+    found = vorrq_u16(found, vceqq_u16(a, vextq_u16(b, b, 1)));
+    found = vorrq_u16(found, vceqq_u16(a, vextq_u16(b, b, 2)));
+    found = vorrq_u16(found, vceqq_u16(a, vextq_u16(b, b, 3)));
+    found = vorrq_u16(found, vceqq_u16(a, vextq_u16(b, b, 4)));
+    found = vorrq_u16(found, vceqq_u16(a, vextq_u16(b, b, 5)));
+    found = vorrq_u16(found, vceqq_u16(a, vextq_u16(b, b, 6)));
+    found = vorrq_u16(found, vceqq_u16(a, vextq_u16(b, b, 7)));
+    return found;
+}
+
+/**
+ * Same algorithm as the x64 version, with the all-pairs comparison of
+ * _mm_cmpistrm done over the eight rotations of the vector of B.
+ */
+int32_t intersect_vector16(const uint16_t *__restrict__ A, size_t s_a,
+                           const uint16_t *__restrict__ B, size_t s_b,
+                           uint16_t *C) {
+    size_t count = 0;
+    size_t i_a = 0, i_b = 0;
+    const size_t vectorlength = sizeof(uint16x8_t) / sizeof(uint16_t);
+    const size_t st_a = (s_a / vectorlength) * vectorlength;
+    const size_t st_b = (s_b / vectorlength) * vectorlength;
+    if ((i_a < st_a) && (i_b < st_b)) {
+        uint16x8_t v_a = vld1q_u16(&A[i_a]);
+        uint16x8_t v_b = vld1q_u16(&B[i_b]);
+        while (true) {
+            const uint32_t r = neon_movemask_u16(neon_found_in(v_a, v_b));
+            const uint16x8_t p = neon_shuffle_u16(v_a, shuffle_mask16 + 16 * r);
+            vst1q_u16(&C[count], p);  // can overflow
+            count += hamming(r);
+            const uint16_t a_max = A[i_a + vectorlength - 1];
+            const uint16_t b_max = B[i_b + vectorlength - 1];
+            if (a_max <= b_max) {
+                i_a += vectorlength;
+                if (i_a == st_a) break;
+                v_a = vld1q_u16(&A[i_a]);
+            }
+            if (b_max <= a_max) {
+                i_b += vectorlength;
+                if (i_b == st_b) break;
+                v_b = vld1q_u16(&B[i_b]);
+            }
+        }
+    }
+    // intersect the tail using scalar intersection
+    while (i_a < s_a && i_b < s_b) {
+        uint16_t a = A[i_a];
+        uint16_t b = B[i_b];
+        if (a < b) {
+            i_a++;
+        } else if (b < a) {
+            i_b++;
+        } else {
+            C[count] = a;  //==b;
+            count++;
+            i_a++;
+            i_b++;
+        }
+    }
+    return (int32_t)count;
+}
+
+int32_t intersect_vector16_cardinality(const uint16_t *__restrict__ A,
+                                       size_t s_a,
+                                       const uint16_t *__restrict__ B,
+                                       size_t s_b) {
+    size_t count = 0;
+    size_t i_a = 0, i_b = 0;
+    const size_t vectorlength = sizeof(uint16x8_t) / sizeof(uint16_t);
+    const size_t st_a = (s_a / vectorlength) * vectorlength;
+    const size_t st_b = (s_b / vectorlength) * vectorlength;
+    if ((i_a < st_a) && (i_b < st_b)) {
+        uint16x8_t v_a = vld1q_u16(&A[i_a]);
+        uint16x8_t v_b = vld1q_u16(&B[i_b]);
+        while (true) {
+            count += hamming(neon_movemask_u16(neon_found_in(v_a, v_b)));
+            const uint16_t a_max = A[i_a + vectorlength - 1];
+            const uint16_t b_max = B[i_b + vectorlength - 1];
+            if (a_max <= b_max) {
+                i_a += vectorlength;
+                if (i_a == st_a) break;
+                v_a = vld1q_u16(&A[i_a]);
+            }
+            if (b_max <= a_max) {
+                i_b += vectorlength;
+                if (i_b == st_b) break;
+                v_b = vld1q_u16(&B[i_b]);
+            }
+        }
+    }
+    // intersect the tail using scalar intersection
+    while (i_a < s_a && i_b < s_b) {
+        uint16_t a = A[i_a];
+        uint16_t b = B[i_b];
+        if (a < b) {
+            i_a++;
+        } else if (b < a) {
+            i_b++;
+        } else {
+            count++;
+            i_a++;
+            i_b++;
+        }
+    }
+    return (int32_t)count;
+}
+
+/////////
+// Warning:
+// This function may not be safe if A == C or B == C.
+/////////
+int32_t difference_vector16(const uint16_t *__restrict__ A, size_t s_a,
+                            const uint16_t *__restrict__ B, size_t s_b,
+                            uint16_t *C) {
+    // we handle the degenerate case
+    if (s_a == 0) return 0;
+    if (s_b == 0) {
+        if (A != C) memcpy(C, A, sizeof(uint16_t) * s_a);
+        return (int32_t)s_a;
+    }
+    int32_t count = 0;
+    size_t i_a = 0, i_b = 0;
+    const size_t vectorlength = sizeof(uint16x8_t) / sizeof(uint16_t);
+    const size_t st_a = (s_a / vectorlength) * vectorlength;
+    const size_t st_b = (s_b / vectorlength) * vectorlength;
+    if ((i_a < st_a) && (i_b < st_b)) {  // this is the vectorized code path
+        uint16x8_t v_a = vld1q_u16(&A[i_a]);
+        uint16x8_t v_b = vld1q_u16(&B[i_b]);
+        // which values from A have been spotted in B, these don't get
+        // written out
+        uint16x8_t runningmask_a_found_in_b = vdupq_n_u16(0);
+        while (true) {
+            runningmask_a_found_in_b =
+                vorrq_u16(runningmask_a_found_in_b, neon_found_in(v_a, v_b));
+            // we always compare the last values of A and B
+            const uint16_t a_max = A[i_a + vectorlength - 1];
+            const uint16_t b_max = B[i_b + vectorlength - 1];
+            if (a_max <= b_max) {
+                // no value of B left to read can be found in v_a
+                const uint32_t bitmask_belongs_to_difference =
+                    neon_movemask_u16(runningmask_a_found_in_b) ^ 0xFF;
+                const uint16x8_t p = neon_shuffle_u16(
+                    v_a, shuffle_mask16 + 16 * bitmask_belongs_to_difference);
+                vst1q_u16(&C[count], p);  // can overflow
+                count += hamming(bitmask_belongs_to_difference);
+                i_a += vectorlength;
+                if (i_a == st_a)  // no more
+                    break;
+                runningmask_a_found_in_b = vdupq_n_u16(0);
+                v_a = vld1q_u16(&A[i_a]);
+            }
+            if (b_max <= a_max) {
+                // the current v_b has become useless
+                i_b += vectorlength;
+                if (i_b == st_b) break;
+                v_b = vld1q_u16(&B[i_b]);
+            }
+        }
+        // we ran out of vectors of B while v_a is not done: compare it with
+        // the last values of B one at a time
+        if (i_a < st_a) {
+            for (size_t j = i_b; j < s_b; j++) {
+                runningmask_a_found_in_b =
+                    vorrq_u16(runningmask_a_found_in_b,
+                              vceqq_u16(v_a, vdupq_n_u16(B[j])));
+            }
+            const uint32_t bitmask_belongs_to_difference =
+                neon_movemask_u16(runningmask_a_found_in_b) ^ 0xFF;
+            const uint16x8_t p = neon_shuffle_u16(
+                v_a, shuffle_mask16 + 16 * bitmask_belongs_to_difference);
+            vst1q_u16(&C[count], p);  // can overflow
+            count += hamming(bitmask_belongs_to_difference);
+            i_a += vectorlength;
+        }
+    }
+    // do the tail using scalar code
+    while (i_a < s_a && i_b < s_b) {
+        uint16_t a = A[i_a];
+        uint16_t b = B[i_b];
+        if (b < a) {
+            i_b++;
+        } else if (a < b) {
+            C[count] = a;
+            count++;
+            i_a++;
+        } else {  //==
+            i_a++;
+            i_b++;
+        }
+    }
+    if (i_a < s_a) {
+        memmove(C + count, A + i_a, sizeof(uint16_t) * (s_a - i_a));
+        count += (int32_t)(s_a - i_a);
+    }
+    return count;
+}
+#endif  // USENEON
+
 
 
 /**
@@ -1107,12 +1463,13 @@ int32_t xor_uint16(const uint16_t *array_1, int32_t card_1,
     return pos_out;
 }
 
-#ifdef CROARING_IS_X64
+#if defined(CROARING_IS_X64) || defined(USENEON)
 
 /***
  * start of the SIMD 16-bit union code
  *
  */
+#ifdef CROARING_IS_X64
 CROARING_TARGET_AVX2
 
 // Assuming that vInput1 and vInput2 are sorted, produces a sorted output going
@@ -1150,6 +1507,8 @@ static inline void sse_merge(const __m128i *vInput1,
     *vecMin = _mm_alignr_epi8(*vecMin, *vecMin, 2);
 }
 CROARING_UNTARGET_REGION
+#endif  // CROARING_IS_X64
+
 // used by store_unique, generated by simdunion.py
 static uint8_t uniqshuf[] = {
     0x0,  0x1,  0x2,  0x3,  0x4,  0x5,  0x6,  0x7,  0x8,  0x9,  0xa,  0xb,
@@ -1494,6 +1853,8 @@ static uint8_t uniqshuf[] = {
     0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
     0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
     0xFF, 0xFF, 0xFF, 0xFF};
+
+#ifdef CROARING_IS_X64
 CROARING_TARGET_AVX2
 // write vector new, while omitting repeated values assuming that previously
 // written vector was "old"
@@ -1509,6 +1870,7 @@ static inline int store_unique(__m128i old, __m128i newval, uint16_t *output) {
     return numberofnewvalues;
 }
 CROARING_UNTARGET_REGION
+#endif  // CROARING_IS_X64
 
 // working in-place, this function overwrites the repeated values
 // could be avoided?
@@ -1527,12 +1889,228 @@ static int uint16_compare(const void *a, const void *b) {
     return (*(uint16_t *)a - *(uint16_t *)b);
 }
 
+#ifdef CROARING_IS_X64
+#if CROARING_COMPILER_SUPPORTS_AVX512
+CROARING_TARGET_AVX512
+// 0, 1, ..., 31
+static inline __m512i _avx512_iota_epi16(void) {
+    return _mm512_set_epi16(31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19,
+                            18, 17, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5,
+                            4, 3, 2, 1, 0);
+}
+
+// sorts a bitonic sequence of 32 values
+static inline __m512i _avx512_bitonic_sort(__m512i v) {
+    const __m512i iota = _avx512_iota_epi16();
+    for (int d = 16; d >= 1; d >>= 1) {
+        const __m512i dist = _mm512_set1_epi16((short)d);
+        const __m512i partner =
+            _mm512_permutexvar_epi16(_mm512_xor_si512(iota, dist), v);
+        const __mmask32 upper = _mm512_test_epi16_mask(iota, dist);
+        v = _mm512_mask_blend_epi16(upper, _mm512_min_epu16(v, partner),
+                                    _mm512_max_epu16(v, partner));
+    }
+    return v;
+}
+
+// Same as sse_merge, over 32 values: given two sorted vectors, produces the
+// 32 smallest values in vecMin and the 32 largest in vecMax, all sorted.
+static inline void _avx512_merge(__m512i vInput1, __m512i vInput2,
+                                 __m512i *vecMin, __m512i *vecMax) {
+    const __m512i reverse =
+        _mm512_sub_epi16(_mm512_set1_epi16(31), _avx512_iota_epi16());
+    vInput2 = _mm512_permutexvar_epi16(reverse, vInput2);
+    *vecMin = _avx512_bitonic_sort(_mm512_min_epu16(vInput1, vInput2));
+    *vecMax = _avx512_bitonic_sort(_mm512_max_epu16(vInput1, vInput2));
+}
+
+// the vector formed by the 'shift' last values of 'old' followed by the
+// first values of 'newval'
+static inline __m512i _avx512_shift_in(__m512i old, __m512i newval,
+                                       short shift) {
+    const __m512i index = _mm512_add_epi16(_avx512_iota_epi16(),
+                                           _mm512_set1_epi16(32 - shift));
+    return _mm512_permutex2var_epi16(old, index, newval);
+}
+
+// same as store_unique
+static inline int _avx512_store_unique(__m512i old, __m512i newval,
+                                       uint16_t *output) {
+    const __m512i previous = _avx512_shift_in(old, newval, 1);
+    return _avx512_store_selected(
+        newval, _mm512_cmpneq_epi16_mask(previous, newval), output);
+}
+
+// same as store_unique_xor
+static inline int _avx512_store_unique_xor(__m512i old, __m512i newval,
+                                           uint16_t *output) {
+    const __m512i vecTmp1 = _avx512_shift_in(old, newval, 2);
+    const __m512i vecTmp2 = _avx512_shift_in(old, newval, 1);
+    const __mmask32 unique = _mm512_cmpneq_epi16_mask(vecTmp2, vecTmp1) &
+                             _mm512_cmpneq_epi16_mask(vecTmp2, newval);
+    return _avx512_store_selected(vecTmp2, unique, output);
+}
+
+/**
+ * Same algorithm as union_vector16, 32 values at a time. The leftovers are
+ * merged instead of being sorted.
+ */
+static uint32_t _avx512_union_vector16(const uint16_t *__restrict__ array1,
+                                       uint32_t length1,
+                                       const uint16_t *__restrict__ array2,
+                                       uint32_t length2,
+                                       uint16_t *__restrict__ output) {
+    if ((length1 < 32) || (length2 < 32)) {
+        return (uint32_t)union_uint16(array1, length1, array2, length2, output);
+    }
+    __m512i V, vecMin, vecMax;
+    __m512i laststore;
+    uint16_t *initoutput = output;
+    uint32_t len1 = length1 / 32;
+    uint32_t len2 = length2 / 32;
+    uint32_t pos1 = 1;
+    uint32_t pos2 = 1;
+    _avx512_merge(_mm512_loadu_si512(array1), _mm512_loadu_si512(array2),
+                  &vecMin, &vecMax);
+    laststore = _mm512_set1_epi16(-1);
+    output += _avx512_store_unique(laststore, vecMin, output);
+    laststore = vecMin;
+    if ((pos1 < len1) && (pos2 < len2)) {
+        uint16_t curA = array1[32 * pos1];
+        uint16_t curB = array2[32 * pos2];
+        while (true) {
+            if (curA <= curB) {
+                V = _mm512_loadu_si512(array1 + 32 * pos1);
+                pos1++;
+                if (pos1 < len1) {
+                    curA = array1[32 * pos1];
+                } else {
+                    break;
+                }
+            } else {
+                V = _mm512_loadu_si512(array2 + 32 * pos2);
+                pos2++;
+                if (pos2 < len2) {
+                    curB = array2[32 * pos2];
+                } else {
+                    break;
+                }
+            }
+            _avx512_merge(V, vecMax, &vecMin, &vecMax);
+            output += _avx512_store_unique(laststore, vecMin, output);
+            laststore = vecMin;
+        }
+        _avx512_merge(V, vecMax, &vecMin, &vecMax);
+        output += _avx512_store_unique(laststore, vecMin, output);
+        laststore = vecMin;
+    }
+    uint32_t len = (uint32_t)(output - initoutput);
+    uint16_t buffer[32], leftovers[64];
+    size_t leftoversize = _avx512_store_unique(laststore, vecMax, buffer);
+    if (pos1 == len1) {
+        leftoversize = union_uint16(buffer, leftoversize, array1 + 32 * pos1,
+                                    length1 - 32 * pos1, leftovers);
+        len += (uint32_t)union_uint16(leftovers, leftoversize,
+                                      array2 + 32 * pos2, length2 - 32 * pos2,
+                                      output);
+    } else {
+        leftoversize = union_uint16(buffer, leftoversize, array2 + 32 * pos2,
+                                    length2 - 32 * pos2, leftovers);
+        len += (uint32_t)union_uint16(leftovers, leftoversize,
+                                      array1 + 32 * pos1, length1 - 32 * pos1,
+                                      output);
+    }
+    return len;
+}
+
+/**
+ * Same algorithm as xor_vector16, 32 values at a time. The leftovers are
+ * merged instead of being sorted.
+ */
+static uint32_t _avx512_xor_vector16(const uint16_t *__restrict__ array1,
+                                     uint32_t length1,
+                                     const uint16_t *__restrict__ array2,
+                                     uint32_t length2,
+                                     uint16_t *__restrict__ output) {
+    if ((length1 < 32) || (length2 < 32)) {
+        return xor_uint16(array1, length1, array2, length2, output);
+    }
+    __m512i V, vecMin, vecMax;
+    __m512i laststore;
+    uint16_t *initoutput = output;
+    uint32_t len1 = length1 / 32;
+    uint32_t len2 = length2 / 32;
+    uint32_t pos1 = 1;
+    uint32_t pos2 = 1;
+    _avx512_merge(_mm512_loadu_si512(array1), _mm512_loadu_si512(array2),
+                  &vecMin, &vecMax);
+    laststore = _mm512_set1_epi16(-1);
+    output += _avx512_store_unique_xor(laststore, vecMin, output);
+    laststore = vecMin;
+    if ((pos1 < len1) && (pos2 < len2)) {
+        uint16_t curA = array1[32 * pos1];
+        uint16_t curB = array2[32 * pos2];
+        while (true) {
+            if (curA <= curB) {
+                V = _mm512_loadu_si512(array1 + 32 * pos1);
+                pos1++;
+                if (pos1 < len1) {
+                    curA = array1[32 * pos1];
+                } else {
+                    break;
+                }
+            } else {
+                V = _mm512_loadu_si512(array2 + 32 * pos2);
+                pos2++;
+                if (pos2 < len2) {
+                    curB = array2[32 * pos2];
+                } else {
+                    break;
+                }
+            }
+            _avx512_merge(V, vecMax, &vecMin, &vecMax);
+            output += _avx512_store_unique_xor(laststore, vecMin, output);
+            laststore = vecMin;
+        }
+        _avx512_merge(V, vecMax, &vecMin, &vecMax);
+        output += _avx512_store_unique_xor(laststore, vecMin, output);
+        laststore = vecMin;
+    }
+    uint32_t len = (uint32_t)(output - initoutput);
+    // as in xor_vector16, the last value of vecMax is only known to be unique
+    // once compared with its predecessor
+    uint16_t buffer[33], leftovers[64], last[32];
+    int32_t leftoversize = _avx512_store_unique_xor(laststore, vecMax, buffer);
+    _mm512_storeu_si512((__m512i *)last, vecMax);
+    if (last[31] != last[30]) buffer[leftoversize++] = last[31];
+    if (pos1 == len1) {
+        leftoversize = xor_uint16(buffer, leftoversize, array1 + 32 * pos1,
+                                  length1 - 32 * pos1, leftovers);
+        len += xor_uint16(leftovers, leftoversize, array2 + 32 * pos2,
+                          length2 - 32 * pos2, output);
+    } else {
+        leftoversize = xor_uint16(buffer, leftoversize, array2 + 32 * pos2,
+                                  length2 - 32 * pos2, leftovers);
+        len += xor_uint16(leftovers, leftoversize, array1 + 32 * pos1,
+                          length1 - 32 * pos1, output);
+    }
+    return len;
+}
+CROARING_UNTARGET_AVX512
+#endif // CROARING_COMPILER_SUPPORTS_AVX512
+
 CROARING_TARGET_AVX2
 // a one-pass SSE union algorithm
 // This function may not be safe if array1 == output or array2 == output.
 uint32_t union_vector16(const uint16_t *__restrict__ array1, uint32_t length1,
                         const uint16_t *__restrict__ array2, uint32_t length2,
                         uint16_t *__restrict__ output) {
+#if CROARING_COMPILER_SUPPORTS_AVX512
+    if (croaring_avx512()) {
+        return _avx512_union_vector16(array1, length1, array2, length2,
+                                      output);
+    }
+#endif
     if ((length1 < 8) || (length2 < 8)) {
         return (uint32_t)union_uint16(array1, length1, array2, length2, output);
     }
@@ -1639,6 +2217,7 @@ static inline int store_unique_xor(__m128i old, __m128i newval,
     return numberofnewvalues;
 }
 CROARING_UNTARGET_REGION
+#endif  // CROARING_IS_X64
 
 // working in-place, this function overwrites the repeated values
 // could be avoided? Warning: assumes len > 0
@@ -1652,11 +2231,18 @@ static inline uint32_t unique_xor(uint16_t *out, uint32_t len) {
     }
     return pos;
 }
+
+#ifdef CROARING_IS_X64
 CROARING_TARGET_AVX2
 // a one-pass SSE xor algorithm
 uint32_t xor_vector16(const uint16_t *__restrict__ array1, uint32_t length1,
                       const uint16_t *__restrict__ array2, uint32_t length2,
                       uint16_t *__restrict__ output) {
+#if CROARING_COMPILER_SUPPORTS_AVX512
+    if (croaring_avx512()) {
+        return _avx512_xor_vector16(array1, length1, array2, length2, output);
+    }
+#endif
     if ((length1 < 8) || (length2 < 8)) {
         return xor_uint16(array1, length1, array2, length2, output);
     }
@@ -1757,11 +2343,241 @@ uint32_t xor_vector16(const uint16_t *__restrict__ array1, uint32_t length1,
     return len;
 }
 CROARING_UNTARGET_REGION
+#endif  // CROARING_IS_X64
+
+#ifdef USENEON
+// same as sse_merge
+static inline void neon_merge(const uint16x8_t *vInput1,
+                              const uint16x8_t *vInput2,  // input 1 & 2
+                              uint16x8_t *vecMin, uint16x8_t *vecMax) {
+    uint16x8_t vecTmp;
+    vecTmp = vminq_u16(*vInput1, *vInput2);
+    *vecMax = vmaxq_u16(*vInput1, *vInput2);
+    for (int i = 0; i < 7; i++) {
+        vecTmp = vextq_u16(vecTmp, vecTmp, 1);
+        *vecMin = vminq_u16(vecTmp, *vecMax);
+        *vecMax = vmaxq_u16(vecTmp, *vecMax);
+        vecTmp = *vecMin;
+    }
+    *vecMin = vextq_u16(*vecMin, *vecMin, 1);
+}
+
+// write vector new, while omitting repeated values assuming that previously
+// written vector was "old"
+static inline int neon_store_unique(uint16x8_t old, uint16x8_t newval,
+                                    uint16_t *output) {
+    const uint16x8_t vecTmp = vextq_u16(old, newval, 7);
+    const uint32_t M = neon_movemask_u16(vceqq_u16(vecTmp, newval));
+    const int numberofnewvalues = 8 - hamming(M);
+    vst1q_u16(output, neon_shuffle_u16(newval, uniqshuf + 16 * M));
+    return numberofnewvalues;
+}
+
+// write vector new, while omitting the values that appear twice, assuming
+// that previously written vector was "old"
+static inline int neon_store_unique_xor(uint16x8_t old, uint16x8_t newval,
+                                        uint16_t *output) {
+    const uint16x8_t vecTmp1 = vextq_u16(old, newval, 6);
+    const uint16x8_t vecTmp2 = vextq_u16(old, newval, 7);
+    const uint16x8_t equalleftoright = vorrq_u16(vceqq_u16(vecTmp2, vecTmp1),
+                                                 vceqq_u16(vecTmp2, newval));
+    const uint32_t M = neon_movemask_u16(equalleftoright);
+    const int numberofnewvalues = 8 - hamming(M);
+    vst1q_u16(output, neon_shuffle_u16(vecTmp2, uniqshuf + 16 * M));
+    return numberofnewvalues;
+}
+
+// a one-pass NEON union algorithm, same as the SSE one
+// This function may not be safe if array1 == output or array2 == output.
+uint32_t union_vector16(const uint16_t *__restrict__ array1, uint32_t length1,
+                        const uint16_t *__restrict__ array2, uint32_t length2,
+                        uint16_t *__restrict__ output) {
+    if ((length1 < 8) || (length2 < 8)) {
+        return (uint32_t)union_uint16(array1, length1, array2, length2, output);
+    }
+    uint16x8_t vA, vB, V, vecMin, vecMax;
+    uint16x8_t laststore;
+    uint16_t *initoutput = output;
+    uint32_t len1 = length1 / 8;
+    uint32_t len2 = length2 / 8;
+    uint32_t pos1 = 0;
+    uint32_t pos2 = 0;
+    // we start the machine
+    vA = vld1q_u16(array1 + 8 * pos1);
+    pos1++;
+    vB = vld1q_u16(array2 + 8 * pos2);
+    pos2++;
+    neon_merge(&vA, &vB, &vecMin, &vecMax);
+    laststore = vdupq_n_u16(0xFFFF);
+    output += neon_store_unique(laststore, vecMin, output);
+    laststore = vecMin;
+    if ((pos1 < len1) && (pos2 < len2)) {
+        uint16_t curA, curB;
+        curA = array1[8 * pos1];
+        curB = array2[8 * pos2];
+        while (true) {
+            if (curA <= curB) {
+                V = vld1q_u16(array1 + 8 * pos1);
+                pos1++;
+                if (pos1 < len1) {
+                    curA = array1[8 * pos1];
+                } else {
+                    break;
+                }
+            } else {
+                V = vld1q_u16(array2 + 8 * pos2);
+                pos2++;
+                if (pos2 < len2) {
+                    curB = array2[8 * pos2];
+                } else {
+                    break;
+                }
+            }
+            neon_merge(&V, &vecMax, &vecMin, &vecMax);
+            output += neon_store_unique(laststore, vecMin, output);
+            laststore = vecMin;
+        }
+        neon_merge(&V, &vecMax, &vecMin, &vecMax);
+        output += neon_store_unique(laststore, vecMin, output);
+        laststore = vecMin;
+    }
+    // we finish the rest off using a scalar algorithm
+    // could be improved?
+    //
+    // copy the small end on a tmp buffer
+    uint32_t len = (uint32_t)(output - initoutput);
+    uint16_t buffer[16];
+    uint32_t leftoversize = neon_store_unique(laststore, vecMax, buffer);
+    if (pos1 == len1) {
+        memcpy(buffer + leftoversize, array1 + 8 * pos1,
+               (length1 - 8 * len1) * sizeof(uint16_t));
+        leftoversize += length1 - 8 * len1;
+        qsort(buffer, leftoversize, sizeof(uint16_t), uint16_compare);
+
+        leftoversize = unique(buffer, leftoversize);
+        len += (uint32_t)union_uint16(buffer, leftoversize, array2 + 8 * pos2,
+                                      length2 - 8 * pos2, output);
+    } else {
+        memcpy(buffer + leftoversize, array2 + 8 * pos2,
+               (length2 - 8 * len2) * sizeof(uint16_t));
+        leftoversize += length2 - 8 * len2;
+        qsort(buffer, leftoversize, sizeof(uint16_t), uint16_compare);
+        leftoversize = unique(buffer, leftoversize);
+        len += (uint32_t)union_uint16(buffer, leftoversize, array1 + 8 * pos1,
+                                      length1 - 8 * pos1, output);
+    }
+    return len;
+}
+
+// a one-pass NEON xor algorithm, same as the SSE one
+uint32_t xor_vector16(const uint16_t *__restrict__ array1, uint32_t length1,
+                      const uint16_t *__restrict__ array2, uint32_t length2,
+                      uint16_t *__restrict__ output) {
+    if ((length1 < 8) || (length2 < 8)) {
+        return xor_uint16(array1, length1, array2, length2, output);
+    }
+    uint16x8_t vA, vB, V, vecMin, vecMax;
+    uint16x8_t laststore;
+    uint16_t *initoutput = output;
+    uint32_t len1 = length1 / 8;
+    uint32_t len2 = length2 / 8;
+    uint32_t pos1 = 0;
+    uint32_t pos2 = 0;
+    // we start the machine
+    vA = vld1q_u16(array1 + 8 * pos1);
+    pos1++;
+    vB = vld1q_u16(array2 + 8 * pos2);
+    pos2++;
+    neon_merge(&vA, &vB, &vecMin, &vecMax);
+    laststore = vdupq_n_u16(0xFFFF);
+    uint16_t buffer[17];
+    output += neon_store_unique_xor(laststore, vecMin, output);
+
+    laststore = vecMin;
+    if ((pos1 < len1) && (pos2 < len2)) {
+        uint16_t curA, curB;
+        curA = array1[8 * pos1];
+        curB = array2[8 * pos2];
+        while (true) {
+            if (curA <= curB) {
+                V = vld1q_u16(array1 + 8 * pos1);
+                pos1++;
+                if (pos1 < len1) {
+                    curA = array1[8 * pos1];
+                } else {
+                    break;
+                }
+            } else {
+                V = vld1q_u16(array2 + 8 * pos2);
+                pos2++;
+                if (pos2 < len2) {
+                    curB = array2[8 * pos2];
+                } else {
+                    break;
+                }
+            }
+            neon_merge(&V, &vecMax, &vecMin, &vecMax);
+            // conditionally stores the last value of laststore as well as all
+            // but the
+            // last value of vecMin
+            output += neon_store_unique_xor(laststore, vecMin, output);
+            laststore = vecMin;
+        }
+        neon_merge(&V, &vecMax, &vecMin, &vecMax);
+        // conditionally stores the last value of laststore as well as all but
+        // the
+        // last value of vecMin
+        output += neon_store_unique_xor(laststore, vecMin, output);
+        laststore = vecMin;
+    }
+    uint32_t len = (uint32_t)(output - initoutput);
+
+    // we finish the rest off using a scalar algorithm
+    // could be improved?
+    // conditionally stores the last value of laststore as well as all but the
+    // last value of vecMax,
+    // we store to "buffer"
+    int leftoversize = neon_store_unique_xor(laststore, vecMax, buffer);
+    uint16_t vec7 = vgetq_lane_u16(vecMax, 7);
+    uint16_t vec6 = vgetq_lane_u16(vecMax, 6);
+    if (vec7 != vec6) buffer[leftoversize++] = vec7;
+    if (pos1 == len1) {
+        memcpy(buffer + leftoversize, array1 + 8 * pos1,
+               (length1 - 8 * len1) * sizeof(uint16_t));
+        leftoversize += length1 - 8 * len1;
+        if (leftoversize == 0) {  // trivial case
+            memcpy(output, array2 + 8 * pos2,
+                   (length2 - 8 * pos2) * sizeof(uint16_t));
+            len += (length2 - 8 * pos2);
+        } else {
+            qsort(buffer, leftoversize, sizeof(uint16_t), uint16_compare);
+            leftoversize = unique_xor(buffer, leftoversize);
+            len += xor_uint16(buffer, leftoversize, array2 + 8 * pos2,
+                              length2 - 8 * pos2, output);
+        }
+    } else {
+        memcpy(buffer + leftoversize, array2 + 8 * pos2,
+               (length2 - 8 * len2) * sizeof(uint16_t));
+        leftoversize += length2 - 8 * len2;
+        if (leftoversize == 0) {  // trivial case
+            memcpy(output, array1 + 8 * pos1,
+                   (length1 - 8 * pos1) * sizeof(uint16_t));
+            len += (length1 - 8 * pos1);
+        } else {
+            qsort(buffer, leftoversize, sizeof(uint16_t), uint16_compare);
+            leftoversize = unique_xor(buffer, leftoversize);
+            len += xor_uint16(buffer, leftoversize, array1 + 8 * pos1,
+                              length1 - 8 * pos1, output);
+        }
+    }
+    return len;
+}
+#endif  // USENEON
 /**
  * End of SIMD 16-bit XOR code
  */
 
-#endif  // CROARING_IS_X64
+#endif  // CROARING_IS_X64 || USENEON
 
 size_t union_uint32(const uint32_t *set_1, size_t size_1, const uint32_t *set_2,
                     size_t size_2, uint32_t *buffer) {
@@ -1880,6 +2696,15 @@ size_t fast_union_uint16(const uint16_t *set_1, size_t size_1, const uint16_t *s
             set_2, size_2, set_1, size_1, buffer);
       }
     }
+#elif defined(USENEON)
+    // compute union with smallest array first
+    if (size_1 < size_2) {
+        return union_vector16(set_1, (uint32_t)size_1,
+                              set_2, (uint32_t)size_2, buffer);
+    } else {
+        return union_vector16(set_2, (uint32_t)size_2,
+                              set_1, (uint32_t)size_1, buffer);
+    }
 #else
     // compute union with smallest array first
     if (size_1 < size_2) {
@@ -5,12 +5,13 @@
 #include <string.h>
 
 #include <roaring/bitset_util.h>
+#include <roaring/containers/perfparameters.h>
 
 #ifdef __cplusplus
 extern "C" { namespace roaring { namespace internal {
 #endif
 
-#ifdef CROARING_IS_X64
+#if defined(CROARING_IS_X64) || defined(USENEON)
 static uint8_t lengthTable[256] = {
     0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 1, 2, 2, 3, 2, 3, 3, 4,
     2, 3, 3, 4, 3, 4, 4, 5, 1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5,
@@ -288,7 +289,7 @@ static uint32_t vecDecodeTable[256][8] = {
 
 #endif  // #ifdef CROARING_IS_X64
 
-#ifdef CROARING_IS_X64
+#if defined(CROARING_IS_X64) || defined(USENEON)
 // same as vecDecodeTable but in 16 bits
 ALIGNED(32)
 static uint16_t vecDecodeTable_uint16[256][8] = {
@@ -712,6 +713,108 @@ size_t bitset_extract_setbits_sse_uint16(const uint64_t *words, size_t length,
 CROARING_UNTARGET_REGION
 #endif
 
+#ifdef USENEON
+/*
+ * NEON version of bitset_extract_setbits_sse_uint16, same contract.
+ */
+size_t bitset_extract_setbits_sse_uint16(const uint64_t *words, size_t length,
+                                         uint16_t *out, size_t outcapacity,
+                                         uint16_t base) {
+    uint16_t *initout = out;
+    uint16x8_t baseVec = vdupq_n_u16((uint16_t)(base - 1));
+    const uint16x8_t incVec = vdupq_n_u16(64);
+    const uint16x8_t add8 = vdupq_n_u16(8);
+    uint16_t *safeout = out + outcapacity;
+    const int numberofbytes = 2;  // process two bytes at a time
+    size_t i = 0;
+    for (; (i < length) && (out + numberofbytes * 8 <= safeout); ++i) {
+        uint64_t w = words[i];
+        if (w == 0) {
+            baseVec = vaddq_u16(baseVec, incVec);
+        } else {
+            for (int k = 0; k < 4; ++k) {
+                uint8_t byteA = (uint8_t)w;
+                uint8_t byteB = (uint8_t)(w >> 8);
+                w >>= 16;
+                uint16x8_t vecA = vld1q_u16(vecDecodeTable_uint16[byteA]);
+                uint16x8_t vecB = vld1q_u16(vecDecodeTable_uint16[byteB]);
+                uint8_t advanceA = lengthTable[byteA];
+                uint8_t advanceB = lengthTable[byteB];
+                vecA = vaddq_u16(baseVec, vecA);
+                baseVec = vaddq_u16(baseVec, add8);
+                vecB = vaddq_u16(baseVec, vecB);
+                baseVec = vaddq_u16(baseVec, add8);
+                vst1q_u16(out, vecA);
+                out += advanceA;
+                vst1q_u16(out, vecB);
+                out += advanceB;
+            }
+        }
+    }
+    base += (uint16_t)(i * 64);
+    for (; (i < length) && (out < safeout); ++i) {
+        uint64_t w = words[i];
+        while ((w != 0) && (out < safeout)) {
+            uint64_t t = w & (~w + 1);
+            int r = __builtin_ctzll(w);
+            *out = r + base;
+            out++;
+            w ^= t;
+        }
+        base += 64;
+    }
+    return out - initout;
+}
+#endif  // USENEON
+
+#if CROARING_COMPILER_SUPPORTS_AVX512
+CROARING_TARGET_AVX512
+size_t bitset_extract_setbits_avx512_uint16(const uint64_t *words,
+                                            size_t length, uint16_t *out,
+                                            uint16_t base) {
+    uint16_t *initout = out;
+    // the value of each bit of a 32-bit half word
+    __m512i values = _mm512_add_epi16(
+        _mm512_set_epi16(31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19,
+                         18, 17, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4,
+                         3, 2, 1, 0),
+        _mm512_set1_epi16((short)base));
+    const __m512i inc32 = _mm512_set1_epi16(32);
+    const __m512i inc64 = _mm512_set1_epi16(64);
+    for (size_t i = 0; i < length; ++i) {
+        uint64_t w = words[i];
+        if (w == 0) {
+            // nothing to decode
+        } else if (_mm_popcnt_u64(w) < AVX512_EXTRACT_MIN_WORD_CARDINALITY) {
+            // a compress costs more than decoding a couple of bits
+            const uint16_t wordbase = (uint16_t)(base + 64 * i);
+            do {
+                *out++ = (uint16_t)(wordbase + __builtin_ctzll(w));
+                w &= w - 1;
+            } while (w != 0);
+        } else {
+            const __mmask32 lo = (__mmask32)w;
+            const __mmask32 hi = (__mmask32)(w >> 32);
+            const int nlo = _mm_popcnt_u32(lo);
+            const int nhi = _mm_popcnt_u32(hi);
+            // masked stores rather than compress-stores, which are much
+            // slower on some processors
+            _mm512_mask_storeu_epi16(out, _bzhi_u32(0xFFFFFFFF, nlo),
+                                     _mm512_maskz_compress_epi16(lo, values));
+            out += nlo;
+            _mm512_mask_storeu_epi16(
+                out, _bzhi_u32(0xFFFFFFFF, nhi),
+                _mm512_maskz_compress_epi16(hi,
+                                            _mm512_add_epi16(values, inc32)));
+            out += nhi;
+        }
+        values = _mm512_add_epi16(values, inc64);
+    }
+    return out - initout;
+}
+CROARING_UNTARGET_AVX512
+#endif
+
 /*
  * Given a bitset containing "length" 64-bit words, write out the position
  * of all the set bits to "out", values start at "base" (can be set to zero).
@@ -723,6 +826,11 @@ CROARING_UNTARGET_REGION
  */
 size_t bitset_extract_setbits_uint16(const uint64_t *words, size_t length,
                                      uint16_t *out, uint16_t base) {
+#if CROARING_COMPILER_SUPPORTS_AVX512
+    if (croaring_avx512()) {
+        return bitset_extract_setbits_avx512_uint16(words, length, out, base);
+    }
+#endif
     int outpos = 0;
     for (size_t i = 0; i < length; ++i) {
         uint64_t w = words[i];
@@ -5,6 +5,7 @@
 
 #include <assert.h>
 #include <roaring/containers/array.h>
+#include <roaring/memory_pool.h>
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -31,17 +32,21 @@ extern inline bool array_container_full(const array_container_t *array);
 array_container_t *array_container_create_given_capacity(int32_t size) {
     array_container_t *container;
 
-    if ((container = (array_container_t *)malloc(sizeof(array_container_t))) ==
+    if ((container = (array_container_t *)roaring_malloc(sizeof(array_container_t))) ==
         NULL) {
         return NULL;
     }
 
     if( size <= 0 ) { // we don't want to rely on malloc(0)
         container->array = NULL;
-    } else if ((container->array = (uint16_t *)malloc(sizeof(uint16_t) * size)) ==
-        NULL) {
-        free(container);
-        return NULL;
+    } else {
+        size_t bytes = sizeof(uint16_t) * size;
+        if ((container->array = (uint16_t *)roaring_pool_malloc(&bytes)) ==
+            NULL) {
+            roaring_free(container);
+            return NULL;
+        }
+        size = (int32_t)(bytes / sizeof(uint16_t));
     }
 
     container->capacity = size;
@@ -85,13 +90,13 @@ int array_container_shrink_to_fit(array_container_t *src) {
     int savings = src->capacity - src->cardinality;
     src->capacity = src->cardinality;
     if( src->capacity == 0) { // we do not want to rely on realloc for zero allocs
-      free(src->array);
+      roaring_free(src->array);
       src->array = NULL;
     } else {
       uint16_t *oldarray = src->array;
       src->array =
-        (uint16_t *)realloc(oldarray, src->capacity * sizeof(uint16_t));
-      if (src->array == NULL) free(oldarray);  // should never happen?
+        (uint16_t *)roaring_realloc(oldarray, src->capacity * sizeof(uint16_t));
+      if (src->array == NULL) roaring_free(oldarray);  // should never happen?
     }
     return savings;
 }
@@ -99,10 +104,10 @@ int array_container_shrink_to_fit(array_container_t *src) {
 /* Free memory. */
 void array_container_free(array_container_t *arr) {
     if(arr->array != NULL) {// Jon Strabala reports that some tools complain otherwise
-      free(arr->array);
+      roaring_pool_free(arr->array, arr->capacity * sizeof(uint16_t));
       arr->array = NULL; // pedantic
     }
-    free(arr);
+    roaring_free(arr);
 }
 
 static inline int32_t grow_capacity(int32_t capacity) {
@@ -122,20 +127,22 @@ void array_container_grow(array_container_t *container, int32_t min,
     int32_t max = (min <= DEFAULT_MAX_SIZE ? DEFAULT_MAX_SIZE : 65536);
     int32_t new_capacity = clamp(grow_capacity(container->capacity), min, max);
 
-    container->capacity = new_capacity;
+    size_t old_bytes = container->capacity * sizeof(uint16_t);
+    size_t bytes = new_capacity * sizeof(uint16_t);
     uint16_t *array = container->array;
 
     if (preserve) {
         container->array =
-            (uint16_t *)realloc(array, new_capacity * sizeof(uint16_t));
-        if (container->array == NULL) free(array);
+            (uint16_t *)roaring_pool_realloc(array, old_bytes, &bytes);
+        if (container->array == NULL) roaring_free(array);
     } else {
         // Jon Strabala reports that some tools complain otherwise
         if (array != NULL) {
-          free(array);
+          roaring_pool_free(array, old_bytes);
         }
-        container->array = (uint16_t *)malloc(new_capacity * sizeof(uint16_t));
+        container->array = (uint16_t *)roaring_pool_malloc(&bytes);
     }
+    container->capacity = (int32_t)(bytes / sizeof(uint16_t));
 
     //  handle the case where realloc fails
     if (container->array == NULL) {
@@ -199,6 +206,18 @@ void array_container_andnot(const array_container_t *array_1,
         difference_uint16(array_1->array, array_1->cardinality, array_2->array,
                           array_2->cardinality, out->array);
      }
+#elif defined(USENEON)
+    if ((out != array_1) && (out != array_2)) {
+        out->cardinality =
+            difference_vector16(array_1->array, array_1->cardinality,
+                                array_2->array, array_2->cardinality,
+                                out->array);
+    } else {
+        out->cardinality =
+            difference_uint16(array_1->array, array_1->cardinality,
+                              array_2->array, array_2->cardinality,
+                              out->array);
+    }
 #else
     out->cardinality =
         difference_uint16(array_1->array, array_1->cardinality, array_2->array,
@@ -230,6 +249,10 @@ void array_container_xor(const array_container_t *array_1,
         xor_uint16(array_1->array, array_1->cardinality, array_2->array,
                    array_2->cardinality, out->array);
     }
+#elif defined(USENEON)
+    out->cardinality =
+        xor_vector16(array_1->array, array_1->cardinality, array_2->array,
+                     array_2->cardinality, out->array);
 #else
     out->cardinality =
         xor_uint16(array_1->array, array_1->cardinality, array_2->array,
@@ -256,6 +279,12 @@ void array_container_intersection(const array_container_t *array1,
       array_container_grow(out, min_card + sizeof(__m128i) / sizeof(uint16_t),
         false);
     }
+#elif defined(USENEON)
+    if (out->capacity < min_card) {
+      array_container_grow(out,
+                           min_card + sizeof(uint16x8_t) / sizeof(uint16_t),
+                           false);
+    }
 #else
     if (out->capacity < min_card) {
       array_container_grow(out, min_card, false);
@@ -277,6 +306,9 @@ void array_container_intersection(const array_container_t *array1,
         out->cardinality = intersect_uint16(array1->array, card_1,
                                             array2->array, card_2, out->array);
        }
+#elif defined(USENEON)
+        out->cardinality = intersect_vector16(
+            array1->array, card_1, array2->array, card_2, out->array);
 #else
         out->cardinality = intersect_uint16(array1->array, card_1,
                                             array2->array, card_2, out->array);
@@ -305,6 +337,9 @@ int array_container_intersection_cardinality(const array_container_t *array1,
         return intersect_uint16_cardinality(array1->array, card_1,
                                             array2->array, card_2);
     }
+#elif defined(USENEON)
+        return intersect_vector16_cardinality(array1->array, card_1,
+                                              array2->array, card_2);
 #else
         return intersect_uint16_cardinality(array1->array, card_1,
                                             array2->array, card_2);
@@ -459,6 +494,31 @@ bool array_container_iterate64(const array_container_t *cont, uint32_t base,
     return true;
 }
 
+void array_container_offset(const array_container_t *c,
+                            container_t **loc, container_t **hic,
+                            uint16_t offset) {
+    const int32_t top = (1 << 16) - offset;
+    const int32_t lo_card = count_less(c->array, c->cardinality, top);
+    const int32_t hi_card = c->cardinality - lo_card;
+
+    if (loc != NULL && lo_card > 0) {
+        array_container_t *lo = array_container_create_given_capacity(lo_card);
+        for (int32_t i = 0; i < lo_card; ++i) {
+            lo->array[i] = c->array[i] + offset;
+        }
+        lo->cardinality = lo_card;
+        *loc = lo;
+    }
+    if (hic != NULL && hi_card > 0) {
+        array_container_t *hi = array_container_create_given_capacity(hi_card);
+        for (int32_t i = 0; i < hi_card; ++i) {
+            hi->array[i] = c->array[lo_card + i] + offset;  // wraps around
+        }
+        hi->cardinality = hi_card;
+        *hic = hi;
+    }
+}
+
 #ifdef __cplusplus
 } } }  // extern "C" { namespace roaring { namespace internal {
 #endif
@@ -12,6 +12,7 @@
 
 #include <roaring/bitset_util.h>
 #include <roaring/containers/bitset.h>
+#include <roaring/memory_pool.h>
 #include <roaring/portability.h>
 #include <roaring/utilasm.h>
 
@@ -47,16 +48,14 @@ void bitset_container_set_all(bitset_container_t *bitset) {
 /* Create a new bitset. Return NULL in case of failure. */
 bitset_container_t *bitset_container_create(void) {
     bitset_container_t *bitset =
-        (bitset_container_t *)malloc(sizeof(bitset_container_t));
+        (bitset_container_t *)roaring_malloc(sizeof(bitset_container_t));
 
     if (!bitset) {
         return NULL;
     }
-    // sizeof(__m256i) == 32
-    bitset->words = (uint64_t *)roaring_bitmap_aligned_malloc(
-        32, sizeof(uint64_t) * BITSET_CONTAINER_SIZE_IN_WORDS);
+    bitset->words = roaring_pool_malloc_bitset_words();  // 32-byte aligned
     if (!bitset->words) {
-        free(bitset);
+        roaring_free(bitset);
         return NULL;
     }
     bitset_container_clear(bitset);
@@ -102,25 +101,23 @@ void bitset_container_add_from_range(bitset_container_t *bitset, uint32_t min,
 /* Free memory. */
 void bitset_container_free(bitset_container_t *bitset) {
     if(bitset->words != NULL) {// Jon Strabala reports that some tools complain otherwise
-      roaring_bitmap_aligned_free(bitset->words);
+      roaring_pool_free_bitset_words(bitset->words);
       bitset->words = NULL; // pedantic
     }
-    free(bitset);
+    roaring_free(bitset);
 }
 
 /* duplicate container. */
 bitset_container_t *bitset_container_clone(const bitset_container_t *src) {
     bitset_container_t *bitset =
-        (bitset_container_t *)malloc(sizeof(bitset_container_t));
+        (bitset_container_t *)roaring_malloc(sizeof(bitset_container_t));
 
     if (!bitset) {
         return NULL;
     }
-    // sizeof(__m256i) == 32
-    bitset->words = (uint64_t *)roaring_bitmap_aligned_malloc(
-        32, sizeof(uint64_t) * BITSET_CONTAINER_SIZE_IN_WORDS);
+    bitset->words = roaring_pool_malloc_bitset_words();  // 32-byte aligned
     if (!bitset->words) {
-        free(bitset);
+        roaring_free(bitset);
         return NULL;
     }
     bitset->cardinality = src->cardinality;
@@ -165,8 +162,49 @@ int _scalar_bitset_container_compute_cardinality(const bitset_container_t *bitse
   }
   return sum;
 }
+#if CROARING_COMPILER_SUPPORTS_AVX512
+#define WORDS_IN_AVX512_REG (sizeof(__m512i) / sizeof(uint64_t))
+CROARING_TARGET_AVX512
+/* _mm512_reduce_add_epi64 and _mm512_andnot_si512 go through
+ * _mm512_undefined_*, which trips -Winit-self with some GCC versions */
+static inline uint64_t _avx512_hsum_epi64(__m512i v) {
+  uint64_t lanes[WORDS_IN_AVX512_REG];
+  _mm512_storeu_si512((__m512i *)lanes, v);
+  uint64_t sum = 0;
+  for (size_t i = 0; i < WORDS_IN_AVX512_REG; i++) sum += lanes[i];
+  return sum;
+}
+
+/* ~a & b */
+static inline __m512i _avx512_andnot_epi64(__m512i a, __m512i b) {
+  return _mm512_ternarylogic_epi64(a, b, b, 0x0C);
+}
+
+/* Get the number of bits set (force computation), with the native vector
+ * popcount */
+static int _avx512_bitset_container_compute_cardinality(
+    const bitset_container_t *bitset) {
+  const __m512i *words = (const __m512i *)bitset->words;
+  __m512i sum0 = _mm512_setzero_si512(), sum1 = _mm512_setzero_si512();
+  for (size_t i = 0; i < BITSET_CONTAINER_SIZE_IN_WORDS / WORDS_IN_AVX512_REG;
+       i += 2) {
+    sum0 = _mm512_add_epi64(sum0,
+                            _mm512_popcnt_epi64(_mm512_loadu_si512(words + i)));
+    sum1 = _mm512_add_epi64(
+        sum1, _mm512_popcnt_epi64(_mm512_loadu_si512(words + i + 1)));
+  }
+  return (int)_avx512_hsum_epi64(_mm512_add_epi64(sum0, sum1));
+}
+CROARING_UNTARGET_AVX512
+#endif // CROARING_COMPILER_SUPPORTS_AVX512
+
 /* Get the number of bits set (force computation) */
 int bitset_container_compute_cardinality(const bitset_container_t *bitset) {
+#if CROARING_COMPILER_SUPPORTS_AVX512
+    if( croaring_avx512() ) {
+      return _avx512_bitset_container_compute_cardinality(bitset);
+    }
+#endif
     if( croaring_avx2() ) {
       return (int) avx2_harley_seal_popcount256(
         (const __m256i *)bitset->words,
@@ -381,6 +419,86 @@ CROARING_TARGET_AVX2
 AVX_BITSET_CONTAINER_FN3(CROARING_TARGET_AVX2, andnot, &~, _mm256_andnot_si256, vbicq_u64, CROARING_UNTARGET_REGION)
 CROARING_UNTARGET_REGION
 
+#if CROARING_COMPILER_SUPPORTS_AVX512
+/* Same as the AVX_BITSET_CONTAINER_FN family, over 512-bit registers and with
+   the native vector popcount instead of Harley-Seal */
+#define AVX512_BITSET_CONTAINER_FN(opname, avx512_intrinsic)                   \
+  int _avx512_bitset_container_##opname(const bitset_container_t *src_1,       \
+                                        const bitset_container_t *src_2,       \
+                                        bitset_container_t *dst) {             \
+    const __m512i *__restrict__ words_1 = (const __m512i *)src_1->words;       \
+    const __m512i *__restrict__ words_2 = (const __m512i *)src_2->words;       \
+    __m512i *out = (__m512i *)dst->words;                                      \
+    __m512i sum0 = _mm512_setzero_si512(), sum1 = _mm512_setzero_si512();      \
+    for (size_t i = 0;                                                         \
+         i < BITSET_CONTAINER_SIZE_IN_WORDS / (WORDS_IN_AVX512_REG); i += 2) { \
+      const __m512i A0 = avx512_intrinsic(_mm512_loadu_si512(words_2 + i),     \
+                                          _mm512_loadu_si512(words_1 + i));    \
+      const __m512i A1 = avx512_intrinsic(_mm512_loadu_si512(words_2 + i + 1), \
+                                          _mm512_loadu_si512(words_1 + i + 1)); \
+      _mm512_storeu_si512(out + i, A0);                                        \
+      _mm512_storeu_si512(out + i + 1, A1);                                    \
+      sum0 = _mm512_add_epi64(sum0, _mm512_popcnt_epi64(A0));                  \
+      sum1 = _mm512_add_epi64(sum1, _mm512_popcnt_epi64(A1));                  \
+    }                                                                          \
+    dst->cardinality =                                                         \
+        (int32_t)_avx512_hsum_epi64(_mm512_add_epi64(sum0, sum1));             \
+    return dst->cardinality;                                                   \
+  }                                                                            \
+  int _avx512_bitset_container_##opname##_nocard(                              \
+      const bitset_container_t *src_1, const bitset_container_t *src_2,        \
+      bitset_container_t *dst) {                                               \
+    const __m512i *__restrict__ words_1 = (const __m512i *)src_1->words;       \
+    const __m512i *__restrict__ words_2 = (const __m512i *)src_2->words;       \
+    __m512i *out = (__m512i *)dst->words;                                      \
+    for (size_t i = 0;                                                         \
+         i < BITSET_CONTAINER_SIZE_IN_WORDS / (WORDS_IN_AVX512_REG); i += 2) { \
+      _mm512_storeu_si512(out + i,                                             \
+                          avx512_intrinsic(_mm512_loadu_si512(words_2 + i),    \
+                                           _mm512_loadu_si512(words_1 + i)));  \
+      _mm512_storeu_si512(                                                     \
+          out + i + 1, avx512_intrinsic(_mm512_loadu_si512(words_2 + i + 1),   \
+                                        _mm512_loadu_si512(words_1 + i + 1))); \
+    }                                                                          \
+    dst->cardinality = BITSET_UNKNOWN_CARDINALITY;                             \
+    return dst->cardinality;                                                   \
+  }                                                                            \
+  int _avx512_bitset_container_##opname##_justcard(                            \
+      const bitset_container_t *src_1, const bitset_container_t *src_2) {      \
+    const __m512i *__restrict__ words_1 = (const __m512i *)src_1->words;       \
+    const __m512i *__restrict__ words_2 = (const __m512i *)src_2->words;       \
+    __m512i sum0 = _mm512_setzero_si512(), sum1 = _mm512_setzero_si512();      \
+    for (size_t i = 0;                                                         \
+         i < BITSET_CONTAINER_SIZE_IN_WORDS / (WORDS_IN_AVX512_REG); i += 2) { \
+      sum0 = _mm512_add_epi64(                                                 \
+          sum0, _mm512_popcnt_epi64(avx512_intrinsic(                          \
+                    _mm512_loadu_si512(words_2 + i),                           \
+                    _mm512_loadu_si512(words_1 + i))));                        \
+      sum1 = _mm512_add_epi64(                                                 \
+          sum1, _mm512_popcnt_epi64(avx512_intrinsic(                          \
+                    _mm512_loadu_si512(words_2 + i + 1),                       \
+                    _mm512_loadu_si512(words_1 + i + 1))));                    \
+    }                                                                          \
+    return (int)_avx512_hsum_epi64(_mm512_add_epi64(sum0, sum1));              \
+  }
+
+CROARING_TARGET_AVX512
+AVX512_BITSET_CONTAINER_FN(or,           _mm512_or_epi64)
+AVX512_BITSET_CONTAINER_FN(union,        _mm512_or_epi64)
+AVX512_BITSET_CONTAINER_FN(and,          _mm512_and_epi64)
+AVX512_BITSET_CONTAINER_FN(intersection, _mm512_and_epi64)
+AVX512_BITSET_CONTAINER_FN(xor,          _mm512_xor_epi64)
+AVX512_BITSET_CONTAINER_FN(andnot,       _avx512_andnot_epi64)
+CROARING_UNTARGET_AVX512
+
+#define AVX512_BITSET_DISPATCH(call)                                           \
+    if ( croaring_avx512() ) {                                                 \
+      return _avx512_##call;                                                   \
+    }
+#else
+#define AVX512_BITSET_DISPATCH(call)
+#endif // CROARING_COMPILER_SUPPORTS_AVX512
+
 
 #define SCALAR_BITSET_CONTAINER_FN(opname, opsymbol, avx_intrinsic,            \
                                    neon_intrinsic)                             \
@@ -444,6 +562,7 @@ SCALAR_BITSET_CONTAINER_FN(andnot, &~, _mm256_andnot_si256, vbicq_u64)
   int bitset_container_##opname(const bitset_container_t *src_1,               \
                                 const bitset_container_t *src_2,               \
                                 bitset_container_t *dst) {                     \
+    AVX512_BITSET_DISPATCH(bitset_container_##opname(src_1, src_2, dst))       \
     if ( croaring_avx2() ) {                                                       \
       return _avx2_bitset_container_##opname(src_1, src_2, dst);               \
     } else {                                                                   \
@@ -453,6 +572,8 @@ SCALAR_BITSET_CONTAINER_FN(andnot, &~, _mm256_andnot_si256, vbicq_u64)
   int bitset_container_##opname##_nocard(const bitset_container_t *src_1,      \
                                          const bitset_container_t *src_2,      \
                                          bitset_container_t *dst) {            \
+    AVX512_BITSET_DISPATCH(                                                    \
+        bitset_container_##opname##_nocard(src_1, src_2, dst))                 \
     if ( croaring_avx2() ) {                                                       \
       return _avx2_bitset_container_##opname##_nocard(src_1, src_2, dst);      \
     } else {                                                                   \
@@ -461,6 +582,8 @@ SCALAR_BITSET_CONTAINER_FN(andnot, &~, _mm256_andnot_si256, vbicq_u64)
   }                                                                            \
   int bitset_container_##opname##_justcard(const bitset_container_t *src_1,    \
                                            const bitset_container_t *src_2) {  \
+    AVX512_BITSET_DISPATCH(                                                    \
+        bitset_container_##opname##_justcard(src_1, src_2))                    \
     if ((croaring_detect_supported_architectures() & CROARING_AVX2) ==         \
         CROARING_AVX2) {                                                       \
       return _avx2_bitset_container_##opname##_justcard(src_1, src_2);         \
@@ -620,6 +743,145 @@ BITSET_CONTAINER_FN(xor,    ^,  _mm256_xor_si256,    veorq_u64)
 BITSET_CONTAINER_FN(andnot, &~, _mm256_andnot_si256, vbicq_u64)
 // clang-format On
 
+/* Bit-sliced population count over many bitsets. The inputs are combined by
+ * the carry-save adder (CSA) network of the Harley-Seal popcount: every group
+ * of four inputs goes through three CSAs, leaving its "ones" and "twos" in the
+ * two lowest slices, and only the resulting "fours" ripple into the higher
+ * slices. Each block of words is read once from every input and then written
+ * once to every slice. With `accumulate', the counts start from those already
+ * in the slices rather than from zero. The kernel is instantiated for every
+ * instruction set from the vector type and operations given as arguments. */
+#define BITSET_CSA(vec_t, vxor, vand, vor, h, l, a, b, c) \
+    do {                                                  \
+        const vec_t _csa_u = vxor(a, b);                  \
+        h = vor(vand(a, b), vand(_csa_u, c));             \
+        l = vxor(_csa_u, c);                              \
+    } while (0)
+
+// clang-format off
+#define BITSET_COUNT_MANY_FN(name, vec_t, words_per_vec, vload, vstore, vzero, \
+                             vxor, vand, vor)                                  \
+static void name(const bitset_container_t **srcs, size_t count,                \
+                 uint64_t *slices, size_t nslices, bool accumulate) {          \
+    vec_t acc[64];                                                             \
+    for (size_t i = 0; i < BITSET_CONTAINER_SIZE_IN_WORDS;                     \
+         i += (words_per_vec)) {                                               \
+        for (size_t s = 0; s < nslices; s++) {                                 \
+            acc[s] = accumulate                                                \
+                ? vload(slices + s * BITSET_CONTAINER_SIZE_IN_WORDS + i)       \
+                : vzero;                                                       \
+        }                                                                      \
+        size_t k = 0;                                                          \
+        for (; k + 4 <= count; k += 4) {                                       \
+            const vec_t w0 = vload(srcs[k]->words + i);                        \
+            const vec_t w1 = vload(srcs[k + 1]->words + i);                    \
+            const vec_t w2 = vload(srcs[k + 2]->words + i);                    \
+            const vec_t w3 = vload(srcs[k + 3]->words + i);                    \
+            vec_t twos_a, twos_b, fours;                                       \
+            BITSET_CSA(vec_t, vxor, vand, vor, twos_a, acc[0], acc[0], w0, w1); \
+            BITSET_CSA(vec_t, vxor, vand, vor, twos_b, acc[0], acc[0], w2, w3); \
+            if (nslices == 1) continue;                                        \
+            BITSET_CSA(vec_t, vxor, vand, vor, fours, acc[1], acc[1],          \
+                       twos_a, twos_b);                                        \
+            for (size_t s = 2; s < nslices; s++) {                             \
+                const vec_t old = acc[s];                                      \
+                acc[s] = vxor(old, fours);                                     \
+                fours = vand(old, fours);                                      \
+            }                                                                  \
+        }                                                                      \
+        for (; k < count; k++) {                                               \
+            vec_t carry = vload(srcs[k]->words + i);                           \
+            for (size_t s = 0; s < nslices; s++) {                             \
+                const vec_t old = acc[s];                                      \
+                acc[s] = vxor(old, carry);                                     \
+                carry = vand(old, carry);                                      \
+            }                                                                  \
+        }                                                                      \
+        for (size_t s = 0; s < nslices; s++) {                                 \
+            vstore(slices + s * BITSET_CONTAINER_SIZE_IN_WORDS + i, acc[s]);   \
+        }                                                                      \
+    }                                                                          \
+}
+
+#define SCALAR_LOAD(p) (*(p))
+#define SCALAR_STORE(p, v) (*(p) = (v))
+#define SCALAR_XOR(a, b) ((a) ^ (b))
+#define SCALAR_AND(a, b) ((a) & (b))
+#define SCALAR_OR(a, b) ((a) | (b))
+BITSET_COUNT_MANY_FN(_scalar_bitset_count_many, uint64_t, 1, SCALAR_LOAD,
+                     SCALAR_STORE, 0, SCALAR_XOR, SCALAR_AND, SCALAR_OR)
+
+#ifdef CROARING_IS_X64
+#define AVX2_LOAD(p) _mm256_lddqu_si256((const __m256i *)(p))
+#define AVX2_STORE(p, v) _mm256_storeu_si256((__m256i *)(p), (v))
+CROARING_TARGET_AVX2
+BITSET_COUNT_MANY_FN(_avx2_bitset_count_many, __m256i, WORDS_IN_AVX2_REG,
+                     AVX2_LOAD, AVX2_STORE, _mm256_setzero_si256(),
+                     _mm256_xor_si256, _mm256_and_si256, _mm256_or_si256)
+CROARING_UNTARGET_REGION
+
+static void bitset_count_many(const bitset_container_t **srcs, size_t count,
+                              uint64_t *slices, size_t nslices,
+                              bool accumulate) {
+    if ( croaring_avx2() ) {
+        _avx2_bitset_count_many(srcs, count, slices, nslices, accumulate);
+    } else {
+        _scalar_bitset_count_many(srcs, count, slices, nslices, accumulate);
+    }
+}
+
+#elif defined(USENEON)
+#define NEON_LOAD(p) vld1q_u64(p)
+#define NEON_STORE(p, v) vst1q_u64((p), (v))
+BITSET_COUNT_MANY_FN(_neon_bitset_count_many, uint64x2_t, 2, NEON_LOAD,
+                     NEON_STORE, vdupq_n_u64(0), veorq_u64, vandq_u64,
+                     vorrq_u64)
+
+static void bitset_count_many(const bitset_container_t **srcs, size_t count,
+                              uint64_t *slices, size_t nslices,
+                              bool accumulate) {
+    _neon_bitset_count_many(srcs, count, slices, nslices, accumulate);
+}
+
+#else
+
+static void bitset_count_many(const bitset_container_t **srcs, size_t count,
+                              uint64_t *slices, size_t nslices,
+                              bool accumulate) {
+    _scalar_bitset_count_many(srcs, count, slices, nslices, accumulate);
+}
+
+#endif // CROARING_IS_X64
+// clang-format on
+
+void bitset_container_count_many(const bitset_container_t **srcs,
+                                 size_t count, uint64_t *slices,
+                                 size_t nslices) {
+    bitset_count_many(srcs, count, slices, nslices, false);
+}
+
+void bitset_container_count_many_add(const bitset_container_t **srcs,
+                                     size_t count, uint64_t *slices,
+                                     size_t nslices) {
+    bitset_count_many(srcs, count, slices, nslices, true);
+}
+
+/* The exclusive or is the lowest slice of the count, that is, the "ones"
+ * output of the CSA network. */
+int bitset_container_xor_many_nocard(const bitset_container_t **srcs,
+                                     size_t count, bitset_container_t *dst) {
+    bitset_container_count_many(srcs, count, dst->words, 1);
+    dst->cardinality = BITSET_UNKNOWN_CARDINALITY;
+    return dst->cardinality;
+}
+
+int bitset_container_xor_many(const bitset_container_t **srcs, size_t count,
+                              bitset_container_t *dst) {
+    bitset_container_count_many(srcs, count, dst->words, 1);
+    dst->cardinality = bitset_container_compute_cardinality(dst);
+    return dst->cardinality;
+}
+
 
 int bitset_container_to_uint32_array(
     uint32_t *out,
@@ -889,6 +1151,54 @@ int bitset_container_index_equalorlarger(const bitset_container_t *container, ui
   return k * 64 + __builtin_ctzll(word);
 }
 
+void bitset_container_offset(const bitset_container_t *c,
+                             container_t **loc, container_t **hic,
+                             uint16_t offset) {
+    // shifting the words by b words and i bits
+    const int32_t b = offset >> 6;
+    const int32_t i = offset & 63;
+    const int32_t end = BITSET_CONTAINER_SIZE_IN_WORDS - b;
+    const uint64_t *words = c->words;
+
+    if (loc != NULL) {
+        bitset_container_t *lo = bitset_container_create();
+        if (i == 0) {
+            memcpy(lo->words + b, words, end * sizeof(uint64_t));
+        } else {
+            lo->words[b] = words[0] << i;
+            for (int32_t k = 1; k < end; ++k) {
+                lo->words[b + k] = (words[k] << i) | (words[k - 1] >> (64 - i));
+            }
+        }
+        const int32_t lo_card = bitset_container_compute_cardinality(lo);
+        lo->cardinality = lo_card;
+        if (lo_card > 0) {
+            *loc = lo;
+        } else {
+            bitset_container_free(lo);
+        }
+        if (lo_card == c->cardinality) return;  // nothing overflows
+    }
+    if (hic != NULL) {
+        bitset_container_t *hi = bitset_container_create();
+        if (i == 0) {
+            memcpy(hi->words, words + end, b * sizeof(uint64_t));
+        } else {
+            for (int32_t k = end; k < BITSET_CONTAINER_SIZE_IN_WORDS; ++k) {
+                hi->words[k - end] =
+                    (words[k] << i) | (words[k - 1] >> (64 - i));
+            }
+            hi->words[b] = words[BITSET_CONTAINER_SIZE_IN_WORDS - 1] >> (64 - i);
+        }
+        hi->cardinality = bitset_container_compute_cardinality(hi);
+        if (hi->cardinality > 0) {
+            *hic = hi;
+        } else {
+            bitset_container_free(hi);
+        }
+    }
+}
+
 #ifdef __cplusplus
 } } }  // extern "C" { namespace roaring { namespace internal {
 #endif
@@ -136,12 +136,12 @@ container_t *get_copy_of_container(
         shared_container_t *shared_container;
         if (*typecode == SHARED_CONTAINER_TYPE) {
             shared_container = CAST_shared(c);
-            shared_container->counter += 1;
+            croaring_refcount_inc(&shared_container->counter);
             return shared_container;
         }
         assert(*typecode != SHARED_CONTAINER_TYPE);
 
-        if ((shared_container = (shared_container_t *)malloc(
+        if ((shared_container = (shared_container_t *)roaring_malloc(
                  sizeof(shared_container_t))) == NULL) {
             return NULL;
         }
@@ -187,30 +187,31 @@ container_t *container_clone(const container_t *c, uint8_t typecode) {
 container_t *shared_container_extract_copy(
     shared_container_t *sc, uint8_t *typecode
 ){
-    assert(sc->counter > 0);
+    assert(croaring_refcount_get(&sc->counter) > 0);
     assert(sc->typecode != SHARED_CONTAINER_TYPE);
-    sc->counter--;
     *typecode = sc->typecode;
     container_t *answer;
-    if (sc->counter == 0) {
+    if (croaring_refcount_get(&sc->counter) == 1) {  // ours is the only copy
         answer = sc->container;
         sc->container = NULL;  // paranoid
-        free(sc);
+        roaring_free(sc);
     } else {
+        // Clone before releasing our reference: once released, another
+        // thread may free the container at any time.
         answer = container_clone(sc->container, *typecode);
+        shared_container_free(sc);
     }
     assert(*typecode != SHARED_CONTAINER_TYPE);
     return answer;
 }
 
 void shared_container_free(shared_container_t *container) {
-    assert(container->counter > 0);
-    container->counter--;
-    if (container->counter == 0) {
+    assert(croaring_refcount_get(&container->counter) > 0);
+    if (croaring_refcount_dec(&container->counter)) {
         assert(container->typecode != SHARED_CONTAINER_TYPE);
         container_free(container->container, container->typecode);
         container->container = NULL;  // paranoid
-        free(container);
+        roaring_free(container);
     }
 }
 
@@ -252,6 +253,55 @@ extern inline container_t *container_andnot(
         const container_t *c2, uint8_t type2,
         uint8_t *result_type);
 
+// a bitset holding few values after the shift must become an array
+static inline uint8_t offset_bitset_repair(container_t **c) {
+    bitset_container_t *bc = CAST_bitset(*c);
+    if (bc->cardinality > DEFAULT_MAX_SIZE) return BITSET_CONTAINER_TYPE;
+    *c = array_container_from_bitset(bc);
+    bitset_container_free(bc);
+    return ARRAY_CONTAINER_TYPE;
+}
+
+void container_add_offset(const container_t *c, uint8_t type,
+                          container_t **lo, uint8_t *lo_type,
+                          container_t **hi, uint8_t *hi_type,
+                          uint16_t offset) {
+    assert(offset != 0);
+    c = container_unwrap_shared(c, &type);
+    container_t *lo_c = NULL, *hi_c = NULL;
+    uint8_t lo_t = type, hi_t = type;
+    switch (type) {
+        case BITSET_CONTAINER_TYPE:
+            bitset_container_offset(const_CAST_bitset(c),
+                                    lo ? &lo_c : NULL, hi ? &hi_c : NULL,
+                                    offset);
+            if (lo_c != NULL) lo_t = offset_bitset_repair(&lo_c);
+            if (hi_c != NULL) hi_t = offset_bitset_repair(&hi_c);
+            break;
+        case ARRAY_CONTAINER_TYPE:
+            array_container_offset(const_CAST_array(c),
+                                   lo ? &lo_c : NULL, hi ? &hi_c : NULL,
+                                   offset);
+            break;
+        case RUN_CONTAINER_TYPE:
+            run_container_offset(const_CAST_run(c),
+                                 lo ? &lo_c : NULL, hi ? &hi_c : NULL,
+                                 offset);
+            break;
+        default:
+            assert(false);
+            __builtin_unreachable();
+    }
+    if (lo_c != NULL) {
+        *lo = lo_c;
+        *lo_type = lo_t;
+    }
+    if (hi_c != NULL) {
+        *hi = hi_c;
+        *hi_type = hi_t;
+    }
+}
+
 #ifdef __cplusplus
 } } }  // extern "C" { namespace roaring { namespace internal {
 #endif
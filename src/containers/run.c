@@ -2,6 +2,7 @@
 #include <stdlib.h>
 
 #include <roaring/containers/run.h>
+#include <roaring/memory_pool.h>
 #include <roaring/portability.h>
 
 #ifdef __cplusplus
@@ -77,14 +78,18 @@ bool run_container_add(run_container_t *run, uint16_t pos) {
 run_container_t *run_container_create_given_capacity(int32_t size) {
     run_container_t *run;
     /* Allocate the run container itself. */
-    if ((run = (run_container_t *)malloc(sizeof(run_container_t))) == NULL) {
+    if ((run = (run_container_t *)roaring_malloc(sizeof(run_container_t))) == NULL) {
         return NULL;
     }
     if (size <= 0 ) { // we don't want to rely on malloc(0)
         run->runs = NULL;
-    } else if ((run->runs = (rle16_t *)malloc(sizeof(rle16_t) * size)) == NULL) {
-        free(run);
-        return NULL;
+    } else {
+        size_t bytes = sizeof(rle16_t) * size;
+        if ((run->runs = (rle16_t *)roaring_pool_malloc(&bytes)) == NULL) {
+            roaring_free(run);
+            return NULL;
+        }
+        size = (int32_t)(bytes / sizeof(rle16_t));
     }
     run->capacity = size;
     run->n_runs = 0;
@@ -96,8 +101,8 @@ int run_container_shrink_to_fit(run_container_t *src) {
     int savings = src->capacity - src->n_runs;
     src->capacity = src->n_runs;
     rle16_t *oldruns = src->runs;
-    src->runs = (rle16_t *)realloc(oldruns, src->capacity * sizeof(rle16_t));
-    if (src->runs == NULL) free(oldruns);  // should never happen?
+    src->runs = (rle16_t *)roaring_realloc(oldruns, src->capacity * sizeof(rle16_t));
+    if (src->runs == NULL) roaring_free(oldruns);  // should never happen?
     return savings;
 }
 /* Create a new run container. Return NULL in case of failure. */
@@ -108,7 +113,6 @@ run_container_t *run_container_create(void) {
 run_container_t *run_container_clone(const run_container_t *src) {
     run_container_t *run = run_container_create_given_capacity(src->capacity);
     if (run == NULL) return NULL;
-    run->capacity = src->capacity;
     run->n_runs = src->n_runs;
     memcpy(run->runs, src->runs, src->n_runs * sizeof(rle16_t));
     return run;
@@ -117,10 +121,10 @@ run_container_t *run_container_clone(const run_container_t *src) {
 /* Free memory. */
 void run_container_free(run_container_t *run) {
     if(run->runs != NULL) {// Jon Strabala reports that some tools complain otherwise
-      free(run->runs);
+      roaring_pool_free(run->runs, run->capacity * sizeof(rle16_t));
       run->runs = NULL;  // pedantic
     }
-    free(run);
+    roaring_free(run);
 }
 
 void run_container_grow(run_container_t *run, int32_t min, bool copy) {
@@ -131,20 +135,21 @@ void run_container_grow(run_container_t *run, int32_t min, bool copy) {
                                  : run->capacity < 1024 ? run->capacity * 3 / 2
                                                         : run->capacity * 5 / 4;
     if (newCapacity < min) newCapacity = min;
-    run->capacity = newCapacity;
-    assert(run->capacity >= min);
+    size_t old_bytes = run->capacity * sizeof(rle16_t);
+    size_t bytes = newCapacity * sizeof(rle16_t);
     if (copy) {
         rle16_t *oldruns = run->runs;
-        run->runs =
-            (rle16_t *)realloc(oldruns, run->capacity * sizeof(rle16_t));
-        if (run->runs == NULL) free(oldruns);
+        run->runs = (rle16_t *)roaring_pool_realloc(oldruns, old_bytes, &bytes);
+        if (run->runs == NULL) roaring_free(oldruns);
     } else {
         // Jon Strabala reports that some tools complain otherwise
         if (run->runs != NULL) {
-          free(run->runs);
+          roaring_pool_free(run->runs, old_bytes);
         }
-        run->runs = (rle16_t *)malloc(run->capacity * sizeof(rle16_t));
+        run->runs = (rle16_t *)roaring_pool_malloc(&bytes);
     }
+    run->capacity = (int32_t)(bytes / sizeof(rle16_t));
+    assert(run->capacity >= min);
     // handle the case where realloc fails
     if (run->runs == NULL) {
       fprintf(stderr, "could not allocate memory\n");
@@ -843,6 +848,46 @@ int run_container_cardinality(const run_container_t *run) {
 #endif
 
 
+void run_container_offset(const run_container_t *c,
+                          container_t **loc, container_t **hic,
+                          uint16_t offset) {
+    const int32_t top = (1 << 16) - offset;
+    // first run reaching top, which may have to be split in two
+    int32_t pivot = run_container_index_equalorlarger(c, top);
+    if (pivot < 0) pivot = c->n_runs;
+    const bool split = pivot < c->n_runs && c->runs[pivot].value < top;
+    const int32_t lo_runs = pivot + (split ? 1 : 0);
+    const int32_t hi_runs = c->n_runs - pivot;
+
+    if (loc != NULL && lo_runs > 0) {
+        run_container_t *lo = run_container_create_given_capacity(lo_runs);
+        for (int32_t i = 0; i < lo_runs; ++i) {
+            lo->runs[i].value = c->runs[i].value + offset;
+            lo->runs[i].length = c->runs[i].length;
+        }
+        if (split) {  // cut the last run at the end of the container
+            lo->runs[lo_runs - 1].length =
+                UINT16_MAX - lo->runs[lo_runs - 1].value;
+        }
+        lo->n_runs = lo_runs;
+        *loc = lo;
+    }
+    if (hic != NULL && hi_runs > 0) {
+        run_container_t *hi = run_container_create_given_capacity(hi_runs);
+        for (int32_t i = 0; i < hi_runs; ++i) {
+            hi->runs[i].value = c->runs[pivot + i].value + offset;  // wraps
+            hi->runs[i].length = c->runs[pivot + i].length;
+        }
+        if (split) {  // keep the part of the first run past the end
+            hi->runs[0].length = c->runs[pivot].value +
+                                 c->runs[pivot].length - top;
+            hi->runs[0].value = 0;
+        }
+        hi->n_runs = hi_runs;
+        *hic = hi;
+    }
+}
+
 #ifdef __cplusplus
 } } }  // extern "C" { namespace roaring { namespace internal {
 #endif
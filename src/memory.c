@@ -0,0 +1,348 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <roaring/memory.h>
+#include <roaring/memory_pool.h>
+#include <roaring/portability.h>
+
+#if defined(__cplusplus)
+#define ROARING_THREAD_LOCAL thread_local
+#elif defined(_MSC_VER)
+#define ROARING_THREAD_LOCAL __declspec(thread)
+#elif defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 201112L)
+#define ROARING_THREAD_LOCAL _Thread_local
+#else
+#define ROARING_THREAD_LOCAL __thread
+#endif
+
+static void *default_aligned_malloc(size_t alignment, size_t size) {
+    return roaring_bitmap_aligned_malloc(alignment, size);
+}
+
+static void default_aligned_free(void *p) { roaring_bitmap_aligned_free(p); }
+
+static roaring_memory_t global_memory_hook = {
+    malloc, realloc, calloc, free, default_aligned_malloc, default_aligned_free,
+};
+
+void roaring_init_memory_hook(roaring_memory_t memory_hook) {
+    global_memory_hook = memory_hook;
+}
+
+/*
+ * Arena allocations are aligned like malloc's (at least), and the size of each
+ * one is stored in the word that precedes it, so that it can be reallocated.
+ */
+#define ARENA_ALIGNMENT 16
+#define ARENA_MIN_BLOCK_SIZE (64 * 1024)
+
+typedef struct roaring_arena_block_s {
+    struct roaring_arena_block_s *next;
+    size_t capacity;
+    size_t used;
+} roaring_arena_block_t;
+
+static ROARING_THREAD_LOCAL roaring_arena_t *current_arena = NULL;
+
+static inline char *block_data(roaring_arena_block_t *block) {
+    return (char *)(block + 1);
+}
+
+// Bumps `*used` within [base, base + capacity), returns NULL if full.
+static void *region_alloc(char *base, size_t capacity, size_t *used,
+                          size_t alignment, size_t size) {
+    if (base == NULL) return NULL;
+    uintptr_t start = (uintptr_t)(base + *used) + sizeof(size_t);
+    uintptr_t p = (start + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    size_t offset = (size_t)(p - (uintptr_t)base);
+    if (offset > capacity || size > capacity - offset) return NULL;
+    ((size_t *)p)[-1] = size;
+    *used = offset + size;
+    return (void *)p;
+}
+
+static void *arena_malloc(roaring_arena_t *arena, size_t alignment,
+                          size_t size) {
+    if (alignment < ARENA_ALIGNMENT) alignment = ARENA_ALIGNMENT;
+    roaring_arena_block_t *block = arena->blocks;
+    void *p = (block == NULL)
+                  ? region_alloc(arena->buffer, arena->capacity, &arena->used,
+                                 alignment, size)
+                  : region_alloc(block_data(block), block->capacity,
+                                 &block->used, alignment, size);
+    if (p != NULL) return p;
+    // Out of room: chain a new block, each one at least twice the previous.
+    size_t capacity = ARENA_MIN_BLOCK_SIZE;
+    if (block != NULL && block->capacity > capacity / 2) {
+        capacity = 2 * block->capacity;
+    }
+    if (size > SIZE_MAX - alignment - sizeof(size_t) -
+                   sizeof(roaring_arena_block_t)) {
+        return NULL;
+    }
+    if (capacity < size + alignment + sizeof(size_t)) {
+        capacity = size + alignment + sizeof(size_t);
+    }
+    roaring_arena_block_t *fresh = (roaring_arena_block_t *)
+        global_memory_hook.malloc(sizeof(roaring_arena_block_t) + capacity);
+    if (fresh == NULL) return NULL;
+    fresh->next = block;
+    fresh->capacity = capacity;
+    fresh->used = 0;
+    arena->blocks = fresh;
+    return region_alloc(block_data(fresh), capacity, &fresh->used, alignment,
+                        size);
+}
+
+static bool arena_owns(const roaring_arena_t *arena, const void *p) {
+    uintptr_t x = (uintptr_t)p;
+    if (arena->buffer != NULL && x >= (uintptr_t)arena->buffer &&
+        x < (uintptr_t)arena->buffer + arena->capacity) {
+        return true;
+    }
+    for (roaring_arena_block_t *block = arena->blocks; block != NULL;
+         block = block->next) {
+        uintptr_t data = (uintptr_t)block_data(block);
+        if (x >= data && x < data + block->capacity) return true;
+    }
+    return false;
+}
+
+// Grows the last allocation of the current region in place when possible.
+static void *arena_realloc(roaring_arena_t *arena, void *p, size_t new_size) {
+    size_t old_size = ((size_t *)p)[-1];
+    if (new_size <= old_size) return p;
+    char *base = arena->buffer;
+    size_t capacity = arena->capacity;
+    size_t *used = &arena->used;
+    if (arena->blocks != NULL) {
+        base = block_data(arena->blocks);
+        capacity = arena->blocks->capacity;
+        used = &arena->blocks->used;
+    }
+    if (base != NULL && (char *)p + old_size == base + *used &&
+        new_size - old_size <= capacity - *used) {
+        *used += new_size - old_size;
+        ((size_t *)p)[-1] = new_size;
+        return p;
+    }
+    void *fresh = arena_malloc(arena, ARENA_ALIGNMENT, new_size);
+    if (fresh != NULL) memcpy(fresh, p, old_size);
+    return fresh;
+}
+
+void roaring_arena_init(roaring_arena_t *arena, void *buf, size_t size) {
+    arena->buffer = (char *)buf;
+    arena->capacity = (buf == NULL) ? 0 : size;
+    arena->used = 0;
+    arena->blocks = NULL;
+}
+
+roaring_arena_t *roaring_set_thread_arena(roaring_arena_t *arena) {
+    roaring_arena_t *previous = current_arena;
+    current_arena = arena;
+    return previous;
+}
+
+bool roaring_thread_has_arena(void) { return current_arena != NULL; }
+
+bool roaring_outlives_current_arena(const void *p) {
+    return current_arena != NULL && !arena_owns(current_arena, p);
+}
+
+void roaring_arena_reset(roaring_arena_t *arena) {
+    roaring_arena_block_t *block = arena->blocks;
+    while (block != NULL) {
+        roaring_arena_block_t *next = block->next;
+        global_memory_hook.free(block);
+        block = next;
+    }
+    arena->blocks = NULL;
+    arena->used = 0;
+}
+
+void *roaring_malloc(size_t size) {
+    roaring_arena_t *arena = current_arena;
+    if (arena != NULL) return arena_malloc(arena, ARENA_ALIGNMENT, size);
+    return global_memory_hook.malloc(size);
+}
+
+void *roaring_realloc(void *p, size_t new_size) {
+    roaring_arena_t *arena = current_arena;
+    if (arena != NULL) {
+        if (p == NULL) return arena_malloc(arena, ARENA_ALIGNMENT, new_size);
+        if (arena_owns(arena, p)) return arena_realloc(arena, p, new_size);
+    }
+    return global_memory_hook.realloc(p, new_size);
+}
+
+void *roaring_calloc(size_t n_elements, size_t element_size) {
+    roaring_arena_t *arena = current_arena;
+    if (arena != NULL) {
+        if (element_size != 0 && n_elements > SIZE_MAX / element_size) {
+            return NULL;
+        }
+        void *p = arena_malloc(arena, ARENA_ALIGNMENT, n_elements * element_size);
+        if (p != NULL) memset(p, 0, n_elements * element_size);
+        return p;
+    }
+    return global_memory_hook.calloc(n_elements, element_size);
+}
+
+void roaring_free(void *p) {
+    roaring_arena_t *arena = current_arena;
+    if (arena != NULL && (p == NULL || arena_owns(arena, p))) return;
+    global_memory_hook.free(p);
+}
+
+void *roaring_aligned_malloc(size_t alignment, size_t size) {
+    roaring_arena_t *arena = current_arena;
+    if (arena != NULL) return arena_malloc(arena, alignment, size);
+    return global_memory_hook.aligned_malloc(alignment, size);
+}
+
+void roaring_aligned_free(void *p) {
+    roaring_arena_t *arena = current_arena;
+    if (arena != NULL && (p == NULL || arena_owns(arena, p))) return;
+    global_memory_hook.aligned_free(p);
+}
+
+/*
+ * Pools of container buffers. Recycled buffers are chained through their
+ * first word. Array and run buffers are binned by power of two, from
+ * 2^POOL_MIN_SHIFT to 2^POOL_MAX_SHIFT bytes (the largest array container);
+ * a buffer goes into the largest bin it can fill.
+ */
+#define POOL_BITSET_BYTES ((1 << 16) / 8)
+#define POOL_MIN_SHIFT 5
+#define POOL_MAX_SHIFT 13
+#define POOL_BINS (POOL_MAX_SHIFT - POOL_MIN_SHIFT + 1)
+
+typedef struct roaring_pool_s {
+    void *bitset_words;
+    void *buffers[POOL_BINS];
+    size_t size_in_bytes;
+    size_t limit;
+} roaring_pool_t;
+
+static ROARING_THREAD_LOCAL roaring_pool_t container_pool;
+
+// Pooled buffers must not end up in arena bitmaps, which are never freed.
+static inline bool pool_enabled(void) {
+    return container_pool.limit > 0 && current_arena == NULL;
+}
+
+static inline bool pool_accepts(const void *p, size_t size) {
+    if (container_pool.limit == 0 ||
+        size > container_pool.limit - container_pool.size_in_bytes) {
+        return false;
+    }
+    return current_arena == NULL || !arena_owns(current_arena, p);
+}
+
+static inline void *pool_pop(void **head) {
+    void *p = *head;
+    if (p != NULL) *head = *(void **)p;
+    return p;
+}
+
+static inline void pool_push(void **head, void *p) {
+    *(void **)p = *head;
+    *head = p;
+}
+
+static inline int pool_bin_shift(size_t size) {  // smallest bin >= size
+    int shift = POOL_MIN_SHIFT;
+    while (((size_t)1 << shift) < size) shift++;
+    return shift;
+}
+
+uint64_t *roaring_pool_malloc_bitset_words(void) {
+    if (pool_enabled() && container_pool.bitset_words != NULL) {
+        container_pool.size_in_bytes -= POOL_BITSET_BYTES;
+        return (uint64_t *)pool_pop(&container_pool.bitset_words);
+    }
+    // sizeof(__m256i) == 32
+    return (uint64_t *)roaring_aligned_malloc(32, POOL_BITSET_BYTES);
+}
+
+void roaring_pool_free_bitset_words(uint64_t *words) {
+    if (words == NULL) return;
+    if (pool_accepts(words, POOL_BITSET_BYTES)) {
+        pool_push(&container_pool.bitset_words, words);
+        container_pool.size_in_bytes += POOL_BITSET_BYTES;
+        return;
+    }
+    roaring_aligned_free(words);
+}
+
+void *roaring_pool_malloc(size_t *size) {
+    if (!pool_enabled() || *size > ((size_t)1 << POOL_MAX_SHIFT)) {
+        return roaring_malloc(*size);
+    }
+    int shift = pool_bin_shift(*size);
+    *size = (size_t)1 << shift;
+    void **head = &container_pool.buffers[shift - POOL_MIN_SHIFT];
+    if (*head != NULL) {
+        container_pool.size_in_bytes -= *size;
+        return pool_pop(head);
+    }
+    return roaring_malloc(*size);
+}
+
+void *roaring_pool_realloc(void *p, size_t old_size, size_t *size) {
+    if (!pool_enabled() || *size > ((size_t)1 << POOL_MAX_SHIFT)) {
+        return roaring_realloc(p, *size);
+    }
+    void *fresh = roaring_pool_malloc(size);
+    if (fresh == NULL) return NULL;
+    if (p != NULL) {
+        memcpy(fresh, p, old_size < *size ? old_size : *size);
+        roaring_pool_free(p, old_size);
+    }
+    return fresh;
+}
+
+void roaring_pool_free(void *p, size_t size) {
+    if (p == NULL) return;
+    if (size >= ((size_t)1 << POOL_MIN_SHIFT)) {
+        int shift = POOL_MAX_SHIFT;
+        while (((size_t)1 << shift) > size) shift--;
+        size_t bin_size = (size_t)1 << shift;
+        if (pool_accepts(p, bin_size)) {
+            pool_push(&container_pool.buffers[shift - POOL_MIN_SHIFT], p);
+            container_pool.size_in_bytes += bin_size;
+            return;
+        }
+    }
+    roaring_free(p);
+}
+
+// Releases pooled buffers until the pool holds at most `max_bytes`.
+static void pool_trim(size_t max_bytes) {
+    while (container_pool.size_in_bytes > max_bytes &&
+           container_pool.bitset_words != NULL) {
+        global_memory_hook.aligned_free(pool_pop(&container_pool.bitset_words));
+        container_pool.size_in_bytes -= POOL_BITSET_BYTES;
+    }
+    for (int shift = POOL_MAX_SHIFT; shift >= POOL_MIN_SHIFT; shift--) {
+        void **head = &container_pool.buffers[shift - POOL_MIN_SHIFT];
+        while (container_pool.size_in_bytes > max_bytes && *head != NULL) {
+            global_memory_hook.free(pool_pop(head));
+            container_pool.size_in_bytes -= (size_t)1 << shift;
+        }
+    }
+}
+
+void roaring_set_container_pool_limit(size_t max_bytes) {
+    pool_trim(max_bytes);
+    container_pool.limit = max_bytes;
+}
+
+void roaring_flush_container_pool(void) { pool_trim(0); }
+
+size_t roaring_container_pool_size_in_bytes(void) {
+    return container_pool.size_in_bytes;
+}
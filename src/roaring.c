@@ -10,6 +10,7 @@
 
 #include <roaring/containers/containers.h>
 #include <roaring/bitset_util.h>
+#include <roaring/memory_pool.h>
 #include <roaring/array_util.h>
 
 #ifdef __cplusplus
@@ -22,10 +23,18 @@ extern inline bool roaring_bitmap_contains(const roaring_bitmap_t *r,
                                            uint32_t val);
 extern inline bool roaring_bitmap_get_copy_on_write(const roaring_bitmap_t* r);
 extern inline void roaring_bitmap_set_copy_on_write(roaring_bitmap_t* r, bool cow);
+extern inline bool roaring_bitmap_get_cardinality_index(
+    const roaring_bitmap_t *r);
 
 static inline bool is_cow(const roaring_bitmap_t *r) {
     return r->high_low_container.flags & ROARING_FLAG_COW;
 }
+// Whether the containers of 'r' are shared (copy-on-write) rather than cloned.
+// Sharing writes to 'r': while an arena is current, a bitmap that outlives it
+// would be left pointing into the arena, so its containers are cloned.
+static inline bool can_share(const roaring_bitmap_t *r) {
+    return is_cow(r) && !roaring_outlives_current_arena(r);
+}
 static inline bool is_frozen(const roaring_bitmap_t *r) {
     return r->high_low_container.flags & ROARING_FLAG_FROZEN;
 }
@@ -70,13 +79,13 @@ static inline container_t *containerptr_roaring_bitmap_add(
 
 roaring_bitmap_t *roaring_bitmap_create_with_capacity(uint32_t cap) {
     roaring_bitmap_t *ans =
-        (roaring_bitmap_t *)malloc(sizeof(roaring_bitmap_t));
+        (roaring_bitmap_t *)roaring_malloc(sizeof(roaring_bitmap_t));
     if (!ans) {
         return NULL;
     }
     bool is_ok = ra_init_with_capacity(&ans->high_low_container, cap);
     if (!is_ok) {
-        free(ans);
+        roaring_free(ans);
         return NULL;
     }
     return ans;
@@ -87,44 +96,185 @@ bool roaring_bitmap_init_with_capacity(roaring_bitmap_t *r, uint32_t cap) {
 }
 
 
+void roaring_bitmap_add_bulk(roaring_bitmap_t *r,
+                             roaring_bulk_context_t *context, uint32_t val) {
+    if (r->high_low_container.flags & ROARING_FLAG_CARD_INDEX) {
+        // keeps the cached cardinality, but may move the cached container
+        context->container = NULL;
+        roaring_bitmap_add_checked(r, val);
+        return;
+    }
+    const uint16_t key = val >> 16;
+    // a context filled by roaring_bitmap_contains_bulk may hold a shared
+    // container, which must be detached through the regular path
+    if (context->container == NULL || context->key != key ||
+        context->typecode == SHARED_CONTAINER_TYPE) {
+        uint8_t typecode;
+        int idx;
+        context->container =
+            containerptr_roaring_bitmap_add(r, val, &typecode, &idx);
+        context->typecode = typecode;
+        context->idx = idx;
+        context->key = key;
+    } else {
+        // no need to seek the container, it is at hand (and not shared)
+        uint8_t newtypecode = context->typecode;
+        container_t *container2 = container_add(
+            context->container, val & 0xFFFF, context->typecode, &newtypecode);
+        if (container2 != context->container) {  // rare instance when we need
+                                                  // to change the container type
+            container_free(context->container, context->typecode);
+            ra_set_container_at_index(&r->high_low_container, context->idx,
+                                      container2, newtypecode);
+            context->typecode = newtypecode;
+            context->container = container2;
+        }
+    }
+}
+
+bool roaring_bitmap_contains_bulk(const roaring_bitmap_t *r,
+                                  roaring_bulk_context_t *context,
+                                  uint32_t val) {
+    const roaring_array_t *ra = &r->high_low_container;
+    const uint16_t key = val >> 16;
+    if (context->container == NULL || context->key != key) {
+        int32_t idx;
+        if (context->container != NULL && context->key < key) {
+            // gallop forward from the cached container
+            idx = ra_advance_until(ra, key, context->idx);
+        } else {
+            idx = ra_get_index(ra, key);
+            if (idx < 0) idx = -idx - 1;
+        }
+        if (idx == ra->size) return false;
+        uint8_t typecode;
+        context->container = ra_get_container_at_index(ra, idx, &typecode);
+        context->typecode = typecode;
+        context->idx = idx;
+        context->key = ra->keys[idx];
+        if (context->key != key) return false;
+    }
+    return container_contains(context->container, val & 0xFFFF,
+                              context->typecode);
+}
+
+// the values given to roaring_bitmap_add_many may not be aligned (e.g., when
+// they come from a serialized buffer)
+static inline uint32_t load_uint32(const uint32_t *p) {
+    uint32_t val;
+    memcpy(&val, p, sizeof(val));
+    return val;
+}
+
+// builds the container of the 'n' strictly increasing values starting at
+// 'vals', which all have the same 16 high bits
+static container_t *container_from_sorted_uint32(const uint32_t *vals,
+                                                 int32_t n,
+                                                 uint8_t *typecode) {
+    int32_t n_runs = 1;
+    for (int32_t i = 1; i < n; i++) {
+        n_runs += (load_uint32(vals + i) != load_uint32(vals + i - 1) + 1);
+    }
+    const int32_t size_as_run_container =
+        run_container_serialized_size_in_bytes(n_runs);
+    if (size_as_run_container < array_container_serialized_size_in_bytes(n) &&
+        size_as_run_container < bitset_container_serialized_size_in_bytes()) {
+        run_container_t *rc = run_container_create_given_capacity(n_runs);
+        if (!rc) return NULL;
+        int32_t start = 0;
+        for (int32_t i = 1; i <= n; i++) {
+            if (i == n ||
+                load_uint32(vals + i) != load_uint32(vals + i - 1) + 1) {
+                rc->runs[rc->n_runs].value =
+                    (uint16_t)load_uint32(vals + start);
+                rc->runs[rc->n_runs].length = (uint16_t)(i - 1 - start);
+                rc->n_runs++;
+                start = i;
+            }
+        }
+        *typecode = RUN_CONTAINER_TYPE;
+        return rc;
+    }
+    if (n <= DEFAULT_MAX_SIZE) {
+        array_container_t *ac = array_container_create_given_capacity(n);
+        if (!ac) return NULL;
+        for (int32_t i = 0; i < n; i++) {
+            ac->array[i] = (uint16_t)load_uint32(vals + i);
+        }
+        ac->cardinality = n;
+        *typecode = ARRAY_CONTAINER_TYPE;
+        return ac;
+    }
+    bitset_container_t *bc = bitset_container_create();
+    if (!bc) return NULL;
+    for (int32_t i = 0; i < n; i++) {
+        const uint16_t low = (uint16_t)load_uint32(vals + i);
+        bc->words[low >> 6] |= UINT64_C(1) << (low & 63);
+    }
+    bc->cardinality = n;
+    *typecode = BITSET_CONTAINER_TYPE;
+    return bc;
+}
+
+/**
+ * When the values are strictly increasing and come after the content of 'r',
+ * every container is built in one pass and appended. Returns how many values
+ * were appended: 0 (and 'r' is untouched) when the values do not qualify,
+ * fewer than 'n_args' when a container could not be allocated.
+ */
+static size_t roaring_bitmap_append_sorted(roaring_bitmap_t *r, size_t n_args,
+                                           const uint32_t *vals) {
+    roaring_array_t *ra = &r->high_low_container;
+    if (ra->size > 0 &&
+        (load_uint32(vals) >> 16) <= ra->keys[ra->size - 1]) {
+        return 0;
+    }
+    for (size_t i = 1; i < n_args; i++) {
+        if (load_uint32(vals + i) <= load_uint32(vals + i - 1)) return 0;
+    }
+    size_t start = 0;
+    while (start < n_args) {
+        const uint16_t key = (uint16_t)(load_uint32(vals + start) >> 16);
+        size_t end = start + 1;
+        while (end < n_args && (load_uint32(vals + end) >> 16) == key) end++;
+        uint8_t typecode;
+        container_t *c = container_from_sorted_uint32(
+            vals + start, (int32_t)(end - start), &typecode);
+        if (c == NULL) break;  // out of memory
+        if (!extend_array(ra, 1)) {
+            container_free(c, typecode);
+            break;
+        }
+        ra_append(ra, key, c, typecode);
+        start = end;
+    }
+    return start;
+}
+
 void roaring_bitmap_add_many(roaring_bitmap_t *r, size_t n_args,
                              const uint32_t *vals) {
-    container_t *container = NULL;  // hold value of last container touched
-    uint8_t typecode = 0;    // typecode of last container touched
-    uint32_t prev = 0;       // previous valued inserted
-    size_t i = 0;            // index of value
-    int containerindex = 0;
     if (n_args == 0) return;
-    uint32_t val;
-    memcpy(&val, vals + i, sizeof(val));
-    container =
-        containerptr_roaring_bitmap_add(r, val, &typecode, &containerindex);
-    prev = val;
-    i++;
-    for (; i < n_args; i++) {
-        memcpy(&val, vals + i, sizeof(val));
-        if (((prev ^ val) >> 16) ==
-            0) {  // no need to seek the container, it is at hand
-            // because we already have the container at hand, we can do the
-            // insertion
-            // automatically, bypassing the roaring_bitmap_add call
-            uint8_t newtypecode = typecode;
-            container_t *container2 =
-                container_add(container, val & 0xFFFF, typecode, &newtypecode);
-            if (container2 != container) {  // rare instance when we need to
-                                            // change the container type
-                container_free(container, typecode);
-                ra_set_container_at_index(&r->high_low_container,
-                                          containerindex, container2,
-                                          newtypecode);
-                typecode = newtypecode;
-                container = container2;
-            }
-        } else {
-            container = containerptr_roaring_bitmap_add(r, val, &typecode,
-                                                        &containerindex);
+    roaring_array_t *ra = &r->high_low_container;
+    // sorted input (e.g., a sorted column) is common and can be consumed
+    // without a per-value insertion
+    const int32_t size = ra->size;
+    const size_t appended = roaring_bitmap_append_sorted(r, n_args, vals);
+    if (appended > 0) {
+        // only whole containers were appended
+        const uint64_t cardinality = ra->cardinality;
+        ra_invalidate_card_index(ra);
+        if (cardinality != RA_UNKNOWN_CARDINALITY) {
+            ra->cardinality =
+                cardinality + ra_containers_cardinality(ra, size, ra->size);
         }
-        prev = val;
+    }
+    // whatever could not be appended goes through roaring_bitmap_add_bulk,
+    // which maintains the cached cardinality
+    roaring_bulk_context_t context = {0};
+    for (size_t i = appended; i < n_args; i++) {
+        uint32_t val;
+        memcpy(&val, vals + i, sizeof(val));
+        roaring_bitmap_add_bulk(r, &context, val);
     }
 }
 
@@ -187,6 +337,7 @@ roaring_bitmap_t *roaring_bitmap_from_range(uint64_t min, uint64_t max,
 }
 
 void roaring_bitmap_add_range_closed(roaring_bitmap_t *r, uint32_t min, uint32_t max) {
+    ra_invalidate_card_index(&r->high_low_container);
     if (min > max) {
         return;
     }
@@ -237,6 +388,7 @@ void roaring_bitmap_add_range_closed(roaring_bitmap_t *r, uint32_t min, uint32_t
 }
 
 void roaring_bitmap_remove_range_closed(roaring_bitmap_t *r, uint32_t min, uint32_t max) {
+    ra_invalidate_card_index(&r->high_low_container);
     if (min > max) {
         return;
     }
@@ -304,7 +456,7 @@ void roaring_bitmap_printf_describe(const roaring_bitmap_t *r) {
         if (ra->typecodes[i] == SHARED_CONTAINER_TYPE) {
             printf(
                 "(shared count = %" PRIu32 " )",
-                    CAST_shared(ra->containers[i])->counter);
+                croaring_refcount_get(&CAST_shared(ra->containers[i])->counter));
         }
 
         if (i + 1 < ra->size) {
@@ -380,18 +532,18 @@ void roaring_bitmap_statistics(const roaring_bitmap_t *r,
 
 roaring_bitmap_t *roaring_bitmap_copy(const roaring_bitmap_t *r) {
     roaring_bitmap_t *ans =
-        (roaring_bitmap_t *)malloc(sizeof(roaring_bitmap_t));
+        (roaring_bitmap_t *)roaring_malloc(sizeof(roaring_bitmap_t));
     if (!ans) {
         return NULL;
     }
     if (!ra_init_with_capacity(  // allocation of list of containers can fail
                 &ans->high_low_container, r->high_low_container.size)
     ){
-        free(ans);
+        roaring_free(ans);
         return NULL;
     }
     if (!ra_overwrite(  // memory allocation of individual containers may fail
-                &r->high_low_container, &ans->high_low_container, is_cow(r))
+                &r->high_low_container, &ans->high_low_container, can_share(r))
     ){
         roaring_bitmap_free(ans);  // overwrite should leave in freeable state
         return NULL;
@@ -403,14 +555,25 @@ roaring_bitmap_t *roaring_bitmap_copy(const roaring_bitmap_t *r) {
 bool roaring_bitmap_overwrite(roaring_bitmap_t *dest,
                                      const roaring_bitmap_t *src) {
     return ra_overwrite(&src->high_low_container, &dest->high_low_container,
-                        is_cow(src));
+                        can_share(src));
+}
+
+void roaring_bitmap_set_cardinality_index(roaring_bitmap_t *r, bool enable) {
+    if (is_frozen(r)) return;  // the index lives in the frozen buffer
+    roaring_array_t *ra = &r->high_low_container;
+    if (enable) {
+        ra->flags |= ROARING_FLAG_CARD_INDEX;
+    } else {
+        ra_invalidate_card_index(ra);
+        ra->flags &= ~ROARING_FLAG_CARD_INDEX;
+    }
 }
 
 void roaring_bitmap_free(const roaring_bitmap_t *r) {
     if (!is_frozen(r)) {
       ra_clear((roaring_array_t*)&r->high_low_container);
     }
-    free((roaring_bitmap_t*)r);
+    roaring_free((roaring_bitmap_t*)r);
 }
 
 void roaring_bitmap_clear(roaring_bitmap_t *r) {
@@ -419,6 +582,11 @@ void roaring_bitmap_clear(roaring_bitmap_t *r) {
 
 void roaring_bitmap_add(roaring_bitmap_t *r, uint32_t val) {
     roaring_array_t *ra = &r->high_low_container;
+    if (ra->flags & ROARING_FLAG_CARD_INDEX) {
+        // keeps the cached cardinality up to date
+        roaring_bitmap_add_checked(r, val);
+        return;
+    }
 
     const uint16_t hb = val >> 16;
     const int i = ra_get_index(ra, hb);
@@ -472,7 +640,11 @@ bool roaring_bitmap_add_checked(roaring_bitmap_t *r, uint32_t val) {
 
             result = oldCardinality != newCardinality;
         }
+        // the keys do not move: the index can be kept
+        ra_card_index_adjust(&r->high_low_container, i, result);
     } else {
+        const uint64_t cardinality = r->high_low_container.cardinality;
+        ra_invalidate_card_index(&r->high_low_container);
         array_container_t *newac = array_container_create();
         container_t *container = container_add(newac, val & 0xFFFF,
                                         ARRAY_CONTAINER_TYPE, &typecode);
@@ -480,12 +652,19 @@ bool roaring_bitmap_add_checked(roaring_bitmap_t *r, uint32_t val) {
         ra_insert_new_key_value_at(&r->high_low_container, -i - 1, hb,
                                    container, typecode);
         result = true;
+        if (cardinality != RA_UNKNOWN_CARDINALITY) {
+            r->high_low_container.cardinality = cardinality + 1;
+        }
     }
-
     return result;
 }
 
 void roaring_bitmap_remove(roaring_bitmap_t *r, uint32_t val) {
+    if (r->high_low_container.flags & ROARING_FLAG_CARD_INDEX) {
+        // keeps the cached cardinality up to date
+        roaring_bitmap_remove_checked(r, val);
+        return;
+    }
     const uint16_t hb = val >> 16;
     const int i = ra_get_index(&r->high_low_container, hb);
     uint8_t typecode;
@@ -538,8 +717,16 @@ bool roaring_bitmap_remove_checked(roaring_bitmap_t *r, uint32_t val) {
         if (newCardinality != 0) {
             ra_set_container_at_index(&r->high_low_container, i, container2,
                                       newtypecode);
+            // the keys do not move: the index can be kept
+            ra_card_index_adjust(&r->high_low_container, i,
+                                 newCardinality - oldCardinality);
         } else {
+            const uint64_t cardinality = r->high_low_container.cardinality;
+            ra_invalidate_card_index(&r->high_low_container);
             ra_remove_at_index_and_free(&r->high_low_container, i);
+            if (cardinality != RA_UNKNOWN_CARDINALITY) {
+                r->high_low_container.cardinality = cardinality - 1;
+            }
         }
 
         result = oldCardinality != newCardinality;
@@ -552,6 +739,10 @@ void roaring_bitmap_remove_many(roaring_bitmap_t *r, size_t n_args,
     if (n_args == 0 || r->high_low_container.size == 0) {
         return;
     }
+    const uint64_t cardinality = r->high_low_container.cardinality;
+    const bool track = cardinality != RA_UNKNOWN_CARDINALITY;
+    uint64_t removed = 0;
+    ra_invalidate_card_index(&r->high_low_container);
     int32_t pos = -1; // position of the container used in the previous iteration
     for (size_t i = 0; i < n_args; i++) {
         uint16_t key = (uint16_t)(vals[i] >> 16);
@@ -561,6 +752,11 @@ void roaring_bitmap_remove_many(roaring_bitmap_t *r, size_t n_args,
         if (pos >= 0) {
             uint8_t new_typecode;
             container_t *new_container;
+            if (track) {
+                removed += container_get_cardinality(
+                    r->high_low_container.containers[pos],
+                    r->high_low_container.typecodes[pos]);
+            }
             new_container = container_remove(r->high_low_container.containers[pos],
                                              vals[i] & 0xffff,
                                              r->high_low_container.typecodes[pos],
@@ -572,6 +768,10 @@ void roaring_bitmap_remove_many(roaring_bitmap_t *r, size_t n_args,
                                                       pos, key, new_container,
                                                       new_typecode);
             }
+            if (track) {
+                removed -= container_get_cardinality(new_container,
+                                                     new_typecode);
+            }
             if (!container_nonzero_cardinality(new_container, new_typecode)) {
                 container_free(new_container, new_typecode);
                 ra_remove_at_index(&r->high_low_container, pos);
@@ -579,6 +779,7 @@ void roaring_bitmap_remove_many(roaring_bitmap_t *r, size_t n_args,
             }
         }
     }
+    if (track) r->high_low_container.cardinality = cardinality - removed;
 }
 
 // there should be some SIMD optimizations possible here
@@ -621,8 +822,141 @@ roaring_bitmap_t *roaring_bitmap_and(const roaring_bitmap_t *x1,
     return answer;
 }
 
+// entries of the key index used by the n-way operations: the 16-bit key in
+// the high bits, then the input index, then the position of the container
+// within that input
+#define KEY_INDEX_ENTRY(key, input, pos) \
+    (((uint64_t)(key) << 48) | ((uint64_t)(input) << 16) | (uint64_t)(pos))
+#define KEY_INDEX_KEY(entry) ((uint16_t)((entry) >> 48))
+#define KEY_INDEX_INPUT(entry) ((size_t)(((entry) >> 16) & 0xFFFFFFFF))
+#define KEY_INDEX_POS(entry) ((uint16_t)(entry))
+
+static int uint64_compare(const void *a, const void *b) {
+    const uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Returns a sorted index of all the containers of the 'number' bitmaps, so
+ * that the containers sharing a key are contiguous. 'total' receives the
+ * number of entries. Caller is responsible for freeing the result.
+ */
+static uint64_t *build_key_index(size_t number, const roaring_bitmap_t **x,
+                                 size_t *total) {
+    assert(number <= UINT32_MAX);
+    size_t n = 0;
+    for (size_t i = 0; i < number; i++) {
+        n += x[i]->high_low_container.size;
+    }
+    *total = n;
+    if (n == 0) {
+        return NULL;
+    }
+    uint64_t *entries = (uint64_t *)roaring_malloc(n * sizeof(uint64_t));
+    n = 0;
+    for (size_t i = 0; i < number; i++) {
+        const roaring_array_t *ra = &x[i]->high_low_container;
+        for (int32_t pos = 0; pos < ra->size; pos++) {
+            entries[n++] = KEY_INDEX_ENTRY(ra->keys[pos], i, pos);
+        }
+    }
+    qsort(entries, n, sizeof(uint64_t), uint64_compare);
+    return entries;
+}
+
+/**
+ * Union of 'count' containers sharing the same key, none of them shared
+ * (count >= 2). The strategy is picked once from the summed cardinalities:
+ * small sets of arrays are merged, sets of runs are merged as runs, and
+ * everything else is accumulated into a single bitset.
+ */
+static container_t *container_or_many(const container_t **cs,
+                                      const uint8_t *types, size_t count,
+                                      uint8_t *result_type) {
+    int64_t card = 0;
+    size_t arrays = 0, runs = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (container_is_full(cs[i], types[i])) {
+            *result_type = RUN_CONTAINER_TYPE;
+            return run_container_create_range(0, (1 << 16));
+        }
+        card += container_get_cardinality(cs[i], types[i]);
+        arrays += (types[i] == ARRAY_CONTAINER_TYPE);
+        runs += (types[i] == RUN_CONTAINER_TYPE);
+    }
+
+    if (arrays == count && card <= DEFAULT_MAX_SIZE) {
+        // array merge, ping-ponging between two buffers
+        array_container_t *acc =
+            array_container_create_given_capacity((int32_t)card);
+        array_container_t *tmp =
+            array_container_create_given_capacity((int32_t)card);
+        const array_container_t *first = const_CAST_array(cs[0]);
+        memcpy(acc->array, first->array,
+               first->cardinality * sizeof(uint16_t));
+        acc->cardinality = first->cardinality;
+        for (size_t i = 1; i < count; i++) {
+            const array_container_t *ac = const_CAST_array(cs[i]);
+            tmp->cardinality = (int32_t)fast_union_uint16(
+                acc->array, acc->cardinality, ac->array, ac->cardinality,
+                tmp->array);
+            array_container_t *swap = acc;
+            acc = tmp;
+            tmp = swap;
+        }
+        array_container_free(tmp);
+        *result_type = ARRAY_CONTAINER_TYPE;
+        return acc;
+    }
+
+    if (runs == count) {
+        // run merge
+        run_container_t *acc = run_container_clone(const_CAST_run(cs[0]));
+        for (size_t i = 1; i < count; i++) {
+            run_container_union_inplace(acc, const_CAST_run(cs[i]));
+        }
+        return convert_run_to_efficient_container_and_free(acc, result_type);
+    }
+
+    // bitset accumulation
+    bitset_container_t *acc = bitset_container_create();
+    for (size_t i = 0; i < count; i++) {
+        switch (types[i]) {
+            case BITSET_CONTAINER_TYPE:
+                bitset_container_or_nocard(acc, const_CAST_bitset(cs[i]), acc);
+                break;
+            case ARRAY_CONTAINER_TYPE: {
+                const array_container_t *ac = const_CAST_array(cs[i]);
+                bitset_set_list(acc->words, ac->array, ac->cardinality);
+                break;
+            }
+            default: {
+                const run_container_t *rc = const_CAST_run(cs[i]);
+                for (int32_t r = 0; r < rc->n_runs; ++r) {
+                    bitset_set_lenrange(acc->words, rc->runs[r].value,
+                                        rc->runs[r].length);
+                }
+                break;
+            }
+        }
+    }
+    acc->cardinality = bitset_container_compute_cardinality(acc);
+    if (acc->cardinality <= DEFAULT_MAX_SIZE) {
+        array_container_t *ac = array_container_from_bitset(acc);
+        bitset_container_free(acc);
+        *result_type = ARRAY_CONTAINER_TYPE;
+        return ac;
+    }
+    *result_type = BITSET_CONTAINER_TYPE;
+    return acc;
+}
+
 /**
  * Compute the union of 'number' bitmaps.
+ *
+ * Rather than folding the inputs into a growing answer one at a time, the
+ * containers of all inputs are grouped by key and every output container is
+ * computed exactly once, from all of its contributors together.
  */
 roaring_bitmap_t *roaring_bitmap_or_many(size_t number,
                                          const roaring_bitmap_t **x) {
@@ -632,17 +966,150 @@ roaring_bitmap_t *roaring_bitmap_or_many(size_t number,
     if (number == 1) {
         return roaring_bitmap_copy(x[0]);
     }
-    roaring_bitmap_t *answer =
-        roaring_bitmap_lazy_or(x[0], x[1], LAZY_OR_BITSET_CONVERSION);
-    for (size_t i = 2; i < number; i++) {
-        roaring_bitmap_lazy_or_inplace(answer, x[i], LAZY_OR_BITSET_CONVERSION);
+    int32_t maxsize = 0;
+    bool cow = true;
+    for (size_t i = 0; i < number; i++) {
+        const int32_t size = x[i]->high_low_container.size;
+        if (size > maxsize) maxsize = size;
+        cow = cow && is_cow(x[i]);
+    }
+    roaring_bitmap_t *answer = roaring_bitmap_create_with_capacity(maxsize);
+    roaring_bitmap_set_copy_on_write(answer, cow);
+    size_t total;
+    uint64_t *entries = build_key_index(number, x, &total);
+    if (total == 0) {
+        return answer;
+    }
+
+    const container_t **cs =
+        (const container_t **)roaring_malloc(number * sizeof(container_t *));
+    uint8_t *types = (uint8_t *)roaring_malloc(number * sizeof(uint8_t));
+    size_t start = 0;
+    while (start < total) {
+        const uint16_t key = KEY_INDEX_KEY(entries[start]);
+        size_t end = start + 1;
+        while (end < total && KEY_INDEX_KEY(entries[end]) == key) {
+            end++;
+        }
+        if (end - start == 1) {
+            const size_t i = KEY_INDEX_INPUT(entries[start]);
+            const uint16_t pos = KEY_INDEX_POS(entries[start]);
+            ra_append_copy(&answer->high_low_container,
+                           &x[i]->high_low_container, pos, can_share(x[i]));
+        } else {
+            for (size_t k = start; k < end; k++) {
+                const size_t i = KEY_INDEX_INPUT(entries[k]);
+                const uint16_t pos = KEY_INDEX_POS(entries[k]);
+                uint8_t type;
+                const container_t *c = ra_get_container_at_index(
+                                    &x[i]->high_low_container, pos, &type);
+                cs[k - start] = container_unwrap_shared(c, &type);
+                types[k - start] = type;
+            }
+            uint8_t result_type;
+            container_t *c =
+                container_or_many(cs, types, end - start, &result_type);
+            ra_append(&answer->high_low_container, key, c, result_type);
+        }
+        start = end;
     }
-    roaring_bitmap_repair_after_lazy(answer);
+    roaring_free(types);
+    roaring_free(cs);
+    roaring_free(entries);
     return answer;
 }
 
+/**
+ * Exclusive or of 'count' containers sharing the same key, none of them
+ * shared (count >= 2). Returns NULL if the result is empty. Small sets of
+ * arrays are merged; otherwise the bitsets go through the n-way kernel in a
+ * single pass and the arrays and runs are flipped into the result.
+ */
+static container_t *container_xor_many(const container_t **cs,
+                                       const uint8_t *types, size_t count,
+                                       uint8_t *result_type) {
+    int64_t card = 0;
+    size_t arrays = 0, bitsets = 0;
+    for (size_t i = 0; i < count; i++) {
+        card += container_get_cardinality(cs[i], types[i]);
+        arrays += (types[i] == ARRAY_CONTAINER_TYPE);
+        bitsets += (types[i] == BITSET_CONTAINER_TYPE);
+    }
+
+    if (arrays == count && card <= DEFAULT_MAX_SIZE) {
+        // array merge, ping-ponging between two buffers
+        array_container_t *acc =
+            array_container_create_given_capacity((int32_t)card);
+        array_container_t *tmp =
+            array_container_create_given_capacity((int32_t)card);
+        const array_container_t *first = const_CAST_array(cs[0]);
+        memcpy(acc->array, first->array,
+               first->cardinality * sizeof(uint16_t));
+        acc->cardinality = first->cardinality;
+        for (size_t i = 1; i < count; i++) {
+            const array_container_t *ac = const_CAST_array(cs[i]);
+            tmp->cardinality = xor_uint16(acc->array, acc->cardinality,
+                                          ac->array, ac->cardinality,
+                                          tmp->array);
+            array_container_t *swap = acc;
+            acc = tmp;
+            tmp = swap;
+        }
+        array_container_free(tmp);
+        if (acc->cardinality == 0) {
+            array_container_free(acc);
+            return NULL;
+        }
+        *result_type = ARRAY_CONTAINER_TYPE;
+        return acc;
+    }
+
+    bitset_container_t *acc = bitset_container_create();
+    if (bitsets > 0) {
+        const bitset_container_t **bs = (const bitset_container_t **)roaring_malloc(
+            bitsets * sizeof(bitset_container_t *));
+        size_t nb = 0;
+        for (size_t i = 0; i < count; i++) {
+            if (types[i] == BITSET_CONTAINER_TYPE) {
+                bs[nb++] = const_CAST_bitset(cs[i]);
+            }
+        }
+        bitset_container_xor_many_nocard(bs, nb, acc);
+        roaring_free(bs);
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (types[i] == ARRAY_CONTAINER_TYPE) {
+            const array_container_t *ac = const_CAST_array(cs[i]);
+            bitset_flip_list(acc->words, ac->array, ac->cardinality);
+        } else if (types[i] == RUN_CONTAINER_TYPE) {
+            const run_container_t *rc = const_CAST_run(cs[i]);
+            for (int32_t r = 0; r < rc->n_runs; ++r) {
+                const uint32_t start = rc->runs[r].value;
+                bitset_flip_range(acc->words, start,
+                                  start + rc->runs[r].length + 1);
+            }
+        }
+    }
+    acc->cardinality = bitset_container_compute_cardinality(acc);
+    if (acc->cardinality == 0) {
+        bitset_container_free(acc);
+        return NULL;
+    }
+    if (acc->cardinality <= DEFAULT_MAX_SIZE) {
+        array_container_t *ac = array_container_from_bitset(acc);
+        bitset_container_free(acc);
+        *result_type = ARRAY_CONTAINER_TYPE;
+        return ac;
+    }
+    *result_type = BITSET_CONTAINER_TYPE;
+    return acc;
+}
+
 /**
  * Compute the xor of 'number' bitmaps.
+ *
+ * As with roaring_bitmap_or_many, the containers are grouped by key and each
+ * output container is computed once from all of its contributors.
  */
 roaring_bitmap_t *roaring_bitmap_xor_many(size_t number,
                                           const roaring_bitmap_t **x) {
@@ -652,11 +1119,312 @@ roaring_bitmap_t *roaring_bitmap_xor_many(size_t number,
     if (number == 1) {
         return roaring_bitmap_copy(x[0]);
     }
-    roaring_bitmap_t *answer = roaring_bitmap_lazy_xor(x[0], x[1]);
-    for (size_t i = 2; i < number; i++) {
-        roaring_bitmap_lazy_xor_inplace(answer, x[i]);
+    int32_t maxsize = 0;
+    bool cow = true;
+    for (size_t i = 0; i < number; i++) {
+        const int32_t size = x[i]->high_low_container.size;
+        if (size > maxsize) maxsize = size;
+        cow = cow && is_cow(x[i]);
+    }
+    roaring_bitmap_t *answer = roaring_bitmap_create_with_capacity(maxsize);
+    roaring_bitmap_set_copy_on_write(answer, cow);
+    size_t total;
+    uint64_t *entries = build_key_index(number, x, &total);
+    if (total == 0) {
+        return answer;
+    }
+
+    const container_t **cs =
+        (const container_t **)roaring_malloc(number * sizeof(container_t *));
+    uint8_t *types = (uint8_t *)roaring_malloc(number * sizeof(uint8_t));
+    size_t start = 0;
+    while (start < total) {
+        const uint16_t key = KEY_INDEX_KEY(entries[start]);
+        size_t end = start + 1;
+        while (end < total && KEY_INDEX_KEY(entries[end]) == key) {
+            end++;
+        }
+        if (end - start == 1) {
+            const size_t i = KEY_INDEX_INPUT(entries[start]);
+            const uint16_t pos = KEY_INDEX_POS(entries[start]);
+            ra_append_copy(&answer->high_low_container,
+                           &x[i]->high_low_container, pos, can_share(x[i]));
+        } else {
+            for (size_t k = start; k < end; k++) {
+                const size_t i = KEY_INDEX_INPUT(entries[k]);
+                const uint16_t pos = KEY_INDEX_POS(entries[k]);
+                uint8_t type;
+                const container_t *c = ra_get_container_at_index(
+                                    &x[i]->high_low_container, pos, &type);
+                cs[k - start] = container_unwrap_shared(c, &type);
+                types[k - start] = type;
+            }
+            uint8_t result_type;
+            container_t *c =
+                container_xor_many(cs, types, end - start, &result_type);
+            if (c != NULL) {
+                ra_append(&answer->high_low_container, key, c, result_type);
+            }
+        }
+        start = end;
     }
-    roaring_bitmap_repair_after_lazy(answer);
+    roaring_free(types);
+    roaring_free(cs);
+    roaring_free(entries);
+    return answer;
+}
+
+/**
+ * Compute the intersection of 'number' bitmaps.
+ *
+ * The keys are intersected first (leapfrogging on the largest current key),
+ * so that only keys present in every input are visited. For each such key the
+ * containers are intersected from the smallest cardinality upward, and we stop
+ * as soon as the running result is empty. No intermediate bitmap is built.
+ */
+roaring_bitmap_t *roaring_bitmap_and_many(size_t number,
+                                          const roaring_bitmap_t **x) {
+    if (number == 0) {
+        return roaring_bitmap_create();
+    }
+    if (number == 1) {
+        return roaring_bitmap_copy(x[0]);
+    }
+    int32_t neededcap = x[0]->high_low_container.size;
+    bool cow = true;
+    for (size_t i = 0; i < number; i++) {
+        if (x[i]->high_low_container.size < neededcap) {
+            neededcap = x[i]->high_low_container.size;
+        }
+        cow = cow && is_cow(x[i]);
+    }
+    roaring_bitmap_t *answer = roaring_bitmap_create_with_capacity(neededcap);
+    roaring_bitmap_set_copy_on_write(answer, cow);
+    if (neededcap == 0) {
+        return answer;
+    }
+
+    int32_t *pos = (int32_t *)roaring_calloc(number, sizeof(int32_t));
+    const container_t **cs =
+        (const container_t **)roaring_malloc(number * sizeof(container_t *));
+    uint8_t *types = (uint8_t *)roaring_malloc(number * sizeof(uint8_t));
+    int32_t *cards = (int32_t *)roaring_malloc(number * sizeof(int32_t));
+
+    uint16_t key = ra_get_key_at_index(&x[0]->high_low_container, 0);
+    while (true) {
+        // advance every input to 'key'; restart whenever someone overshoots
+        size_t matched = 0;
+        size_t i = 0;
+        while (matched < number) {
+            const roaring_array_t *ra = &x[i]->high_low_container;
+            if (ra->keys[pos[i]] < key) {
+                pos[i] = ra_advance_until(ra, key, pos[i]);
+                if (pos[i] == ra->size) goto done;
+            }
+            const uint16_t s = ra->keys[pos[i]];
+            if (s > key) {
+                key = s;
+                matched = 1;
+            } else {
+                matched++;
+            }
+            i = (i + 1 == number) ? 0 : i + 1;
+        }
+
+        // all inputs are at 'key': sort containers by cardinality
+        for (i = 0; i < number; i++) {
+            uint8_t type;
+            const container_t *c = ra_get_container_at_index(
+                                    &x[i]->high_low_container, pos[i], &type);
+            const int32_t card = container_get_cardinality(c, type);
+            size_t j = i;
+            while (j > 0 && cards[j - 1] > card) {
+                cs[j] = cs[j - 1];
+                types[j] = types[j - 1];
+                cards[j] = cards[j - 1];
+                j--;
+            }
+            cs[j] = c;
+            types[j] = type;
+            cards[j] = card;
+        }
+
+        uint8_t result_type;
+        container_t *c = container_and(cs[0], types[0], cs[1], types[1],
+                                       &result_type);
+        for (i = 2; i < number && container_nonzero_cardinality(c, result_type);
+             i++) {
+            uint8_t new_type;
+            container_t *c2 =
+                container_iand(c, result_type, cs[i], types[i], &new_type);
+            if (c2 != c) {
+                container_free(c, result_type);
+            }
+            c = c2;
+            result_type = new_type;
+        }
+        if (container_nonzero_cardinality(c, result_type)) {
+            ra_append(&answer->high_low_container, key, c, result_type);
+        } else {
+            container_free(c, result_type);  // otherwise: memory leak!
+        }
+
+        // move past the current key
+        for (i = 0; i < number; i++) {
+            if (++pos[i] == x[i]->high_low_container.size) goto done;
+        }
+        key = ra_get_key_at_index(&x[0]->high_low_container, pos[0]);
+    }
+
+done:
+    roaring_free(cards);
+    roaring_free(types);
+    roaring_free(cs);
+    roaring_free(pos);
+    return answer;
+}
+
+/**
+ * Writes to 'out' the positions where the bit-sliced counter is at least
+ * 'threshold'.
+ */
+static void bitsliced_counter_at_least(const uint64_t *slices, size_t nslices,
+                                       uint64_t threshold, uint64_t *out) {
+    for (size_t w = 0; w < BITSET_CONTAINER_SIZE_IN_WORDS; w++) {
+        uint64_t gt = 0, eq = ~UINT64_C(0);
+        for (size_t s = nslices; s-- > 0;) {
+            const uint64_t word = slices[s * BITSET_CONTAINER_SIZE_IN_WORDS + w];
+            if ((threshold >> s) & 1) {
+                eq &= word;
+            } else {
+                gt |= eq & word;
+                eq &= ~word;
+            }
+        }
+        out[w] = gt | eq;
+    }
+}
+
+/**
+ * Compute the set of values present in at least 'threshold' of the 'number'
+ * bitmaps.
+ *
+ * Only keys found in at least 'threshold' inputs are visited. For each of
+ * them, the containers are counted in batches into bit-sliced counters (one
+ * bitset of BITSET_CONTAINER_SIZE_IN_WORDS words per bit of the count) by
+ * bitset_container_count_many_add, and the counters are then compared against
+ * the threshold, 64 values at a time.
+ */
+roaring_bitmap_t *roaring_bitmap_threshold_many(size_t number,
+                                                const roaring_bitmap_t **x,
+                                                size_t threshold) {
+    if (threshold <= 1) {
+        return roaring_bitmap_or_many(number, x);
+    }
+    if (threshold > number) {
+        return roaring_bitmap_create();
+    }
+    if (threshold == number) {
+        return roaring_bitmap_and_many(number, x);
+    }
+    int32_t maxsize = 0;
+    bool cow = true;
+    for (size_t i = 0; i < number; i++) {
+        const int32_t size = x[i]->high_low_container.size;
+        if (size > maxsize) maxsize = size;
+        cow = cow && is_cow(x[i]);
+    }
+    roaring_bitmap_t *answer = roaring_bitmap_create_with_capacity(maxsize);
+    roaring_bitmap_set_copy_on_write(answer, cow);
+    size_t total;
+    uint64_t *entries = build_key_index(number, x, &total);
+    if (total == 0) {
+        return answer;
+    }
+
+    size_t maxslices = 0;
+    while (maxslices < 64 && (number >> maxslices) != 0) maxslices++;
+    uint64_t *slices = (uint64_t *)roaring_aligned_malloc(
+        32, maxslices * BITSET_CONTAINER_SIZE_IN_WORDS * sizeof(uint64_t));
+    // the containers that are not bitsets are converted into scratch bitsets
+    enum { THRESHOLD_BATCH = 32 };
+    const bitset_container_t *batch[THRESHOLD_BATCH];
+    bitset_container_t *scratch[THRESHOLD_BATCH] = {NULL};
+    bitset_container_t *result = NULL;
+
+    size_t start = 0;
+    while (start < total) {
+        const uint16_t key = KEY_INDEX_KEY(entries[start]);
+        size_t end = start + 1;
+        while (end < total && KEY_INDEX_KEY(entries[end]) == key) {
+            end++;
+        }
+        const size_t count = end - start;
+        if (count < threshold) {
+            start = end;
+            continue;
+        }
+        size_t nslices = 0;
+        while ((count >> nslices) != 0) nslices++;
+        memset(slices, 0,
+               nslices * BITSET_CONTAINER_SIZE_IN_WORDS * sizeof(uint64_t));
+        size_t nbatch = 0, nscratch = 0;
+        for (size_t k = start; k < end; k++) {
+            uint8_t type;
+            const container_t *c = ra_get_container_at_index(
+                &x[KEY_INDEX_INPUT(entries[k])]->high_low_container,
+                KEY_INDEX_POS(entries[k]), &type);
+            c = container_unwrap_shared(c, &type);
+            if (type == BITSET_CONTAINER_TYPE) {
+                batch[nbatch++] = const_CAST_bitset(c);
+            } else {
+                if (scratch[nscratch] == NULL) {
+                    scratch[nscratch] = bitset_container_create();
+                }
+                bitset_container_t *bc = scratch[nscratch++];
+                bitset_container_clear(bc);
+                if (type == ARRAY_CONTAINER_TYPE) {
+                    const array_container_t *ac = const_CAST_array(c);
+                    bitset_set_list(bc->words, ac->array, ac->cardinality);
+                } else {
+                    const run_container_t *rc = const_CAST_run(c);
+                    for (int32_t r = 0; r < rc->n_runs; ++r) {
+                        bitset_set_lenrange(bc->words, rc->runs[r].value,
+                                            rc->runs[r].length);
+                    }
+                }
+                batch[nbatch++] = bc;
+            }
+            if (nbatch == THRESHOLD_BATCH || k + 1 == end) {
+                bitset_container_count_many_add(batch, nbatch, slices,
+                                                nslices);
+                nbatch = nscratch = 0;
+            }
+        }
+        if (result == NULL) {
+            result = bitset_container_create();
+        }
+        bitsliced_counter_at_least(slices, nslices, threshold, result->words);
+        result->cardinality = bitset_container_compute_cardinality(result);
+        if (result->cardinality > DEFAULT_MAX_SIZE) {
+            ra_append(&answer->high_low_container, key, result,
+                      BITSET_CONTAINER_TYPE);
+            result = NULL;
+        } else if (result->cardinality > 0) {
+            ra_append(&answer->high_low_container, key,
+                      array_container_from_bitset(result),
+                      ARRAY_CONTAINER_TYPE);
+        }
+        start = end;
+    }
+    if (result != NULL) {
+        bitset_container_free(result);
+    }
+    for (size_t i = 0; i < THRESHOLD_BATCH && scratch[i] != NULL; i++) {
+        bitset_container_free(scratch[i]);
+    }
+    roaring_aligned_free(slices);
+    roaring_free(entries);
     return answer;
 }
 
@@ -664,6 +1432,11 @@ roaring_bitmap_t *roaring_bitmap_xor_many(size_t number,
 void roaring_bitmap_and_inplace(roaring_bitmap_t *x1,
                                 const roaring_bitmap_t *x2) {
     if (x1 == x2) return;
+    // a cached cardinality is rebuilt from the containers that are kept
+    const bool track =
+        x1->high_low_container.cardinality != RA_UNKNOWN_CARDINALITY;
+    uint64_t cardinality = 0;
+    ra_invalidate_card_index(&x1->high_low_container);
     int pos1 = 0, pos2 = 0, intersection_size = 0;
     const int length1 = ra_get_size(&x1->high_low_container);
     const int length2 = ra_get_size(&x2->high_low_container);
@@ -696,6 +1469,9 @@ void roaring_bitmap_and_inplace(roaring_bitmap_t *x1,
                 container_free(c1, type1);
             }
             if (container_nonzero_cardinality(c, result_type)) {
+                if (track) {
+                    cardinality += container_get_cardinality(c, result_type);
+                }
                 ra_replace_key_and_container_at_index(&x1->high_low_container,
                                                       intersection_size, s1, c,
                                                       result_type);
@@ -722,6 +1498,7 @@ void roaring_bitmap_and_inplace(roaring_bitmap_t *x1,
 
     // all containers after this have either been copied or freed
     ra_downsize(&x1->high_low_container, intersection_size);
+    if (track) x1->high_low_container.cardinality = cardinality;
 }
 
 roaring_bitmap_t *roaring_bitmap_or(const roaring_bitmap_t *x1,
@@ -765,8 +1542,8 @@ roaring_bitmap_t *roaring_bitmap_or(const roaring_bitmap_t *x1,
             container_t *c1 = ra_get_container_at_index(
                                     &x1->high_low_container, pos1, &type1);
             // c1 = container_clone(c1, type1);
-            c1 = get_copy_of_container(c1, &type1, is_cow(x1));
-            if (is_cow(x1)) {
+            c1 = get_copy_of_container(c1, &type1, can_share(x1));
+            if (can_share(x1)) {
                 ra_set_container_at_index(&x1->high_low_container, pos1, c1,
                                           type1);
             }
@@ -779,8 +1556,8 @@ roaring_bitmap_t *roaring_bitmap_or(const roaring_bitmap_t *x1,
             container_t *c2 = ra_get_container_at_index(
                                     &x2->high_low_container, pos2, &type2);
             // c2 = container_clone(c2, type2);
-            c2 = get_copy_of_container(c2, &type2, is_cow(x2));
-            if (is_cow(x2)) {
+            c2 = get_copy_of_container(c2, &type2, can_share(x2));
+            if (can_share(x2)) {
                 ra_set_container_at_index(&x2->high_low_container, pos2, c2,
                                           type2);
             }
@@ -793,11 +1570,11 @@ roaring_bitmap_t *roaring_bitmap_or(const roaring_bitmap_t *x1,
     if (pos1 == length1) {
         ra_append_copy_range(&answer->high_low_container,
                              &x2->high_low_container, pos2, length2,
-                             is_cow(x2));
+                             can_share(x2));
     } else if (pos2 == length2) {
         ra_append_copy_range(&answer->high_low_container,
                              &x1->high_low_container, pos1, length1,
-                             is_cow(x1));
+                             can_share(x1));
     }
     return answer;
 }
@@ -811,8 +1588,17 @@ void roaring_bitmap_or_inplace(roaring_bitmap_t *x1,
 
     if (0 == length2) return;
 
+    // a cached cardinality is adjusted key by key
+    uint64_t cardinality = x1->high_low_container.cardinality;
+    const bool track = cardinality != RA_UNKNOWN_CARDINALITY;
+    ra_invalidate_card_index(&x1->high_low_container);
+
     if (0 == length1) {
         roaring_bitmap_overwrite(x1, x2);
+        if (track) {
+            x1->high_low_container.cardinality =
+                ra_containers_cardinality(&x1->high_low_container, 0, length2);
+        }
         return;
     }
     int pos1 = 0, pos2 = 0;
@@ -826,6 +1612,7 @@ void roaring_bitmap_or_inplace(roaring_bitmap_t *x1,
             if (!container_is_full(c1, type1)) {
                 container_t *c2 = ra_get_container_at_index(
                                         &x2->high_low_container, pos2, &type2);
+                if (track) cardinality -= container_get_cardinality(c1, type1);
                 container_t *c =
                     (type1 == SHARED_CONTAINER_TYPE)
                         ? container_or(c1, type1, c2, type2, &result_type)
@@ -835,6 +1622,9 @@ void roaring_bitmap_or_inplace(roaring_bitmap_t *x1,
                                 // and we need to free the old one
                     container_free(c1, type1);
                 }
+                if (track) {
+                    cardinality += container_get_cardinality(c, result_type);
+                }
                 ra_set_container_at_index(&x1->high_low_container, pos1, c,
                                           result_type);
             }
@@ -853,13 +1643,14 @@ void roaring_bitmap_or_inplace(roaring_bitmap_t *x1,
         } else {  // s1 > s2
             container_t *c2 = ra_get_container_at_index(&x2->high_low_container,
                                                         pos2, &type2);
-            c2 = get_copy_of_container(c2, &type2, is_cow(x2));
-            if (is_cow(x2)) {
+            c2 = get_copy_of_container(c2, &type2, can_share(x2));
+            if (can_share(x2)) {
                 ra_set_container_at_index(&x2->high_low_container, pos2, c2,
                                           type2);
             }
 
             // container_t *c2_clone = container_clone(c2, type2);
+            if (track) cardinality += container_get_cardinality(c2, type2);
             ra_insert_new_key_value_at(&x1->high_low_container, pos1, s2, c2,
                                        type2);
             pos1++;
@@ -870,9 +1661,14 @@ void roaring_bitmap_or_inplace(roaring_bitmap_t *x1,
         }
     }
     if (pos1 == length1) {
+        if (track) {
+            cardinality += ra_containers_cardinality(&x2->high_low_container,
+                                                     pos2, length2);
+        }
         ra_append_copy_range(&x1->high_low_container, &x2->high_low_container,
-                             pos2, length2, is_cow(x2));
+                             pos2, length2, can_share(x2));
     }
+    if (track) x1->high_low_container.cardinality = cardinality;
 }
 
 roaring_bitmap_t *roaring_bitmap_xor(const roaring_bitmap_t *x1,
@@ -916,8 +1712,8 @@ roaring_bitmap_t *roaring_bitmap_xor(const roaring_bitmap_t *x1,
         } else if (s1 < s2) {  // s1 < s2
             container_t *c1 = ra_get_container_at_index(
                                 &x1->high_low_container, pos1, &type1);
-            c1 = get_copy_of_container(c1, &type1, is_cow(x1));
-            if (is_cow(x1)) {
+            c1 = get_copy_of_container(c1, &type1, can_share(x1));
+            if (can_share(x1)) {
                 ra_set_container_at_index(&x1->high_low_container, pos1, c1,
                                           type1);
             }
@@ -929,8 +1725,8 @@ roaring_bitmap_t *roaring_bitmap_xor(const roaring_bitmap_t *x1,
         } else {  // s1 > s2
             container_t *c2 = ra_get_container_at_index(
                                 &x2->high_low_container, pos2, &type2);
-            c2 = get_copy_of_container(c2, &type2, is_cow(x2));
-            if (is_cow(x2)) {
+            c2 = get_copy_of_container(c2, &type2, can_share(x2));
+            if (can_share(x2)) {
                 ra_set_container_at_index(&x2->high_low_container, pos2, c2,
                                           type2);
             }
@@ -943,11 +1739,11 @@ roaring_bitmap_t *roaring_bitmap_xor(const roaring_bitmap_t *x1,
     if (pos1 == length1) {
         ra_append_copy_range(&answer->high_low_container,
                              &x2->high_low_container, pos2, length2,
-                             is_cow(x2));
+                             can_share(x2));
     } else if (pos2 == length2) {
         ra_append_copy_range(&answer->high_low_container,
                              &x1->high_low_container, pos1, length1,
-                             is_cow(x1));
+                             can_share(x1));
     }
     return answer;
 }
@@ -963,8 +1759,17 @@ void roaring_bitmap_xor_inplace(roaring_bitmap_t *x1,
 
     if (0 == length2) return;
 
+    // a cached cardinality is adjusted key by key
+    uint64_t cardinality = x1->high_low_container.cardinality;
+    const bool track = cardinality != RA_UNKNOWN_CARDINALITY;
+    ra_invalidate_card_index(&x1->high_low_container);
+
     if (0 == length1) {
         roaring_bitmap_overwrite(x1, x2);
+        if (track) {
+            x1->high_low_container.cardinality =
+                ra_containers_cardinality(&x1->high_low_container, 0, length2);
+        }
         return;
     }
 
@@ -988,6 +1793,7 @@ void roaring_bitmap_xor_inplace(roaring_bitmap_t *x1,
             // less efficient than avoiding in place entirely and always generating a new
             // container.
 
+            if (track) cardinality -= container_get_cardinality(c1, type1);
             container_t *c;
             if (type1 == SHARED_CONTAINER_TYPE) {
                 c = container_xor(c1, type1, c2, type2, &result_type);
@@ -998,6 +1804,9 @@ void roaring_bitmap_xor_inplace(roaring_bitmap_t *x1,
             }
 
             if (container_nonzero_cardinality(c, result_type)) {
+                if (track) {
+                    cardinality += container_get_cardinality(c, result_type);
+                }
                 ra_set_container_at_index(&x1->high_low_container, pos1, c,
                                           result_type);
                 ++pos1;
@@ -1021,12 +1830,13 @@ void roaring_bitmap_xor_inplace(roaring_bitmap_t *x1,
         } else {  // s1 > s2
             container_t *c2 = ra_get_container_at_index(
                                     &x2->high_low_container, pos2, &type2);
-            c2 = get_copy_of_container(c2, &type2, is_cow(x2));
-            if (is_cow(x2)) {
+            c2 = get_copy_of_container(c2, &type2, can_share(x2));
+            if (can_share(x2)) {
                 ra_set_container_at_index(&x2->high_low_container, pos2, c2,
                                           type2);
             }
 
+            if (track) cardinality += container_get_cardinality(c2, type2);
             ra_insert_new_key_value_at(&x1->high_low_container, pos1, s2, c2,
                                        type2);
             pos1++;
@@ -1037,9 +1847,14 @@ void roaring_bitmap_xor_inplace(roaring_bitmap_t *x1,
         }
     }
     if (pos1 == length1) {
+        if (track) {
+            cardinality += ra_containers_cardinality(&x2->high_low_container,
+                                                     pos2, length2);
+        }
         ra_append_copy_range(&x1->high_low_container, &x2->high_low_container,
-                             pos2, length2, is_cow(x2));
+                             pos2, length2, can_share(x2));
     }
+    if (track) x1->high_low_container.cardinality = cardinality;
 }
 
 roaring_bitmap_t *roaring_bitmap_andnot(const roaring_bitmap_t *x1,
@@ -1088,7 +1903,7 @@ roaring_bitmap_t *roaring_bitmap_andnot(const roaring_bitmap_t *x1,
                 ra_advance_until(&x1->high_low_container, s2, pos1);
             ra_append_copy_range(&answer->high_low_container,
                                  &x1->high_low_container, pos1, next_pos1,
-                                 is_cow(x1));
+                                 can_share(x1));
             // TODO : perhaps some of the copy_on_write should be based on
             // answer rather than x1 (more stringent?).  Many similar cases
             pos1 = next_pos1;
@@ -1101,7 +1916,7 @@ roaring_bitmap_t *roaring_bitmap_andnot(const roaring_bitmap_t *x1,
     if (pos2 == length2) {
         ra_append_copy_range(&answer->high_low_container,
                              &x1->high_low_container, pos1, length1,
-                             is_cow(x1));
+                             can_share(x1));
     }
     return answer;
 }
@@ -1119,8 +1934,14 @@ void roaring_bitmap_andnot_inplace(roaring_bitmap_t *x1,
 
     if (0 == length2) return;
 
+    // a cached cardinality is adjusted key by key
+    uint64_t cardinality = x1->high_low_container.cardinality;
+    const bool track = cardinality != RA_UNKNOWN_CARDINALITY;
+    ra_invalidate_card_index(&x1->high_low_container);
+
     if (0 == length1) {
         roaring_bitmap_clear(x1);
+        if (track) x1->high_low_container.cardinality = 0;
         return;
     }
 
@@ -1141,6 +1962,7 @@ void roaring_bitmap_andnot_inplace(roaring_bitmap_t *x1,
             // less efficient than avoiding in place entirely and always generating a new
             // container.
 
+            if (track) cardinality -= container_get_cardinality(c1, type1);
             container_t *c;
             if (type1 == SHARED_CONTAINER_TYPE) {
                 c = container_andnot(c1, type1, c2, type2, &result_type);
@@ -1151,6 +1973,9 @@ void roaring_bitmap_andnot_inplace(roaring_bitmap_t *x1,
             }
 
             if (container_nonzero_cardinality(c, result_type)) {
+                if (track) {
+                    cardinality += container_get_cardinality(c, result_type);
+                }
                 ra_replace_key_and_container_at_index(&x1->high_low_container,
                                                       intersection_size++, s1,
                                                       c, result_type);
@@ -1202,15 +2027,11 @@ void roaring_bitmap_andnot_inplace(roaring_bitmap_t *x1,
         intersection_size += (length1 - pos1);
     }
     ra_downsize(&x1->high_low_container, intersection_size);
+    if (track) x1->high_low_container.cardinality = cardinality;
 }
 
 uint64_t roaring_bitmap_get_cardinality(const roaring_bitmap_t *r) {
-    const roaring_array_t *ra = &r->high_low_container;
-
-    uint64_t card = 0;
-    for (int i = 0; i < ra->size; ++i)
-        card += container_get_cardinality(ra->containers[i], ra->typecodes[i]);
-    return card;
+    return ra_get_cardinality(&r->high_low_container);
 }
 
 uint64_t roaring_bitmap_range_cardinality(const roaring_bitmap_t *r,
@@ -1227,6 +2048,14 @@ uint64_t roaring_bitmap_range_cardinality(const roaring_bitmap_t *r,
     range_end--; // make range_end inclusive
     // now we have: 0 <= range_start <= range_end <= UINT32_MAX
 
+    if (ra_get_card_index(ra) != NULL) {
+        uint64_t card = roaring_bitmap_rank(r, (uint32_t)range_end);
+        if (range_start > 0) {
+            card -= roaring_bitmap_rank(r, (uint32_t)(range_start - 1));
+        }
+        return card;
+    }
+
     uint16_t minhb = range_start >> 16;
     uint16_t maxhb = range_end >> 16;
 
@@ -1380,7 +2209,7 @@ size_t roaring_bitmap_portable_size_in_bytes(const roaring_bitmap_t *r) {
 
 roaring_bitmap_t *roaring_bitmap_portable_deserialize_safe(const char *buf, size_t maxbytes) {
     roaring_bitmap_t *ans =
-        (roaring_bitmap_t *)malloc(sizeof(roaring_bitmap_t));
+        (roaring_bitmap_t *)roaring_malloc(sizeof(roaring_bitmap_t));
     if (ans == NULL) {
         return NULL;
     }
@@ -1389,7 +2218,7 @@ roaring_bitmap_t *roaring_bitmap_portable_deserialize_safe(const char *buf, size
     if(is_ok) assert(bytesread <= maxbytes);
     roaring_bitmap_set_copy_on_write(ans, false);
     if (!is_ok) {
-        free(ans);
+        roaring_free(ans);
         return NULL;
     }
     return ans;
@@ -1453,6 +2282,177 @@ bool roaring_iterate64(const roaring_bitmap_t *r, roaring_iterator64 iterator,
     return true;
 }
 
+/*
+ * Where the decoding of a container stopped: the next array value, bitset
+ * word or run, and how many bits of that word (or values of that run) were
+ * already decoded.
+ */
+typedef struct batch_cursor_s {
+    int32_t index;
+    uint32_t done;
+} batch_cursor_t;
+
+/*
+ * Decodes the next 'n' values of a container, which must have that many
+ * left, into 'out' and moves the cursor past them. Whole bitset words go
+ * through bitset_extract_setbits, only the words split between two calls
+ * are decoded bit by bit.
+ */
+static void container_decode_batch(const container_t *c, uint8_t type,
+                                   uint32_t base, batch_cursor_t *cursor,
+                                   uint32_t *out, size_t n) {
+    c = container_unwrap_shared(c, &type);
+    switch (type) {
+        case ARRAY_CONTAINER_TYPE: {
+            const uint16_t *array = const_CAST_array(c)->array + cursor->index;
+            for (size_t k = 0; k < n; k++) out[k] = base | array[k];
+            cursor->index += (int32_t)n;
+            break;
+        }
+        case RUN_CONTAINER_TYPE: {
+            const rle16_t *runs = const_CAST_run(c)->runs;
+            while (n > 0) {
+                const rle16_t run = runs[cursor->index];
+                const uint32_t start = base + run.value + cursor->done;
+                uint32_t len = (uint32_t)run.length + 1 - cursor->done;
+                if (len > n) len = (uint32_t)n;
+                for (uint32_t k = 0; k < len; k++) *out++ = start + k;
+                n -= len;
+                cursor->done += len;
+                if (cursor->done == (uint32_t)run.length + 1) {
+                    cursor->index++;
+                    cursor->done = 0;
+                }
+            }
+            break;
+        }
+        default: {
+            assert(type == BITSET_CONTAINER_TYPE);
+            const uint64_t *words = const_CAST_bitset(c)->words;
+            int32_t i = cursor->index;
+            if (cursor->done > 0) {  // the rest of a split word
+                uint64_t w = words[i] & (~UINT64_C(0) << cursor->done);
+                for (; n > 0 && w != 0; n--) {
+                    *out++ = base + 64 * i + __builtin_ctzll(w);
+                    w &= w - 1;
+                }
+                if (w != 0) {
+                    cursor->done = __builtin_ctzll(w);
+                    break;
+                }
+                i++;
+                cursor->done = 0;
+            }
+            // as many whole words as fit
+            int32_t end = i;
+            size_t fit = 0;
+            while (end < BITSET_CONTAINER_SIZE_IN_WORDS &&
+                   fit + hamming(words[end]) <= n) {
+                fit += hamming(words[end]);
+                end++;
+            }
+            bitset_extract_setbits(words + i, end - i, out, base + 64 * i);
+            out += fit;
+            n -= fit;
+            i = end;
+            if (n > 0) {  // the start of a word that does not fit
+                uint64_t w = words[i];
+                for (; n > 0; n--) {
+                    *out++ = base + 64 * i + __builtin_ctzll(w);
+                    w &= w - 1;
+                }
+                cursor->done = __builtin_ctzll(w);
+            }
+            cursor->index = i;
+            break;
+        }
+    }
+}
+
+bool roaring_iterate_batch(const roaring_bitmap_t *r,
+                           roaring_batch_iterator iterator, size_t buf_size,
+                           void *ptr) {
+    const roaring_array_t *ra = &r->high_low_container;
+    if (buf_size == 0) return false;
+    const uint64_t cardinality = ra_get_cardinality(ra);
+    if (buf_size > cardinality) {
+        if (cardinality == 0) return true;
+        buf_size = (size_t)cardinality;
+    }
+    uint32_t *buf = (uint32_t *)roaring_malloc(buf_size * sizeof(uint32_t));
+    if (buf == NULL) return false;
+    bool ok = true;
+    size_t filled = 0;
+
+    for (int i = 0; ok && i < ra->size; ++i) {
+        const uint32_t base = ((uint32_t)ra->keys[i]) << 16;
+        const size_t card =
+            container_get_cardinality(ra->containers[i], ra->typecodes[i]);
+        if (card > buf_size - filled && filled > 0) {
+            ok = iterator(buf, filled, ptr);
+            filled = 0;
+        }
+        if (!ok) break;
+        if (card <= buf_size) {
+            // the fast path: whole containers through the bulk decoders
+            container_to_uint32_array(buf + filled, ra->containers[i],
+                                      ra->typecodes[i], base);
+            filled += card;
+            continue;
+        }
+        // a container larger than the buffer is decoded by pieces
+        batch_cursor_t cursor = {0, 0};
+        for (size_t left = card; ok && left > 0;) {
+            const size_t n = left < buf_size ? left : buf_size;
+            container_decode_batch(ra->containers[i], ra->typecodes[i], base,
+                                   &cursor, buf, n);
+            ok = iterator(buf, n, ptr);
+            left -= n;
+        }
+    }
+    if (ok && filled > 0) ok = iterator(buf, filled, ptr);
+    roaring_free(buf);
+    return ok;
+}
+
+bool roaring_visit_containers(const roaring_bitmap_t *r,
+                              roaring_container_visitor visitor, void *param) {
+    const roaring_array_t *ra = &r->high_low_container;
+    roaring_container_view_t view;
+
+    for (int i = 0; i < ra->size; ++i) {
+        uint8_t type = ra->typecodes[i];
+        const container_t *c = container_unwrap_shared(ra->containers[i],
+                                                       &type);
+        memset(&view, 0, sizeof(view));
+        view.key = ra->keys[i];
+        view.cardinality = container_get_cardinality(c, type);
+        switch (type) {
+            case BITSET_CONTAINER_TYPE:
+                view.kind = ROARING_CONTAINER_VIEW_BITSET;
+                view.length = BITSET_CONTAINER_SIZE_IN_WORDS;
+                view.words = const_CAST_bitset(c)->words;
+                break;
+            case ARRAY_CONTAINER_TYPE:
+                view.kind = ROARING_CONTAINER_VIEW_ARRAY;
+                view.length = const_CAST_array(c)->cardinality;
+                view.array = const_CAST_array(c)->array;
+                break;
+            case RUN_CONTAINER_TYPE:
+                view.kind = ROARING_CONTAINER_VIEW_RUN;
+                view.length = const_CAST_run(c)->n_runs;
+                // same layout as rle16_t
+                view.runs = (const roaring_rle16_t *)const_CAST_run(c)->runs;
+                break;
+            default:
+                assert(false);
+                __builtin_unreachable();
+        }
+        if (!visitor(&view, param)) return false;
+    }
+    return true;
+}
+
 /****
 * begin roaring_uint32_iterator_t
 *****/
@@ -1615,7 +2615,7 @@ void roaring_init_iterator_last(const roaring_bitmap_t *r,
 
 roaring_uint32_iterator_t *roaring_create_iterator(const roaring_bitmap_t *r) {
     roaring_uint32_iterator_t *newit =
-        (roaring_uint32_iterator_t *)malloc(sizeof(roaring_uint32_iterator_t));
+        (roaring_uint32_iterator_t *)roaring_malloc(sizeof(roaring_uint32_iterator_t));
     if (newit == NULL) return NULL;
     roaring_init_iterator(r, newit);
     return newit;
@@ -1624,7 +2624,7 @@ roaring_uint32_iterator_t *roaring_create_iterator(const roaring_bitmap_t *r) {
 roaring_uint32_iterator_t *roaring_copy_uint32_iterator(
     const roaring_uint32_iterator_t *it) {
     roaring_uint32_iterator_t *newit =
-        (roaring_uint32_iterator_t *)malloc(sizeof(roaring_uint32_iterator_t));
+        (roaring_uint32_iterator_t *)roaring_malloc(sizeof(roaring_uint32_iterator_t));
     memcpy(newit, it, sizeof(roaring_uint32_iterator_t));
     return newit;
 }
@@ -1870,7 +2870,94 @@ uint32_t roaring_read_uint32_iterator(roaring_uint32_iterator_t *it, uint32_t* b
 
 
 
-void roaring_free_uint32_iterator(roaring_uint32_iterator_t *it) { free(it); }
+void roaring_free_uint32_iterator(roaring_uint32_iterator_t *it) { roaring_free(it); }
+
+// leapfrog: moves all the iterators to the first common value >= candidate
+static bool intersection_iterator_settle(roaring_intersection_iterator_t *it,
+                                         uint32_t candidate) {
+    it->has_value = false;
+    if (it->number == 0) return false;
+    size_t agreed = 0;  // number of iterators known to be at the candidate
+    for (size_t i = 0; agreed < it->number; i = (i + 1) % it->number) {
+        roaring_uint32_iterator_t *input = &it->iterators[i];
+        if (!input->has_value) return false;
+        if (input->current_value < candidate &&
+            !roaring_move_uint32_iterator_equalorlarger(input, candidate)) {
+            return false;
+        }
+        if (input->current_value > candidate) {
+            candidate = input->current_value;
+            agreed = 1;
+        } else {
+            agreed++;
+        }
+    }
+    it->current_value = candidate;
+    return (it->has_value = true);
+}
+
+roaring_intersection_iterator_t *roaring_create_intersection_iterator(
+        size_t number, const roaring_bitmap_t **x) {
+    // the iterators of the inputs follow the struct in the same allocation
+    roaring_intersection_iterator_t *it =
+        (roaring_intersection_iterator_t *)roaring_malloc(
+            sizeof(roaring_intersection_iterator_t) +
+            number * sizeof(roaring_uint32_iterator_t));
+    if (!it) return NULL;
+    it->number = number;
+    it->iterators = (roaring_uint32_iterator_t *)(it + 1);
+    for (size_t i = 0; i < number; i++) {
+        roaring_init_iterator(x[i], &it->iterators[i]);
+    }
+    it->current_value = 0;
+    intersection_iterator_settle(it, 0);
+    return it;
+}
+
+bool roaring_advance_intersection_iterator(
+        roaring_intersection_iterator_t *it) {
+    if (!it->has_value) return false;
+    if (it->current_value == UINT32_MAX) return (it->has_value = false);
+    return intersection_iterator_settle(it, it->current_value + 1);
+}
+
+bool roaring_move_intersection_iterator_equalorlarger(
+        roaring_intersection_iterator_t *it, uint32_t val) {
+    // the inputs may have to move backward, which settling does not do
+    for (size_t i = 0; i < it->number; i++) {
+        roaring_uint32_iterator_t *input = &it->iterators[i];
+        if (!input->has_value || input->current_value > val) {
+            roaring_move_uint32_iterator_equalorlarger(input, val);
+        }
+    }
+    return intersection_iterator_settle(it, val);
+}
+
+uint32_t roaring_read_intersection_iterator(
+        roaring_intersection_iterator_t *it, uint32_t *buf, uint32_t count) {
+    uint32_t ret = 0;
+    while (ret < count && it->has_value) {
+        buf[ret++] = it->current_value;
+        roaring_advance_intersection_iterator(it);
+    }
+    return ret;
+}
+
+roaring_intersection_iterator_t *roaring_copy_intersection_iterator(
+        const roaring_intersection_iterator_t *it) {
+    const size_t size = sizeof(roaring_intersection_iterator_t) +
+                        it->number * sizeof(roaring_uint32_iterator_t);
+    roaring_intersection_iterator_t *newit =
+        (roaring_intersection_iterator_t *)roaring_malloc(size);
+    if (!newit) return NULL;
+    memcpy(newit, it, size);
+    newit->iterators = (roaring_uint32_iterator_t *)(newit + 1);
+    return newit;
+}
+
+void roaring_free_intersection_iterator(roaring_intersection_iterator_t *it) {
+    roaring_free(it);
+}
 
 /****
 * end of roaring_uint32_iterator_t
@@ -2058,7 +3145,7 @@ roaring_bitmap_t *roaring_bitmap_flip(const roaring_bitmap_t *x1,
     const uint16_t lb_end = (uint16_t)(range_end - 1);  // & 0xFFFF;
 
     ra_append_copies_until(&ans->high_low_container, &x1->high_low_container,
-                           hb_start, is_cow(x1));
+                           hb_start, can_share(x1));
     if (hb_start == hb_end) {
         insert_flipped_container(&ans->high_low_container,
                                  &x1->high_low_container, hb_start, lb_start,
@@ -2089,12 +3176,13 @@ roaring_bitmap_t *roaring_bitmap_flip(const roaring_bitmap_t *x1,
         }
     }
     ra_append_copies_after(&ans->high_low_container, &x1->high_low_container,
-                           hb_end, is_cow(x1));
+                           hb_end, can_share(x1));
     return ans;
 }
 
 void roaring_bitmap_flip_inplace(roaring_bitmap_t *x1, uint64_t range_start,
                                  uint64_t range_end) {
+    ra_invalidate_card_index(&x1->high_low_container);
     if (range_start >= range_end) {
         return;  // empty range
     }
@@ -2133,6 +3221,79 @@ void roaring_bitmap_flip_inplace(roaring_bitmap_t *x1, uint64_t range_start,
     }
 }
 
+// appends the container c for the given key, merging it with the last
+// container if it has the same key
+static void offset_append_with_merge(roaring_array_t *ra, uint16_t key,
+                                     container_t *c, uint8_t type) {
+    const int32_t last = ra->size - 1;
+    if (last < 0 || ra->keys[last] != key) {
+        ra_append(ra, key, c, type);
+        return;
+    }
+    uint8_t last_type;
+    container_t *last_c = ra_get_container_at_index(ra, last, &last_type);
+    uint8_t result_type;
+    container_t *merged = container_ior(last_c, last_type, c, type,
+                                        &result_type);
+    if (merged != last_c) container_free(last_c, last_type);
+    container_free(c, type);
+    ra_set_container_at_index(ra, last, merged, result_type);
+}
+
+roaring_bitmap_t *roaring_bitmap_add_offset(const roaring_bitmap_t *bm,
+                                            int64_t offset) {
+    const roaring_array_t *bm_ra = &bm->high_low_container;
+    const int32_t length = bm_ra->size;
+    // every value leaves the 32-bit range (this also keeps the negation
+    // below from overflowing on INT64_MIN)
+    if (offset <= -(INT64_C(1) << 32) || offset >= (INT64_C(1) << 32)) {
+        roaring_bitmap_t *answer = roaring_bitmap_create();
+        roaring_bitmap_set_copy_on_write(answer, is_cow(bm));
+        return answer;
+    }
+    // offset = key_offset * 65536 + in_offset, with 0 <= in_offset < 65536
+    const int64_t key_offset = offset >= 0 ? offset >> 16
+                                           : -((-offset + 0xFFFF) >> 16);
+    const uint16_t in_offset = (uint16_t)(offset - key_offset * 65536);
+
+    roaring_bitmap_t *answer = roaring_bitmap_create_with_capacity(length);
+    roaring_bitmap_set_copy_on_write(answer, is_cow(bm));
+    roaring_array_t *ans_ra = &answer->high_low_container;
+
+    if (in_offset == 0) {
+        // only the keys change: the containers are shared or copied as is
+        for (int32_t i = 0; i < length; ++i) {
+            const int64_t key = (int64_t)bm_ra->keys[i] + key_offset;
+            if (key < 0 || key > UINT16_MAX) continue;
+            ra_append_copy(ans_ra, bm_ra, i, can_share(bm));
+            ans_ra->keys[ans_ra->size - 1] = (uint16_t)key;
+        }
+        return answer;
+    }
+
+    for (int32_t i = 0; i < length; ++i) {
+        const int64_t key = (int64_t)bm_ra->keys[i] + key_offset;
+        // values go to key (the low part) and key + 1 (the high part)
+        const bool want_lo = key >= 0 && key <= UINT16_MAX;
+        const bool want_hi = key + 1 >= 0 && key + 1 <= UINT16_MAX;
+        if (!want_lo && !want_hi) continue;
+
+        container_t *lo = NULL, *hi = NULL;
+        uint8_t lo_type = 0, hi_type = 0;
+        container_add_offset(bm_ra->containers[i], bm_ra->typecodes[i],
+                             want_lo ? &lo : NULL, &lo_type,
+                             want_hi ? &hi : NULL, &hi_type, in_offset);
+        if (lo != NULL) {
+            // the high part of the previous container may share this key
+            offset_append_with_merge(ans_ra, (uint16_t)key, lo, lo_type);
+        }
+        if (hi != NULL) {
+            ra_append(ans_ra, (uint16_t)(key + 1), hi, hi_type);
+        }
+    }
+    return answer;
+}
+
 roaring_bitmap_t *roaring_bitmap_lazy_or(const roaring_bitmap_t *x1,
                                          const roaring_bitmap_t *x2,
                                          const bool bitsetconversion) {
@@ -2190,8 +3351,8 @@ roaring_bitmap_t *roaring_bitmap_lazy_or(const roaring_bitmap_t *x1,
         } else if (s1 < s2) {  // s1 < s2
             container_t *c1 = ra_get_container_at_index(
                                     &x1->high_low_container, pos1, &type1);
-            c1 = get_copy_of_container(c1, &type1, is_cow(x1));
-            if (is_cow(x1)) {
+            c1 = get_copy_of_container(c1, &type1, can_share(x1));
+            if (can_share(x1)) {
                 ra_set_container_at_index(&x1->high_low_container, pos1, c1,
                                           type1);
             }
@@ -2203,8 +3364,8 @@ roaring_bitmap_t *roaring_bitmap_lazy_or(const roaring_bitmap_t *x1,
         } else {  // s1 > s2
             container_t *c2 = ra_get_container_at_index(
                                     &x2->high_low_container, pos2, &type2);
-            c2 = get_copy_of_container(c2, &type2, is_cow(x2));
-            if (is_cow(x2)) {
+            c2 = get_copy_of_container(c2, &type2, can_share(x2));
+            if (can_share(x2)) {
                 ra_set_container_at_index(&x2->high_low_container, pos2, c2,
                                           type2);
             }
@@ -2217,11 +3378,11 @@ roaring_bitmap_t *roaring_bitmap_lazy_or(const roaring_bitmap_t *x1,
     if (pos1 == length1) {
         ra_append_copy_range(&answer->high_low_container,
                              &x2->high_low_container, pos2, length2,
-                             is_cow(x2));
+                             can_share(x2));
     } else if (pos2 == length2) {
         ra_append_copy_range(&answer->high_low_container,
                              &x1->high_low_container, pos1, length1,
-                             is_cow(x1));
+                             can_share(x1));
     }
     return answer;
 }
@@ -2229,6 +3390,7 @@ roaring_bitmap_t *roaring_bitmap_lazy_or(const roaring_bitmap_t *x1,
 void roaring_bitmap_lazy_or_inplace(roaring_bitmap_t *x1,
                                     const roaring_bitmap_t *x2,
                                     const bool bitsetconversion) {
+    ra_invalidate_card_index(&x1->high_low_container);
     uint8_t result_type = 0;
     int length1 = x1->high_low_container.size;
     const int length2 = x2->high_low_container.size;
@@ -2291,8 +3453,8 @@ void roaring_bitmap_lazy_or_inplace(roaring_bitmap_t *x1,
             container_t *c2 = ra_get_container_at_index(
                                     &x2->high_low_container, pos2, &type2);
             // container_t *c2_clone = container_clone(c2, type2);
-            c2 = get_copy_of_container(c2, &type2, is_cow(x2));
-            if (is_cow(x2)) {
+            c2 = get_copy_of_container(c2, &type2, can_share(x2));
+            if (can_share(x2)) {
                 ra_set_container_at_index(&x2->high_low_container, pos2, c2,
                                           type2);
             }
@@ -2307,7 +3469,7 @@ void roaring_bitmap_lazy_or_inplace(roaring_bitmap_t *x1,
     }
     if (pos1 == length1) {
         ra_append_copy_range(&x1->high_low_container, &x2->high_low_container,
-                             pos2, length2, is_cow(x2));
+                             pos2, length2, can_share(x2));
     }
 }
 
@@ -2354,8 +3516,8 @@ roaring_bitmap_t *roaring_bitmap_lazy_xor(const roaring_bitmap_t *x1,
         } else if (s1 < s2) {  // s1 < s2
             container_t *c1 = ra_get_container_at_index(
                                     &x1->high_low_container, pos1, &type1);
-            c1 = get_copy_of_container(c1, &type1, is_cow(x1));
-            if (is_cow(x1)) {
+            c1 = get_copy_of_container(c1, &type1, can_share(x1));
+            if (can_share(x1)) {
                 ra_set_container_at_index(&x1->high_low_container, pos1, c1,
                                           type1);
             }
@@ -2367,8 +3529,8 @@ roaring_bitmap_t *roaring_bitmap_lazy_xor(const roaring_bitmap_t *x1,
         } else {  // s1 > s2
             container_t *c2 = ra_get_container_at_index(
                                     &x2->high_low_container, pos2, &type2);
-            c2 = get_copy_of_container(c2, &type2, is_cow(x2));
-            if (is_cow(x2)) {
+            c2 = get_copy_of_container(c2, &type2, can_share(x2));
+            if (can_share(x2)) {
                 ra_set_container_at_index(&x2->high_low_container, pos2, c2,
                                           type2);
             }
@@ -2381,17 +3543,18 @@ roaring_bitmap_t *roaring_bitmap_lazy_xor(const roaring_bitmap_t *x1,
     if (pos1 == length1) {
         ra_append_copy_range(&answer->high_low_container,
                              &x2->high_low_container, pos2, length2,
-                             is_cow(x2));
+                             can_share(x2));
     } else if (pos2 == length2) {
         ra_append_copy_range(&answer->high_low_container,
                              &x1->high_low_container, pos1, length1,
-                             is_cow(x1));
+                             can_share(x1));
     }
     return answer;
 }
 
 void roaring_bitmap_lazy_xor_inplace(roaring_bitmap_t *x1,
                                      const roaring_bitmap_t *x2) {
+    ra_invalidate_card_index(&x1->high_low_container);
     assert(x1 != x2);
     uint8_t result_type = 0;
     int length1 = x1->high_low_container.size;
@@ -2453,8 +3616,8 @@ void roaring_bitmap_lazy_xor_inplace(roaring_bitmap_t *x1,
             container_t *c2 = ra_get_container_at_index(
                                     &x2->high_low_container, pos2, &type2);
             // container_t *c2_clone = container_clone(c2, type2);
-            c2 = get_copy_of_container(c2, &type2, is_cow(x2));
-            if (is_cow(x2)) {
+            c2 = get_copy_of_container(c2, &type2, can_share(x2));
+            if (can_share(x2)) {
                 ra_set_container_at_index(&x2->high_low_container, pos2, c2,
                                           type2);
             }
@@ -2469,11 +3632,12 @@ void roaring_bitmap_lazy_xor_inplace(roaring_bitmap_t *x1,
     }
     if (pos1 == length1) {
         ra_append_copy_range(&x1->high_low_container, &x2->high_low_container,
-                             pos2, length2, is_cow(x2));
+                             pos2, length2, can_share(x2));
     }
 }
 
 void roaring_bitmap_repair_after_lazy(roaring_bitmap_t *r) {
+    ra_invalidate_card_index(&r->high_low_container);
     roaring_array_t *ra = &r->high_low_container;
 
     for (int i = 0; i < ra->size; ++i) {
@@ -2493,6 +3657,22 @@ void roaring_bitmap_repair_after_lazy(roaring_bitmap_t *r) {
 * to x.
 */
 uint64_t roaring_bitmap_rank(const roaring_bitmap_t *bm, uint32_t x) {
+    const roaring_array_t *ra = &bm->high_low_container;
+    const uint32_t *card_index = ra_get_card_index(ra);
+    if (card_index != NULL) {
+        const int32_t i = ra_get_index(ra, x >> 16);
+        if (i >= 0) {
+            return card_index[i] + container_rank(ra->containers[i],
+                                                  ra->typecodes[i],
+                                                  x & 0xFFFF);
+        }
+        const int32_t next = -i - 1;  // first container after x
+        if (next < ra->size) return card_index[next];
+        return (uint64_t)card_index[ra->size - 1] +
+               container_get_cardinality(ra->containers[ra->size - 1],
+                                         ra->typecodes[ra->size - 1]);
+    }
+
     uint64_t size = 0;
     uint32_t xhigh = x >> 16;
     for (int i = 0; i < bm->high_low_container.size; i++) {
@@ -2553,6 +3733,13 @@ bool roaring_bitmap_select(const roaring_bitmap_t *bm, uint32_t rank,
     uint32_t start_rank = 0;
     int i = 0;
     bool valid = false;
+    const uint32_t *card_index = ra_get_card_index(&bm->high_low_container);
+    if (card_index != NULL) {
+        // skip the containers holding only smaller ranks
+        i = ra_card_index_lookup(card_index, bm->high_low_container.size,
+                                 rank);
+        start_rank = card_index[i];
+    }
     while (!valid && i < bm->high_low_container.size) {
         container = bm->high_low_container.containers[i];
         typecode = bm->high_low_container.typecodes[i];
@@ -2629,6 +3816,81 @@ uint64_t roaring_bitmap_and_cardinality(const roaring_bitmap_t *x1,
     return answer;
 }
 
+typedef struct page_copy_s {
+    uint32_t *out;
+    uint32_t skip;   // values still to skip
+    size_t left;     // values still to write
+} page_copy_t;
+
+static bool page_copy_fnc(uint32_t value, void *param) {
+    page_copy_t *pc = (page_copy_t *)param;
+    if (pc->skip > 0) {
+        pc->skip--;
+        return true;
+    }
+    *pc->out++ = value;
+    return --pc->left > 0;
+}
+
+size_t roaring_bitmap_and_to_uint32_array(const roaring_bitmap_t *x1,
+                                          const roaring_bitmap_t *x2,
+                                          size_t offset, size_t limit,
+                                          uint32_t *ans) {
+    const int length1 = x1->high_low_container.size,
+              length2 = x2->high_low_container.size;
+    size_t written = 0;
+    int pos1 = 0, pos2 = 0;
+
+    while (pos1 < length1 && pos2 < length2 && written < limit) {
+        const uint16_t s1 = ra_get_key_at_index(&x1->high_low_container, pos1);
+        const uint16_t s2 = ra_get_key_at_index(&x2->high_low_container, pos2);
+
+        if (s1 == s2) {
+            uint8_t type1, type2;
+            container_t *c1 = ra_get_container_at_index(
+                                    &x1->high_low_container, pos1, &type1);
+            container_t *c2 = ra_get_container_at_index(
+                                    &x2->high_low_container, pos2, &type2);
+            ++pos1;
+            ++pos2;
+            if (offset > 0) {
+                // skipped containers are only counted, never materialized
+                const size_t skipped =
+                    container_and_cardinality(c1, type1, c2, type2);
+                if (skipped <= offset) {
+                    offset -= skipped;
+                    continue;
+                }
+            }
+            // the others are intersected once, and decoded
+            uint8_t result_type;
+            container_t *c = container_and(c1, type1, c2, type2,
+                                           &result_type);
+            const size_t card = container_get_cardinality(c, result_type);
+            const uint32_t base = ((uint32_t)s1) << 16;
+            if (offset == 0 && card <= limit - written) {
+                container_to_uint32_array(ans + written, c, result_type,
+                                          base);
+                written += card;
+            } else {  // the first or the last page container
+                page_copy_t pc;
+                pc.out = ans + written;
+                pc.skip = (uint32_t)offset;
+                pc.left = limit - written;
+                container_iterate(c, result_type, base, page_copy_fnc, &pc);
+                written = pc.out - ans;
+                offset = 0;
+            }
+            container_free(c, result_type);
+        } else if (s1 < s2) {  // s1 < s2
+            pos1 = ra_advance_until(&x1->high_low_container, s2, pos1);
+        } else {  // s1 > s2
+            pos2 = ra_advance_until(&x2->high_low_container, s1, pos2);
+        }
+    }
+    return written;
+}
+
 double roaring_bitmap_jaccard_index(const roaring_bitmap_t *x1,
                                     const roaring_bitmap_t *x2) {
     const uint64_t c1 = roaring_bitmap_get_cardinality(x1);
@@ -2660,6 +3922,181 @@ uint64_t roaring_bitmap_xor_cardinality(const roaring_bitmap_t *x1,
     return c1 + c2 - 2 * inter;
 }
 
+/*
+ * A read-only operand made of the containers of a bitmap whose keys fall in a
+ * window: the inner containers are borrowed, while the two boundary
+ * containers are replaced by clipped copies, which the operand owns.
+ */
+typedef struct range_operand_s {
+    roaring_bitmap_t bitmap;
+    int32_t n_owned;
+    container_t *owned[2];
+    uint8_t owned_types[2];
+} range_operand_t;
+
+// the values of 'r' in [min, max], in time proportional to the window
+static bool range_operand_init(range_operand_t *op, const roaring_bitmap_t *r,
+                               uint32_t min, uint32_t max) {
+    const roaring_array_t *ra = &r->high_low_container;
+    roaring_array_t *op_ra = &op->bitmap.high_low_container;
+    const uint16_t minhb = min >> 16;
+    const uint16_t maxhb = max >> 16;
+    int32_t start = ra_get_index(ra, minhb);
+    if (start < 0) start = -start - 1;
+    int32_t end = ra_get_index(ra, maxhb);
+    end = end < 0 ? -end - 1 : end + 1;
+    op->n_owned = 0;
+    if (!ra_init_with_capacity(op_ra, end - start)) return false;
+
+    for (int32_t i = start; i < end; ++i) {
+        const uint16_t key = ra->keys[i];
+        uint8_t type = ra->typecodes[i];
+        container_t *c = ra->containers[i];
+        const uint32_t cmin = (key == minhb) ? (min & 0xFFFF) : 0;
+        const uint32_t cmax = (key == maxhb) ? (max & 0xFFFF) : 0xFFFF;
+        if (cmin != 0 || cmax != 0xFFFF) {
+            uint8_t range_type;
+            container_t *range =
+                container_range_of_ones(cmin, cmax + 1, &range_type);
+            container_t *clipped =
+                container_and(c, type, range, range_type, &type);
+            container_free(range, range_type);
+            if (!container_nonzero_cardinality(clipped, type)) {
+                container_free(clipped, type);
+                continue;
+            }
+            op->owned[op->n_owned] = c = clipped;
+            op->owned_types[op->n_owned++] = type;
+        }
+        ra_append(op_ra, key, c, type);
+    }
+    return true;
+}
+
+static void range_operand_clear(range_operand_t *op) {
+    for (int32_t i = 0; i < op->n_owned; ++i) {
+        container_free(op->owned[i], op->owned_types[i]);
+    }
+    ra_clear_without_containers(&op->bitmap.high_low_container);
+}
+
+// restricts x1 and x2 to [range_start, range_end), false if it is empty
+static bool range_operands_init(range_operand_t *op1, range_operand_t *op2,
+                                const roaring_bitmap_t *x1,
+                                const roaring_bitmap_t *x2,
+                                uint64_t range_start, uint64_t range_end) {
+    if (range_end > UINT64_C(0x100000000)) range_end = UINT64_C(0x100000000);
+    if (range_start >= range_end) return false;
+    const uint32_t min = (uint32_t)range_start;
+    const uint32_t max = (uint32_t)(range_end - 1);
+    if (!range_operand_init(op1, x1, min, max)) {
+        ra_clear_without_containers(&op1->bitmap.high_low_container);
+        return false;
+    }
+    if (!range_operand_init(op2, x2, min, max)) {
+        range_operand_clear(op1);
+        ra_clear_without_containers(&op2->bitmap.high_low_container);
+        return false;
+    }
+    return true;
+}
+
+static roaring_bitmap_t *range_op(
+        const roaring_bitmap_t *x1, const roaring_bitmap_t *x2,
+        uint64_t range_start, uint64_t range_end,
+        roaring_bitmap_t *(*op)(const roaring_bitmap_t *,
+                                const roaring_bitmap_t *)) {
+    range_operand_t op1, op2;
+    if (!range_operands_init(&op1, &op2, x1, x2, range_start, range_end)) {
+        return roaring_bitmap_create();
+    }
+    roaring_bitmap_t *answer = op(&op1.bitmap, &op2.bitmap);
+    roaring_bitmap_set_copy_on_write(answer, is_cow(x1) && is_cow(x2));
+    range_operand_clear(&op1);
+    range_operand_clear(&op2);
+    return answer;
+}
+
+roaring_bitmap_t *roaring_bitmap_and_in_range(const roaring_bitmap_t *x1,
+                                              const roaring_bitmap_t *x2,
+                                              uint64_t range_start,
+                                              uint64_t range_end) {
+    return range_op(x1, x2, range_start, range_end, roaring_bitmap_and);
+}
+
+roaring_bitmap_t *roaring_bitmap_or_in_range(const roaring_bitmap_t *x1,
+                                             const roaring_bitmap_t *x2,
+                                             uint64_t range_start,
+                                             uint64_t range_end) {
+    return range_op(x1, x2, range_start, range_end, roaring_bitmap_or);
+}
+
+roaring_bitmap_t *roaring_bitmap_xor_in_range(const roaring_bitmap_t *x1,
+                                              const roaring_bitmap_t *x2,
+                                              uint64_t range_start,
+                                              uint64_t range_end) {
+    return range_op(x1, x2, range_start, range_end, roaring_bitmap_xor);
+}
+
+roaring_bitmap_t *roaring_bitmap_andnot_in_range(const roaring_bitmap_t *x1,
+                                                 const roaring_bitmap_t *x2,
+                                                 uint64_t range_start,
+                                                 uint64_t range_end) {
+    return range_op(x1, x2, range_start, range_end, roaring_bitmap_andnot);
+}
+
+uint64_t roaring_bitmap_and_cardinality_in_range(const roaring_bitmap_t *x1,
+                                                 const roaring_bitmap_t *x2,
+                                                 uint64_t range_start,
+                                                 uint64_t range_end) {
+    range_operand_t op1, op2;
+    if (!range_operands_init(&op1, &op2, x1, x2, range_start, range_end)) {
+        return 0;
+    }
+    const uint64_t inter =
+        roaring_bitmap_and_cardinality(&op1.bitmap, &op2.bitmap);
+    range_operand_clear(&op1);
+    range_operand_clear(&op2);
+    return inter;
+}
+
+uint64_t roaring_bitmap_or_cardinality_in_range(const roaring_bitmap_t *x1,
+                                                const roaring_bitmap_t *x2,
+                                                uint64_t range_start,
+                                                uint64_t range_end) {
+    const uint64_t c1 =
+        roaring_bitmap_range_cardinality(x1, range_start, range_end);
+    const uint64_t c2 =
+        roaring_bitmap_range_cardinality(x2, range_start, range_end);
+    const uint64_t inter = roaring_bitmap_and_cardinality_in_range(
+        x1, x2, range_start, range_end);
+    return c1 + c2 - inter;
+}
+
+uint64_t roaring_bitmap_andnot_cardinality_in_range(const roaring_bitmap_t *x1,
+                                                    const roaring_bitmap_t *x2,
+                                                    uint64_t range_start,
+                                                    uint64_t range_end) {
+    const uint64_t c1 =
+        roaring_bitmap_range_cardinality(x1, range_start, range_end);
+    const uint64_t inter = roaring_bitmap_and_cardinality_in_range(
+        x1, x2, range_start, range_end);
+    return c1 - inter;
+}
+
+uint64_t roaring_bitmap_xor_cardinality_in_range(const roaring_bitmap_t *x1,
+                                                 const roaring_bitmap_t *x2,
+                                                 uint64_t range_start,
+                                                 uint64_t range_end) {
+    const uint64_t c1 =
+        roaring_bitmap_range_cardinality(x1, range_start, range_end);
+    const uint64_t c2 =
+        roaring_bitmap_range_cardinality(x2, range_start, range_end);
+    const uint64_t inter = roaring_bitmap_and_cardinality_in_range(
+        x1, x2, range_start, range_end);
+    return c1 + c2 - 2 * inter;
+}
+
 
 bool roaring_bitmap_contains(const roaring_bitmap_t *r, uint32_t val) {
     const uint16_t hb = val >> 16;
@@ -2678,6 +4115,154 @@ bool roaring_bitmap_contains(const roaring_bitmap_t *r, uint32_t val) {
 }
 
 
+// values[start, end) are non-decreasing and belong to container 'c': merges
+// them with its content, galloping over it
+static void container_contains_sorted(const container_t *c, uint8_t typecode,
+                                      const uint32_t *values, size_t start,
+                                      size_t end, uint64_t *out_bits) {
+    c = container_unwrap_shared(c, &typecode);
+    switch (typecode) {
+        case BITSET_CONTAINER_TYPE: {
+            const bitset_container_t *bc = const_CAST_bitset(c);
+            for (size_t i = start; i < end; i++) {
+                const uint16_t low = (uint16_t)values[i];
+                const uint64_t bit = (bc->words[low >> 6] >> (low & 63)) & 1;
+                out_bits[i >> 6] |= bit << (i & 63);
+            }
+            break;
+        }
+        case ARRAY_CONTAINER_TYPE: {
+            const array_container_t *ac = const_CAST_array(c);
+            int32_t pos = -1;  // last index holding a value below the probe
+            for (size_t i = start; i < end; i++) {
+                const uint16_t low = (uint16_t)values[i];
+                const int32_t idx =
+                    advanceUntil(ac->array, pos, ac->cardinality, low);
+                if (idx == ac->cardinality) break;
+                const uint64_t bit = (ac->array[idx] == low);
+                out_bits[i >> 6] |= bit << (i & 63);
+                pos = idx - 1;
+            }
+            break;
+        }
+        default: {  // RUN_CONTAINER_TYPE
+            const run_container_t *rc = const_CAST_run(c);
+            int32_t r = 0;  // no run before 'r' can hold a later probe
+            for (size_t i = start; i < end && r < rc->n_runs; i++) {
+                const uint16_t low = (uint16_t)values[i];
+                if (rc->runs[r].value + rc->runs[r].length < low) {
+                    // move to the last run starting at or before 'low', or
+                    // to the next run when there is none
+                    const int32_t idx = interleavedBinarySearch(
+                        rc->runs + r + 1, rc->n_runs - r - 1, low);
+                    r += 1 + (idx >= 0 ? idx : (idx == -1 ? 0 : -idx - 2));
+                }
+                if (r < rc->n_runs && low >= rc->runs[r].value &&
+                    low <= rc->runs[r].value + rc->runs[r].length) {
+                    out_bits[i >> 6] |= UINT64_C(1) << (i & 63);
+                }
+            }
+            break;
+        }
+    }
+}
+
+static void contains_many_per_probe(const roaring_bitmap_t *r, size_t n,
+                                    const uint32_t *values,
+                                    uint64_t *out_bits) {
+    roaring_bulk_context_t context = {0};
+    for (size_t i = 0; i < n; i++) {
+        const uint64_t bit =
+            roaring_bitmap_contains_bulk(r, &context, values[i]);
+        out_bits[i >> 6] |= bit << (i & 63);
+    }
+}
+
+void roaring_bitmap_contains_many(const roaring_bitmap_t *r, size_t n,
+                                  const uint32_t *values, uint64_t *out_bits) {
+    memset(out_bits, 0, ((n + 63) / 64) * sizeof(uint64_t));
+    const roaring_array_t *ra = &r->high_low_container;
+    size_t unsorted_at = 1;
+    while (unsorted_at < n && values[unsorted_at - 1] <= values[unsorted_at]) {
+        unsorted_at++;
+    }
+
+    if (unsorted_at >= n) {  // sorted: one merge over the keys
+        int32_t pos = -1;  // no container up to 'pos' can hold a later probe
+        size_t start = 0;
+        while (start < n) {
+            const uint16_t key = (uint16_t)(values[start] >> 16);
+            size_t end = start + 1;
+            while (end < n && (values[end] >> 16) == key) end++;
+            const int32_t idx = ra_advance_until(ra, key, pos);
+            if (idx == ra->size) break;
+            if (ra->keys[idx] == key) {
+                uint8_t typecode;
+                const container_t *c =
+                    ra_get_container_at_index(ra, idx, &typecode);
+                container_contains_sorted(c, typecode, values, start, end,
+                                          out_bits);
+            }
+            pos = idx - 1;
+            start = end;
+        }
+        return;
+    }
+
+    uint32_t *order = NULL;
+    if (n >= CONTAINS_MANY_GROUPING_MIN_PROBES && n <= UINT32_MAX) {
+        order = (uint32_t *)roaring_malloc(2 * n * sizeof(uint32_t));
+    }
+    if (order == NULL) {
+        contains_many_per_probe(r, n, values, out_bits);
+        return;
+    }
+    // group the probes by key, sorting their indexes with two stable
+    // counting passes over the 16 high bits, so that each container is
+    // looked up once
+    uint32_t *tmp = order + n;
+    for (int pass = 0; pass < 2; pass++) {
+        const int shift = pass == 0 ? 16 : 24;
+        const uint32_t *in = pass == 0 ? NULL : tmp;
+        uint32_t *out = pass == 0 ? tmp : order;
+        size_t offsets[256] = {0};
+        for (size_t i = 0; i < n; i++) offsets[(values[i] >> shift) & 0xFF]++;
+        size_t total = 0;
+        for (int b = 0; b < 256; b++) {
+            const size_t count = offsets[b];
+            offsets[b] = total;
+            total += count;
+        }
+        for (size_t i = 0; i < n; i++) {
+            const uint32_t probe = in ? in[i] : (uint32_t)i;
+            out[offsets[(values[probe] >> shift) & 0xFF]++] = probe;
+        }
+    }
+    int32_t pos = -1;
+    size_t start = 0;
+    while (start < n) {
+        const uint16_t key = (uint16_t)(values[order[start]] >> 16);
+        size_t end = start + 1;
+        while (end < n && (values[order[end]] >> 16) == key) end++;
+        const int32_t idx = ra_advance_until(ra, key, pos);
+        if (idx == ra->size) break;
+        if (ra->keys[idx] == key) {
+            uint8_t typecode;
+            const container_t *c = ra_get_container_at_index(ra, idx, &typecode);
+            c = container_unwrap_shared(c, &typecode);
+            for (size_t i = start; i < end; i++) {
+                const uint32_t probe = order[i];
+                const uint64_t bit =
+                    container_contains(c, (uint16_t)values[probe], typecode);
+                out_bits[probe >> 6] |= bit << (probe & 63);
+            }
+        }
+        pos = idx - 1;
+        start = end;
+    }
+    roaring_free(order);
+}
+
 /**
  * Check whether a range of values from range_start (included) to range_end (excluded) is present
  */
@@ -2948,15 +4533,19 @@ roaring_bitmap_frozen_view(const char *buf, size_t length) {
     alloc_size += num_bitset_containers * sizeof(bitset_container_t);
     alloc_size += num_run_containers * sizeof(run_container_t);
     alloc_size += num_array_containers * sizeof(array_container_t);
+    alloc_size += num_containers * sizeof(uint32_t);  // card_index
 
-    char *arena = (char *)malloc(alloc_size);
+    char *arena = (char *)roaring_malloc(alloc_size);
     if (arena == NULL) {
         return NULL;
     }
 
     roaring_bitmap_t *rb = (roaring_bitmap_t *)
             arena_alloc(&arena, sizeof(roaring_bitmap_t));
-    rb->high_low_container.flags = ROARING_FLAG_FROZEN;
+    // the view cannot change, so it gets its cardinality index right away
+    // (built below) and stays safe to query from several threads
+    rb->high_low_container.flags =
+        ROARING_FLAG_FROZEN | ROARING_FLAG_CARD_INDEX;
     rb->high_low_container.allocation_size = num_containers;
     rb->high_low_container.size = num_containers;
     rb->high_low_container.keys = (uint16_t *)keys;
@@ -2996,10 +4585,24 @@ roaring_bitmap_frozen_view(const char *buf, size_t length) {
                 break;
             }
             default:
-                free(arena);
+                roaring_free(arena);
                 return NULL;
         }
     }
+    uint32_t *card_index = (uint32_t *)arena_alloc(
+        &arena, num_containers * sizeof(uint32_t));
+    uint64_t total = 0;
+    for (int32_t i = 0; i < num_containers; i++) {
+        card_index[i] = (uint32_t)total;
+        if (typecodes[i] == RUN_CONTAINER_TYPE) {
+            total += run_container_cardinality(
+                const_CAST_run(rb->high_low_container.containers[i]));
+        } else {
+            total += counts[i] + UINT32_C(1);
+        }
+    }
+    rb->high_low_container.card_index = card_index;
+    rb->high_low_container.cardinality = total;
 
     return rb;
 }
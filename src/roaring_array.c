@@ -41,7 +41,7 @@ static bool realloc_array(roaring_array_t *ra, int32_t new_capacity) {
     // https://github.com/RoaringBitmap/CRoaring/issues/256
 
     if ( new_capacity == 0 ) {
-      free(ra->containers);
+      roaring_free(ra->containers);
       ra->containers = NULL;
       ra->keys = NULL;
       ra->typecodes = NULL;
@@ -50,7 +50,7 @@ static bool realloc_array(roaring_array_t *ra, int32_t new_capacity) {
     }
     const size_t memoryneeded = new_capacity * (
                 sizeof(uint16_t) + sizeof(container_t *) + sizeof(uint8_t));
-    void *bigalloc = malloc(memoryneeded);
+    void *bigalloc = roaring_malloc(memoryneeded);
     if (!bigalloc) return false;
     void *oldbigalloc = ra->containers;
     container_t **newcontainers = (container_t **)bigalloc;
@@ -67,7 +67,7 @@ static bool realloc_array(roaring_array_t *ra, int32_t new_capacity) {
     ra->keys = newkeys;
     ra->typecodes = newtypecodes;
     ra->allocation_size = new_capacity;
-    free(oldbigalloc);
+    roaring_free(oldbigalloc);
     return true;
 }
 
@@ -78,7 +78,7 @@ bool ra_init_with_capacity(roaring_array_t *new_ra, uint32_t cap) {
     if (cap > INT32_MAX) { return false; }
 
     if(cap > 0) {
-      void *bigalloc = malloc(cap *
+      void *bigalloc = roaring_malloc(cap *
                 (sizeof(uint16_t) + sizeof(container_t *) + sizeof(uint8_t)));
       if( bigalloc == NULL ) return false;
       new_ra->containers = (container_t **)bigalloc;
@@ -105,6 +105,8 @@ void ra_init(roaring_array_t *new_ra) {
     new_ra->keys = NULL;
     new_ra->containers = NULL;
     new_ra->typecodes = NULL;
+    new_ra->card_index = NULL;
+    new_ra->cardinality = RA_UNKNOWN_CARDINALITY;
 
     new_ra->allocation_size = 0;
     new_ra->size = 0;
@@ -114,6 +116,7 @@ void ra_init(roaring_array_t *new_ra) {
 bool ra_overwrite(const roaring_array_t *source, roaring_array_t *dest,
                   bool copy_on_write) {
     ra_clear_containers(dest);  // we are going to overwrite them
+    ra_invalidate_card_index(dest);
     if (source->size == 0) {  // Note: can't call memcpy(NULL), even w/size
         dest->size = 0; // <--- This is important.
         return true;  // output was just cleared, so they match
@@ -140,8 +143,9 @@ bool ra_overwrite(const roaring_array_t *source, roaring_array_t *dest,
         memcpy(dest->typecodes, source->typecodes,
                dest->size * sizeof(uint8_t));
         for (int32_t i = 0; i < dest->size; i++) {
-            dest->containers[i] =
-                container_clone(source->containers[i], source->typecodes[i]);
+            // the source may share its containers (copy-on-write)
+            dest->containers[i] = get_copy_of_container(
+                source->containers[i], &dest->typecodes[i], false);
             if (dest->containers[i] == NULL) {
                 for (int32_t j = 0; j < i; j++) {
                     container_free(dest->containers[j], dest->typecodes[j]);
@@ -162,12 +166,14 @@ void ra_clear_containers(roaring_array_t *ra) {
 
 void ra_reset(roaring_array_t *ra) {
   ra_clear_containers(ra);
+  ra_invalidate_card_index(ra);
   ra->size = 0;
   ra_shrink_to_fit(ra);
 }
 
 void ra_clear_without_containers(roaring_array_t *ra) {
-    free(ra->containers);    // keys and typecodes are allocated with containers
+    roaring_free(ra->containers);    // keys and typecodes are allocated with containers
+    ra_invalidate_card_index(ra);
     ra->size = 0;
     ra->allocation_size = 0;
     ra->containers = NULL;
@@ -175,6 +181,64 @@ void ra_clear_without_containers(roaring_array_t *ra) {
     ra->typecodes = NULL;
 }
 
+const uint32_t *ra_get_card_index(const roaring_array_t *ra) {
+    if (!(ra->flags & ROARING_FLAG_CARD_INDEX) || ra->size == 0) return NULL;
+    if (ra->card_index == NULL) {
+        uint32_t *index = (uint32_t *)roaring_malloc(ra->size * sizeof(uint32_t));
+        if (index == NULL) return NULL;
+        // cannot overflow: only the last container is left out
+        uint32_t total = 0;
+        for (int32_t i = 0; i < ra->size; i++) {
+            index[i] = total;
+            total += container_get_cardinality(ra->containers[i],
+                                               ra->typecodes[i]);
+        }
+        // a cache: the content itself is not modified
+        ((roaring_array_t *)ra)->card_index = index;
+    }
+    return ra->card_index;
+}
+
+uint64_t ra_containers_cardinality(const roaring_array_t *ra, int32_t start,
+                                   int32_t end) {
+    uint64_t card = 0;
+    for (int32_t i = start; i < end; ++i)
+        card += container_get_cardinality(ra->containers[i], ra->typecodes[i]);
+    return card;
+}
+
+uint64_t ra_get_cardinality(const roaring_array_t *ra) {
+    if (ra->cardinality != RA_UNKNOWN_CARDINALITY) return ra->cardinality;
+    const uint64_t card = ra_containers_cardinality(ra, 0, ra->size);
+    if (ra->flags & ROARING_FLAG_CARD_INDEX) {
+        ((roaring_array_t *)ra)->cardinality = card;  // a cache, see above
+    }
+    return card;
+}
+
+void ra_card_index_adjust(roaring_array_t *ra, int32_t i, int64_t delta) {
+    if ((ra->flags & (ROARING_FLAG_CARD_INDEX | ROARING_FLAG_FROZEN)) !=
+            ROARING_FLAG_CARD_INDEX ||
+        delta == 0) {
+        return;
+    }
+    if (ra->cardinality != RA_UNKNOWN_CARDINALITY) {
+        ra->cardinality += (uint64_t)delta;  // wraps around when negative
+    }
+    if (ra->card_index != NULL) {
+        // the containers after i start later (or earlier)
+        for (int32_t j = i + 1; j < ra->size; j++) {
+            ra->card_index[j] += (uint32_t)delta;
+        }
+    }
+}
+
+void ra_free_card_index(roaring_array_t *ra) {
+    assert(!(ra->flags & ROARING_FLAG_FROZEN));
+    roaring_free(ra->card_index);
+    ra->card_index = NULL;
+}
+
 void ra_clear(roaring_array_t *ra) {
     ra_clear_containers(ra);
     ra_clear_without_containers(ra);
@@ -222,9 +286,9 @@ void ra_append_copy(roaring_array_t *ra, const roaring_array_t *sa,
         ra->containers[pos] = sa->containers[index];
         ra->typecodes[pos] = sa->typecodes[index];
     } else {
-        ra->containers[pos] =
-            container_clone(sa->containers[index], sa->typecodes[index]);
         ra->typecodes[pos] = sa->typecodes[index];
+        ra->containers[pos] = get_copy_of_container(
+            sa->containers[index], &ra->typecodes[pos], false);
     }
     ra->size++;
 }
@@ -250,9 +314,9 @@ void ra_append_copy_range(roaring_array_t *ra, const roaring_array_t *sa,
             ra->containers[pos] = sa->containers[i];
             ra->typecodes[pos] = sa->typecodes[i];
         } else {
-            ra->containers[pos] =
-                container_clone(sa->containers[i], sa->typecodes[i]);
             ra->typecodes[pos] = sa->typecodes[i];
+            ra->containers[pos] = get_copy_of_container(
+                sa->containers[i], &ra->typecodes[pos], false);
         }
         ra->size++;
     }
@@ -296,9 +360,9 @@ void ra_append_range(roaring_array_t *ra, roaring_array_t *sa,
             ra->containers[pos] = sa->containers[i];
             ra->typecodes[pos] = sa->typecodes[i];
         } else {
-            ra->containers[pos] =
-                container_clone(sa->containers[i], sa->typecodes[i]);
             ra->typecodes[pos] = sa->typecodes[i];
+            ra->containers[pos] = get_copy_of_container(
+                sa->containers[i], &ra->typecodes[pos], false);
         }
         ra->size++;
     }
@@ -460,7 +524,14 @@ bool ra_range_uint32_array(const roaring_array_t *ra, size_t offset, size_t limi
     uint32_t *t_ans = NULL;
     size_t cur_len = 0;
 
-    for (int i = 0; i < ra->size; ++i) {
+    int i = 0;
+    const uint32_t *card_index = ra_get_card_index(ra);
+    if (card_index != NULL) {
+        // start from the container holding the value of rank 'offset'
+        i = ra_card_index_lookup(card_index, ra->size, offset);
+        ctr = card_index[i];
+    }
+    for (; i < ra->size; ++i) {
 
         const container_t *c = container_unwrap_shared(
                                         ra->containers[i], &ra->typecodes[i]);
@@ -480,7 +551,7 @@ bool ra_range_uint32_array(const roaring_array_t *ra, size_t offset, size_t limi
                 //first_skip = t_limit - (ctr + t_limit - offset);
                 first_skip = offset - ctr;
                 first = true;
-                t_ans = (uint32_t *)malloc(sizeof(*t_ans) * (first_skip + limit));
+                t_ans = (uint32_t *)roaring_malloc(sizeof(*t_ans) * (first_skip + limit));
                 if(t_ans == NULL) {
                   return false;
                 }
@@ -488,15 +559,15 @@ bool ra_range_uint32_array(const roaring_array_t *ra, size_t offset, size_t limi
                 cur_len = first_skip + limit;
             }
             if (dtr + t_limit > cur_len){
-                uint32_t * append_ans = (uint32_t *)malloc(sizeof(*append_ans) * (cur_len + t_limit));
+                uint32_t * append_ans = (uint32_t *)roaring_malloc(sizeof(*append_ans) * (cur_len + t_limit));
                 if(append_ans == NULL) {
-                  if(t_ans != NULL) free(t_ans);
+                  if(t_ans != NULL) roaring_free(t_ans);
                   return false;
                 }
                 memset(append_ans, 0, sizeof(*append_ans) * (cur_len + t_limit));
                 cur_len = cur_len + t_limit;
                 memcpy(append_ans, t_ans, dtr * sizeof(uint32_t));
-                free(t_ans);
+                roaring_free(t_ans);
                 t_ans = append_ans;
             }
             switch (ra->typecodes[i]) {
@@ -526,7 +597,7 @@ bool ra_range_uint32_array(const roaring_array_t *ra, size_t offset, size_t limi
     }
     if(t_ans != NULL) {
       memcpy(ans, t_ans+first_skip, limit * sizeof(uint32_t));
-      free(t_ans);
+      roaring_free(t_ans);
     }
     return true;
 }
@@ -571,7 +642,7 @@ size_t ra_portable_serialize(const roaring_array_t *ra, char *buf) {
         memcpy(buf, &cookie, sizeof(cookie));
         buf += sizeof(cookie);
         uint32_t s = (ra->size + 7) / 8;
-        uint8_t *bitmapOfRunContainers = (uint8_t *)calloc(s, 1);
+        uint8_t *bitmapOfRunContainers = (uint8_t *)roaring_calloc(s, 1);
         assert(bitmapOfRunContainers != NULL);  // todo: handle
         for (int32_t i = 0; i < ra->size; ++i) {
             if (get_container_type(ra->containers[i], ra->typecodes[i]) ==
@@ -581,7 +652,7 @@ size_t ra_portable_serialize(const roaring_array_t *ra, char *buf) {
         }
         memcpy(buf, bitmapOfRunContainers, s);
         buf += s;
-        free(bitmapOfRunContainers);
+        roaring_free(bitmapOfRunContainers);
         if (ra->size < NO_OFFSET_THRESHOLD) {
             startOffset = 4 + 4 * ra->size + s;
         } else {
@@ -0,0 +1,303 @@
+#include <assert.h>
+#include <stdlib.h>
+
+#include <roaring/roaring.h>
+#include <roaring/roaring_array.h>
+#include <roaring/containers/containers.h>
+
+
+#ifdef __cplusplus
+using namespace ::roaring::internal;
+
+extern "C" { namespace roaring { namespace api {
+#endif
+
+enum {
+    EXPR_LEAF,
+    EXPR_AND,
+    EXPR_OR,
+    EXPR_XOR,
+    EXPR_ANDNOT
+};
+
+// returned by expr_next_key when no key is left
+#define EXPR_NO_KEY 0x10000
+
+struct roaring_expr_s {
+    uint8_t op;
+    const roaring_bitmap_t *bitmap;  // leaves only
+    int32_t pos;                     // cursor in the keys of 'bitmap'
+    roaring_expr_t *left;
+    roaring_expr_t *right;
+};
+
+roaring_expr_t *roaring_expr_leaf(const roaring_bitmap_t *r) {
+    roaring_expr_t *e = (roaring_expr_t *)roaring_malloc(sizeof(roaring_expr_t));
+    if (!e) return NULL;
+    e->op = EXPR_LEAF;
+    e->bitmap = r;
+    e->pos = 0;
+    e->left = NULL;
+    e->right = NULL;
+    return e;
+}
+
+static roaring_expr_t *expr_create(uint8_t op, roaring_expr_t *left,
+                                   roaring_expr_t *right) {
+    assert(left != NULL && right != NULL);
+    roaring_expr_t *e = (roaring_expr_t *)roaring_malloc(sizeof(roaring_expr_t));
+    if (!e) return NULL;
+    e->op = op;
+    e->bitmap = NULL;
+    e->pos = 0;
+    e->left = left;
+    e->right = right;
+    return e;
+}
+
+roaring_expr_t *roaring_expr_and(roaring_expr_t *left, roaring_expr_t *right) {
+    return expr_create(EXPR_AND, left, right);
+}
+
+roaring_expr_t *roaring_expr_or(roaring_expr_t *left, roaring_expr_t *right) {
+    return expr_create(EXPR_OR, left, right);
+}
+
+roaring_expr_t *roaring_expr_xor(roaring_expr_t *left, roaring_expr_t *right) {
+    return expr_create(EXPR_XOR, left, right);
+}
+
+roaring_expr_t *roaring_expr_andnot(roaring_expr_t *left,
+                                    roaring_expr_t *right) {
+    return expr_create(EXPR_ANDNOT, left, right);
+}
+
+void roaring_expr_free(roaring_expr_t *e) {
+    if (e == NULL) return;
+    roaring_expr_free(e->left);
+    roaring_expr_free(e->right);
+    roaring_free(e);
+}
+
+static void expr_reset(roaring_expr_t *e) {
+    e->pos = 0;
+    if (e->op != EXPR_LEAF) {
+        expr_reset(e->left);
+        expr_reset(e->right);
+    }
+}
+
+/**
+ * Returns the smallest key >= 'key' for which the expression may be
+ * non-empty, or EXPR_NO_KEY. Keys must be requested in non-decreasing order
+ * since the leaf cursors only move forward.
+ */
+static uint32_t expr_next_key(roaring_expr_t *e, uint32_t key) {
+    if (key >= EXPR_NO_KEY) return EXPR_NO_KEY;
+    switch (e->op) {
+        case EXPR_LEAF: {
+            const roaring_array_t *ra = &e->bitmap->high_low_container;
+            if (e->pos < ra->size && ra->keys[e->pos] < key) {
+                e->pos = ra_advance_until(ra, (uint16_t)key, e->pos);
+            }
+            return (e->pos < ra->size) ? ra->keys[e->pos] : EXPR_NO_KEY;
+        }
+        case EXPR_AND: {
+            // leapfrog until both sides agree
+            while (true) {
+                const uint32_t kl = expr_next_key(e->left, key);
+                if (kl == EXPR_NO_KEY) return EXPR_NO_KEY;
+                const uint32_t kr = expr_next_key(e->right, kl);
+                if (kr == kl || kr == EXPR_NO_KEY) return kr;
+                key = kr;
+            }
+        }
+        case EXPR_OR:
+        case EXPR_XOR: {
+            const uint32_t kl = expr_next_key(e->left, key);
+            const uint32_t kr = expr_next_key(e->right, key);
+            return kl < kr ? kl : kr;
+        }
+        default:  // EXPR_ANDNOT: only the left side can bring keys
+            return expr_next_key(e->left, key);
+    }
+}
+
+static void expr_release(container_t *c, uint8_t type, bool owned) {
+    if (owned) container_free(c, type);
+}
+
+// frees 'c' and returns NULL if it is empty
+static container_t *expr_drop_if_empty(container_t *c, uint8_t type) {
+    if (container_nonzero_cardinality(c, type)) return c;
+    container_free(c, type);
+    return NULL;
+}
+
+/**
+ * Computes the (non-shared) container of the expression at 'key', or NULL if
+ * it is empty. If '*owned' is false, the container belongs to a leaf and must
+ * not be modified nor freed.
+ */
+static container_t *expr_container(roaring_expr_t *e, uint16_t key,
+                                   uint8_t *type, bool *owned) {
+    if (e->op == EXPR_LEAF) {
+        if (expr_next_key(e, key) != key) return NULL;
+        container_t *c = ra_get_container_at_index(
+                            &e->bitmap->high_low_container, e->pos, type);
+        *owned = false;
+        return (container_t *)container_unwrap_shared(c, type);
+    }
+
+    uint8_t tl, tr, result_type;
+    bool ol, or_;
+    container_t *l = expr_container(e->left, key, &tl, &ol);
+    if (l == NULL && e->op != EXPR_OR && e->op != EXPR_XOR) return NULL;
+    container_t *r = expr_container(e->right, key, &tr, &or_);
+    if (r == NULL) {
+        if (e->op == EXPR_AND) {
+            expr_release(l, tl, ol);
+            return NULL;
+        }
+        *type = tl;
+        *owned = ol;
+        return l;
+    }
+    if (l == NULL) {  // EXPR_OR or EXPR_XOR
+        *type = tr;
+        *owned = or_;
+        return r;
+    }
+    if (!ol && or_ && e->op != EXPR_ANDNOT) {
+        // work in place in the right-hand side, which we own
+        container_t *tc = l; l = r; r = tc;
+        uint8_t tt = tl; tl = tr; tr = tt;
+        ol = true;
+        or_ = false;
+    }
+
+    container_t *c;
+    switch (e->op) {
+        case EXPR_AND:
+            if (ol) {
+                c = container_iand(l, tl, r, tr, &result_type);
+                if (c != l) container_free(l, tl);
+            } else {
+                c = container_and(l, tl, r, tr, &result_type);
+            }
+            c = expr_drop_if_empty(c, result_type);
+            break;
+        case EXPR_OR:
+            if (ol) {
+                c = container_ior(l, tl, r, tr, &result_type);
+                if (c != l) container_free(l, tl);
+            } else {
+                c = container_or(l, tl, r, tr, &result_type);
+            }
+            break;
+        case EXPR_XOR:
+            // container_ixor frees 'l' itself when it allocates a new result
+            c = ol ? container_ixor(l, tl, r, tr, &result_type)
+                   : container_xor(l, tl, r, tr, &result_type);
+            c = expr_drop_if_empty(c, result_type);
+            break;
+        default:  // EXPR_ANDNOT
+            // container_iandnot frees 'l' itself when it allocates a new result
+            c = ol ? container_iandnot(l, tl, r, tr, &result_type)
+                   : container_andnot(l, tl, r, tr, &result_type);
+            c = expr_drop_if_empty(c, result_type);
+            break;
+    }
+    expr_release(r, tr, or_);
+    *type = result_type;
+    *owned = true;
+    return c;
+}
+
+roaring_bitmap_t *roaring_expr_evaluate(roaring_expr_t *e) {
+    roaring_bitmap_t *answer = roaring_bitmap_create();
+    if (!answer) return NULL;
+    expr_reset(e);
+    for (uint32_t key = expr_next_key(e, 0); key != EXPR_NO_KEY;
+         key = expr_next_key(e, key + 1)) {
+        uint8_t type;
+        bool owned;
+        container_t *c = expr_container(e, (uint16_t)key, &type, &owned);
+        if (c == NULL) continue;
+        if (!owned) c = container_clone(c, type);
+        ra_append(&answer->high_low_container, (uint16_t)key, c, type);
+    }
+    return answer;
+}
+
+/**
+ * At the root, the last operation does not need to be materialized: its
+ * cardinality follows from the cardinalities of the operands and of their
+ * intersection. 'stop_at_nonempty' makes it return as soon as the result is
+ * known to be non-empty.
+ */
+static uint64_t expr_root_cardinality(roaring_expr_t *e,
+                                      bool stop_at_nonempty) {
+    uint64_t card = 0;
+    expr_reset(e);
+    for (uint32_t key = expr_next_key(e, 0); key != EXPR_NO_KEY;
+         key = expr_next_key(e, key + 1)) {
+        uint8_t tl, tr;
+        bool ol, or_;
+        container_t *l, *r = NULL;
+        if (e->op == EXPR_LEAF) {
+            l = expr_container(e, (uint16_t)key, &tl, &ol);
+        } else {
+            l = expr_container(e->left, (uint16_t)key, &tl, &ol);
+            if (l == NULL && (e->op == EXPR_AND || e->op == EXPR_ANDNOT)) {
+                continue;
+            }
+            r = expr_container(e->right, (uint16_t)key, &tr, &or_);
+            if (r == NULL && e->op == EXPR_AND) {
+                expr_release(l, tl, ol);
+                continue;
+            }
+            if (l == NULL) {  // EXPR_OR or EXPR_XOR
+                l = r;
+                tl = tr;
+                ol = or_;
+                r = NULL;
+                // both operands can be empty, e.g. an inner AND
+                if (l == NULL) continue;
+            }
+        }
+        uint64_t key_card;
+        if (r == NULL) {
+            key_card = container_get_cardinality(l, tl);
+        } else if (e->op == EXPR_AND && stop_at_nonempty) {
+            key_card = container_intersect(l, tl, r, tr) ? 1 : 0;
+        } else {
+            const uint64_t both = container_and_cardinality(l, tl, r, tr);
+            const uint64_t cl = container_get_cardinality(l, tl);
+            const uint64_t cr = container_get_cardinality(r, tr);
+            switch (e->op) {
+                case EXPR_AND: key_card = both; break;
+                case EXPR_OR: key_card = cl + cr - both; break;
+                case EXPR_XOR: key_card = cl + cr - 2 * both; break;
+                default: key_card = cl - both; break;  // EXPR_ANDNOT
+            }
+        }
+        expr_release(l, tl, ol);
+        if (r != NULL) expr_release(r, tr, or_);
+        card += key_card;
+        if (stop_at_nonempty && card > 0) break;
+    }
+    return card;
+}
+
+uint64_t roaring_expr_cardinality(roaring_expr_t *e) {
+    return expr_root_cardinality(e, false);
+}
+
+bool roaring_expr_is_nonempty(roaring_expr_t *e) {
+    return expr_root_cardinality(e, true) > 0;
+}
+
+#ifdef __cplusplus
+} } }  // extern "C" { namespace roaring { namespace api {
+#endif
@@ -0,0 +1,239 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <roaring/roaring.h>
+#include <roaring/roaring_array.h>
+#include <roaring/memory_pool.h>
+#include <roaring/containers/perfparameters.h>
+
+#ifndef ROARING_DISABLE_THREADS
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+#endif  // ROARING_DISABLE_THREADS
+
+
+#ifdef __cplusplus
+using namespace ::roaring::internal;
+
+extern "C" { namespace roaring { namespace api {
+#endif
+
+typedef roaring_bitmap_t *(*roaring_binary_op)(const roaring_bitmap_t *,
+                                               const roaring_bitmap_t *);
+
+/*
+ * One key range of a parallel operation. The inputs are views over a slice
+ * of the key arrays of the original bitmaps (they alias their containers, so
+ * copy-on-write sharing still updates the original bitmaps), and the result
+ * is computed by the usual sequential operation.
+ */
+typedef struct roaring_parallel_task_s {
+    roaring_binary_op op;
+    roaring_bitmap_t view1;
+    roaring_bitmap_t view2;
+    roaring_bitmap_t *result;
+} roaring_parallel_task_t;
+
+static void parallel_task_run(roaring_parallel_task_t *task) {
+    task->result = task->op(&task->view1, &task->view2);
+}
+
+#ifndef ROARING_DISABLE_THREADS
+#if defined(_WIN32)
+static DWORD WINAPI parallel_task_thread(LPVOID arg) {
+    parallel_task_run((roaring_parallel_task_t *)arg);
+    return 0;
+}
+#else
+static void *parallel_task_thread(void *arg) {
+    parallel_task_run((roaring_parallel_task_t *)arg);
+    return NULL;
+}
+#endif
+#endif  // ROARING_DISABLE_THREADS
+
+// first index whose key is >= x
+static int32_t ra_lower_bound(const roaring_array_t *ra, uint16_t x) {
+    const int32_t i = ra_get_index(ra, x);
+    return i >= 0 ? i : -i - 1;
+}
+
+static void init_view(roaring_bitmap_t *view, const roaring_array_t *ra,
+                      int32_t start, int32_t end) {
+    roaring_array_t *v = &view->high_low_container;
+    v->size = end - start;
+    v->allocation_size = end - start;
+    v->containers = ra->containers + start;
+    v->keys = ra->keys + start;
+    v->typecodes = ra->typecodes + start;
+    v->card_index = NULL;
+    v->cardinality = RA_UNKNOWN_CARDINALITY;
+    // no index (nor frozen arena) of its own
+    v->flags = ra->flags & ROARING_FLAG_COW;
+}
+
+/*
+ * Splits the key space into 'ntasks' ranges holding about the same number of
+ * containers of the larger input, runs 'op' on each range (on its own thread
+ * but the first one, which runs on the calling thread) and splices the
+ * per-range results, which are disjoint and ordered, into one bitmap. Only
+ * container pointers are moved: the containers themselves are not copied.
+ */
+static roaring_bitmap_t *roaring_bitmap_parallel_op(roaring_binary_op op,
+                                                    const roaring_bitmap_t *x1,
+                                                    const roaring_bitmap_t *x2,
+                                                    uint32_t num_threads) {
+    const roaring_array_t *ra1 = &x1->high_low_container;
+    const roaring_array_t *ra2 = &x2->high_low_container;
+    const roaring_array_t *big = ra1->size >= ra2->size ? ra1 : ra2;
+    uint32_t ntasks = num_threads;
+    // threads are capped by the total work, not by the larger input alone
+    const uint32_t max_tasks = ((uint32_t)ra1->size + (uint32_t)ra2->size) /
+                               PARALLEL_MIN_CONTAINERS_PER_THREAD;
+    if (ntasks > max_tasks) ntasks = max_tasks;
+#ifdef ROARING_DISABLE_THREADS
+    ntasks = 1;
+#endif
+    // the workers would not allocate from the arena of this thread, which
+    // is not safe to share anyway
+    if (roaring_thread_has_arena()) ntasks = 1;
+    if (ntasks <= 1) {
+        return op(x1, x2);
+    }
+
+    roaring_parallel_task_t *tasks = (roaring_parallel_task_t *)roaring_malloc(
+        ntasks * sizeof(roaring_parallel_task_t));
+    if (!tasks) return NULL;
+    int32_t start1 = 0, start2 = 0;
+    for (uint32_t t = 0; t < ntasks; t++) {
+        int32_t end1 = ra1->size, end2 = ra2->size;
+        if (t + 1 < ntasks) {
+            const uint16_t boundary =
+                big->keys[(int64_t)big->size * (t + 1) / ntasks];
+            end1 = ra_lower_bound(ra1, boundary);
+            end2 = ra_lower_bound(ra2, boundary);
+        }
+        tasks[t].op = op;
+        init_view(&tasks[t].view1, ra1, start1, end1);
+        init_view(&tasks[t].view2, ra2, start2, end2);
+        tasks[t].result = NULL;
+        start1 = end1;
+        start2 = end2;
+    }
+
+#ifndef ROARING_DISABLE_THREADS
+#if defined(_WIN32)
+    HANDLE *threads = (HANDLE *)roaring_malloc(ntasks * sizeof(HANDLE));
+    if (!threads) {
+        roaring_free(tasks);
+        return NULL;
+    }
+    for (uint32_t t = 1; t < ntasks; t++) {
+        threads[t] = CreateThread(NULL, 0, parallel_task_thread, &tasks[t], 0,
+                                  NULL);
+        if (threads[t] == NULL) parallel_task_run(&tasks[t]);
+    }
+    parallel_task_run(&tasks[0]);
+    for (uint32_t t = 1; t < ntasks; t++) {
+        if (threads[t] != NULL) {
+            WaitForSingleObject(threads[t], INFINITE);
+            CloseHandle(threads[t]);
+        }
+    }
+#else
+    pthread_t *threads = (pthread_t *)roaring_malloc(ntasks * sizeof(pthread_t));
+    bool *started = (bool *)roaring_malloc(ntasks * sizeof(bool));
+    if (!threads || !started) {
+        roaring_free(threads);
+        roaring_free(started);
+        roaring_free(tasks);
+        return NULL;
+    }
+    for (uint32_t t = 1; t < ntasks; t++) {
+        started[t] = pthread_create(&threads[t], NULL, parallel_task_thread,
+                                    &tasks[t]) == 0;
+        // if we cannot get a thread, the work is done on this one
+        if (!started[t]) parallel_task_run(&tasks[t]);
+    }
+    parallel_task_run(&tasks[0]);
+    for (uint32_t t = 1; t < ntasks; t++) {
+        if (started[t]) pthread_join(threads[t], NULL);
+    }
+    roaring_free(started);
+#endif
+    roaring_free(threads);
+#else
+    for (uint32_t t = 0; t < ntasks; t++) parallel_task_run(&tasks[t]);
+#endif  // ROARING_DISABLE_THREADS
+
+    uint32_t total = 0;
+    bool ok = true;
+    for (uint32_t t = 0; t < ntasks; t++) {
+        if (tasks[t].result == NULL) {
+            ok = false;
+        } else {
+            total += tasks[t].result->high_low_container.size;
+        }
+    }
+    roaring_bitmap_t *answer =
+        ok ? roaring_bitmap_create_with_capacity(total) : NULL;
+    if (answer != NULL) {
+        roaring_bitmap_set_copy_on_write(
+            answer, roaring_bitmap_get_copy_on_write(x1) &&
+                        roaring_bitmap_get_copy_on_write(x2));
+    }
+    roaring_array_t *ra = answer ? &answer->high_low_container : NULL;
+    for (uint32_t t = 0; t < ntasks; t++) {
+        roaring_bitmap_t *part = tasks[t].result;
+        if (part == NULL) continue;
+        if (answer == NULL) {
+            roaring_bitmap_free(part);
+            continue;
+        }
+        const roaring_array_t *pa = &part->high_low_container;
+        memcpy(ra->keys + ra->size, pa->keys, pa->size * sizeof(uint16_t));
+        memcpy(ra->containers + ra->size, pa->containers,
+               pa->size * sizeof(container_t *));
+        memcpy(ra->typecodes + ra->size, pa->typecodes,
+               pa->size * sizeof(uint8_t));
+        ra->size += pa->size;
+        // the containers now belong to 'answer'
+        ra_clear_without_containers(&part->high_low_container);
+        roaring_free(part);
+    }
+    roaring_free(tasks);
+    return answer;
+}
+
+roaring_bitmap_t *roaring_bitmap_and_parallel(const roaring_bitmap_t *r1,
+                                              const roaring_bitmap_t *r2,
+                                              uint32_t num_threads) {
+    return roaring_bitmap_parallel_op(roaring_bitmap_and, r1, r2, num_threads);
+}
+
+roaring_bitmap_t *roaring_bitmap_or_parallel(const roaring_bitmap_t *r1,
+                                             const roaring_bitmap_t *r2,
+                                             uint32_t num_threads) {
+    return roaring_bitmap_parallel_op(roaring_bitmap_or, r1, r2, num_threads);
+}
+
+roaring_bitmap_t *roaring_bitmap_xor_parallel(const roaring_bitmap_t *r1,
+                                              const roaring_bitmap_t *r2,
+                                              uint32_t num_threads) {
+    return roaring_bitmap_parallel_op(roaring_bitmap_xor, r1, r2, num_threads);
+}
+
+roaring_bitmap_t *roaring_bitmap_andnot_parallel(const roaring_bitmap_t *r1,
+                                                 const roaring_bitmap_t *r2,
+                                                 uint32_t num_threads) {
+    return roaring_bitmap_parallel_op(roaring_bitmap_andnot, r1, r2,
+                                      num_threads);
+}
+
+#ifdef __cplusplus
+} } }  // extern "C" { namespace roaring { namespace api {
+#endif
@@ -0,0 +1,256 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <roaring/roaring.h>
+#include <roaring/roaring_array.h>
+
+#if defined(__cplusplus)
+#include <atomic>
+#elif !(defined(_MSC_VER) && !defined(__clang__))
+#include <stdatomic.h>
+#endif
+
+#ifdef __cplusplus
+using namespace ::roaring::internal;
+
+extern "C" { namespace roaring { namespace api {
+#endif
+
+/*
+ * The epochs and the pointer to the latest version are shared between the
+ * writer and the readers. Like the reference counts of shared containers, they
+ * use std::atomic in C++, C11 atomics in C, and the Interlocked intrinsics with
+ * Visual Studio. All accesses are sequentially consistent: the correctness
+ * argument below relies on a single total order.
+ */
+#if defined(__cplusplus)
+typedef std::atomic<uint64_t> versioned_epoch_t;
+typedef std::atomic<roaring_bitmap_t *> versioned_pointer_t;
+
+static inline uint64_t epoch_load(versioned_epoch_t *e) { return e->load(); }
+static inline void epoch_store(versioned_epoch_t *e, uint64_t x) {
+    e->store(x);
+}
+static inline uint64_t epoch_increment(versioned_epoch_t *e) {
+    return e->fetch_add(1) + 1;
+}
+static inline roaring_bitmap_t *pointer_load(versioned_pointer_t *p) {
+    return p->load();
+}
+static inline void pointer_store(versioned_pointer_t *p, roaring_bitmap_t *x) {
+    p->store(x);
+}
+#elif defined(_MSC_VER) && !defined(__clang__)
+typedef volatile __int64 versioned_epoch_t;
+typedef void *volatile versioned_pointer_t;
+
+static inline uint64_t epoch_load(versioned_epoch_t *e) {
+    return (uint64_t)_InterlockedCompareExchange64(e, 0, 0);
+}
+static inline void epoch_store(versioned_epoch_t *e, uint64_t x) {
+    _InterlockedExchange64(e, (__int64)x);
+}
+static inline uint64_t epoch_increment(versioned_epoch_t *e) {
+    return (uint64_t)_InterlockedIncrement64(e);
+}
+static inline roaring_bitmap_t *pointer_load(versioned_pointer_t *p) {
+    return (roaring_bitmap_t *)_InterlockedCompareExchangePointer(p, NULL,
+                                                                  NULL);
+}
+static inline void pointer_store(versioned_pointer_t *p, roaring_bitmap_t *x) {
+    _InterlockedExchangePointer(p, x);
+}
+#else
+typedef _Atomic(uint64_t) versioned_epoch_t;
+typedef _Atomic(roaring_bitmap_t *) versioned_pointer_t;
+
+static inline uint64_t epoch_load(versioned_epoch_t *e) {
+    return atomic_load(e);
+}
+static inline void epoch_store(versioned_epoch_t *e, uint64_t x) {
+    atomic_store(e, x);
+}
+static inline uint64_t epoch_increment(versioned_epoch_t *e) {
+    return atomic_fetch_add(e, 1) + 1;
+}
+static inline roaring_bitmap_t *pointer_load(versioned_pointer_t *p) {
+    return atomic_load(p);
+}
+static inline void pointer_store(versioned_pointer_t *p, roaring_bitmap_t *x) {
+    atomic_store(p, x);
+}
+#endif
+
+#define VERSIONED_CACHE_LINE 64
+
+/*
+ * The epoch announced by a reader when it pinned a version, 0 when it holds
+ * none. Each reader has its own cache line, so that pinning does not bounce
+ * lines between the reader threads.
+ */
+typedef struct versioned_reader_s {
+    versioned_epoch_t epoch;
+    char padding[VERSIONED_CACHE_LINE - sizeof(versioned_epoch_t)];
+} versioned_reader_t;
+
+/*
+ * A replaced version. It was replaced before the global epoch became `epoch`,
+ * so only readers that announced an earlier epoch may still hold it.
+ */
+typedef struct versioned_retired_s {
+    roaring_bitmap_t *version;
+    uint64_t epoch;
+    struct versioned_retired_s *next;
+} versioned_retired_t;
+
+/*
+ * Readers announce the global epoch, then load the latest version. The writer
+ * stores the new version, then increments the global epoch to E, and retires
+ * the replaced version with epoch E. A reader that announced E or later loaded
+ * the epoch after the increment, hence the latest version after the store:
+ * the replaced version is safe to free once every pinned reader announced E or
+ * later. A reader that announced an older epoch only delays reclamation.
+ */
+struct roaring_versioned_bitmap_s {
+    versioned_pointer_t latest;
+    versioned_epoch_t epoch;  // starts at 1, 0 stands for "not pinned"
+    versioned_reader_t *readers;
+    size_t max_readers;
+    // accessed by the writer only
+    roaring_bitmap_t *working;
+    versioned_retired_t *retired;
+    size_t retired_count;
+};
+
+// Copies the working bitmap, sharing its containers. Copy-on-write is
+// disabled on the copy: sharing would write into it while readers hold it.
+static roaring_bitmap_t *versioned_snapshot(const roaring_bitmap_t *working) {
+    roaring_bitmap_t *version = roaring_bitmap_copy(working);
+    if (version == NULL) return NULL;
+    roaring_bitmap_set_copy_on_write(version, false);
+    if (roaring_bitmap_get_cardinality_index(working)) {
+        // Built now, as readers must not fill the cache concurrently.
+        roaring_bitmap_set_cardinality_index(version, true);
+        ra_get_card_index(&version->high_low_container);
+        ra_get_cardinality(&version->high_low_container);
+    }
+    return version;
+}
+
+// Frees the retired versions that no reader can still hold.
+static void versioned_reclaim(roaring_versioned_bitmap_t *v) {
+    if (v->retired == NULL) return;
+    uint64_t oldest = UINT64_MAX;
+    for (size_t i = 0; i < v->max_readers; i++) {
+        uint64_t e = epoch_load(&v->readers[i].epoch);
+        if (e != 0 && e < oldest) oldest = e;
+    }
+    versioned_retired_t **link = &v->retired;
+    while (*link != NULL) {
+        versioned_retired_t *node = *link;
+        if (node->epoch <= oldest) {
+            *link = node->next;
+            roaring_bitmap_free(node->version);
+            roaring_free(node);
+            v->retired_count--;
+        } else {
+            link = &node->next;
+        }
+    }
+}
+
+roaring_versioned_bitmap_t *roaring_versioned_bitmap_create(
+    roaring_bitmap_t *r, size_t max_readers) {
+    roaring_versioned_bitmap_t *v = (roaring_versioned_bitmap_t *)
+        roaring_malloc(sizeof(roaring_versioned_bitmap_t));
+    if (v == NULL) return NULL;
+    v->readers = NULL;
+    if (max_readers > 0) {
+        v->readers = (versioned_reader_t *)roaring_aligned_malloc(
+            VERSIONED_CACHE_LINE, max_readers * sizeof(versioned_reader_t));
+        if (v->readers == NULL) {
+            roaring_free(v);
+            return NULL;
+        }
+    }
+    for (size_t i = 0; i < max_readers; i++) {
+        epoch_store(&v->readers[i].epoch, 0);
+    }
+    v->max_readers = max_readers;
+    roaring_bitmap_set_copy_on_write(r, true);
+    roaring_bitmap_t *version = versioned_snapshot(r);
+    if (version == NULL) {
+        roaring_aligned_free(v->readers);
+        roaring_free(v);
+        return NULL;
+    }
+    pointer_store(&v->latest, version);
+    epoch_store(&v->epoch, 1);
+    v->working = r;
+    v->retired = NULL;
+    v->retired_count = 0;
+    return v;
+}
+
+roaring_bitmap_t *roaring_versioned_bitmap_working(
+    roaring_versioned_bitmap_t *v) {
+    return v->working;
+}
+
+bool roaring_versioned_bitmap_publish(roaring_versioned_bitmap_t *v) {
+    roaring_bitmap_t *version = versioned_snapshot(v->working);
+    if (version == NULL) return false;
+    versioned_retired_t *node =
+        (versioned_retired_t *)roaring_malloc(sizeof(versioned_retired_t));
+    if (node == NULL) {
+        roaring_bitmap_free(version);
+        return false;
+    }
+    node->version = pointer_load(&v->latest);
+    pointer_store(&v->latest, version);
+    node->epoch = epoch_increment(&v->epoch);
+    node->next = v->retired;
+    v->retired = node;
+    v->retired_count++;
+    versioned_reclaim(v);
+    return true;
+}
+
+size_t roaring_versioned_bitmap_retired_count(
+    const roaring_versioned_bitmap_t *v) {
+    return v->retired_count;
+}
+
+const roaring_bitmap_t *roaring_versioned_bitmap_pin(
+    roaring_versioned_bitmap_t *v, size_t reader) {
+    assert(reader < v->max_readers);
+    versioned_reader_t *slot = &v->readers[reader];
+    assert(epoch_load(&slot->epoch) == 0);  // one version at a time
+    epoch_store(&slot->epoch, epoch_load(&v->epoch));
+    return pointer_load(&v->latest);
+}
+
+void roaring_versioned_bitmap_unpin(roaring_versioned_bitmap_t *v,
+                                    size_t reader) {
+    assert(reader < v->max_readers);
+    epoch_store(&v->readers[reader].epoch, 0);
+}
+
+void roaring_versioned_bitmap_free(roaring_versioned_bitmap_t *v) {
+    versioned_retired_t *node = v->retired;
+    while (node != NULL) {
+        versioned_retired_t *next = node->next;
+        roaring_bitmap_free(node->version);
+        roaring_free(node);
+        node = next;
+    }
+    roaring_bitmap_free(pointer_load(&v->latest));
+    roaring_bitmap_free(v->working);
+    roaring_aligned_free(v->readers);
+    roaring_free(v);
+}
+
+#ifdef __cplusplus
+} } }  // extern "C" { namespace roaring { namespace api {
+#endif
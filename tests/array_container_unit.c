@@ -6,6 +6,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <roaring/containers/array.h>
 #include <roaring/misc/configreport.h>
@@ -192,12 +193,82 @@ DEFINE_TEST(capacity_test) {
     array_container_free(array);
 }
 
+// fills 'a' with about 'card' random values of [0, range) and 'in' with its
+// indicator function
+static void random_array(array_container_t* a, bool* in, uint32_t* seed,
+                         int card, uint32_t range) {
+    memset(in, 0, 65536 * sizeof(bool));
+    a->cardinality = 0;
+    for (int k = 0; k < card; k++) {
+        *seed = *seed * 1103515245 + 12345;
+        in[(*seed >> 8) % range] = true;
+    }
+    for (uint32_t x = 0; x < 65536; x++) {
+        if (in[x]) array_container_add(a, (uint16_t)x);
+    }
+}
+
+static void check_array(const array_container_t* a, const bool* in1,
+                        const bool* in2, bool (*op)(bool, bool)) {
+    int card = 0;
+    for (uint32_t x = 0; x < 65536; x++) {
+        if (op(in1[x], in2[x])) {
+            assert_true(card < a->cardinality);
+            assert_int_equal(a->array[card], x);
+            card++;
+        }
+    }
+    assert_int_equal(card, a->cardinality);
+}
+
+static bool op_and(bool x, bool y) { return x && y; }
+static bool op_or(bool x, bool y) { return x || y; }
+static bool op_xor(bool x, bool y) { return x != y; }
+static bool op_andnot(bool x, bool y) { return x && !y; }
+
+// balanced and skewed inputs, sparse and dense, take different SIMD paths
+DEFINE_TEST(random_ops_test) {
+    const int cards[] = {1, 7, 31, 32, 33, 100, 250, 1000, 4000};
+    const uint32_t ranges[] = {300, 5000, 65536};
+    const int ncards = sizeof(cards) / sizeof(cards[0]);
+    bool* in1 = (bool*)malloc(65536 * sizeof(bool));
+    bool* in2 = (bool*)malloc(65536 * sizeof(bool));
+    array_container_t* A = array_container_create();
+    array_container_t* B = array_container_create();
+    array_container_t* TMP = array_container_create();
+    uint32_t seed = 1234;
+    for (int r = 0; r < 3; r++) {
+        for (int i = 0; i < ncards; i++) {
+            for (int j = 0; j < ncards; j++) {
+                random_array(A, in1, &seed, cards[i], ranges[r]);
+                random_array(B, in2, &seed, cards[j], ranges[r]);
+                array_container_intersection(A, B, TMP);
+                check_array(TMP, in1, in2, op_and);
+                assert_int_equal(array_container_intersection_cardinality(A, B),
+                                 TMP->cardinality);
+                array_container_union(A, B, TMP);
+                check_array(TMP, in1, in2, op_or);
+                array_container_xor(A, B, TMP);
+                check_array(TMP, in1, in2, op_xor);
+                array_container_andnot(A, B, TMP);
+                check_array(TMP, in1, in2, op_andnot);
+            }
+        }
+    }
+    array_container_free(A);
+    array_container_free(B);
+    array_container_free(TMP);
+    free(in1);
+    free(in2);
+}
+
 int main() {
     const struct CMUnitTest tests[] = {
         cmocka_unit_test(printf_test), cmocka_unit_test(add_contains_test),
         cmocka_unit_test(and_or_test), cmocka_unit_test(to_uint32_array_test),
         cmocka_unit_test(select_test),
-        cmocka_unit_test(capacity_test)
+        cmocka_unit_test(capacity_test),
+        cmocka_unit_test(random_ops_test)
     };
 
     return cmocka_run_group_tests(tests, NULL, NULL);
@@ -167,6 +167,87 @@ DEFINE_TEST(xor_test) {
     bitset_container_free(TMP);
 }
 
+DEFINE_TEST(xor_many_test) {
+    enum { N = 5 };
+    bitset_container_t* B[N];
+    bitset_container_t* BI = bitset_container_create();
+    bitset_container_t* TMP = bitset_container_create();
+
+    for (int k = 0; k < N; k++) {
+        B[k] = bitset_container_create();
+        assert_non_null(B[k]);
+        for (size_t x = k; x < (1 << 16); x += 3 + 2 * k) {
+            bitset_container_set(B[k], x);
+        }
+    }
+
+    bitset_container_xor(B[0], B[1], BI);
+    for (int k = 2; k < N; k++) {
+        bitset_container_xor(BI, B[k], BI);
+    }
+
+    const bitset_container_t* srcs[N];
+    for (int k = 0; k < N; k++) srcs[k] = B[k];
+    assert_int_equal(bitset_container_xor_many(srcs, N, TMP),
+                     bitset_container_cardinality(BI));
+    assert_true(bitset_container_equals(TMP, BI));
+
+    // a single input is a copy, and the output may alias an input
+    bitset_container_xor_many(srcs, 1, TMP);
+    assert_true(bitset_container_equals(TMP, B[0]));
+    bitset_container_xor_many_nocard(srcs, N, B[0]);
+    B[0]->cardinality = bitset_container_compute_cardinality(B[0]);
+    assert_true(bitset_container_equals(B[0], BI));
+
+    for (int k = 0; k < N; k++) bitset_container_free(B[k]);
+    bitset_container_free(BI);
+    bitset_container_free(TMP);
+}
+
+DEFINE_TEST(count_many_test) {
+    // enough inputs to go through the four-input CSA groups and the tail
+    enum { N = 11, NSLICES = 4 };
+    bitset_container_t* B[N];
+    const bitset_container_t* srcs[N];
+    for (int k = 0; k < N; k++) {
+        B[k] = bitset_container_create();
+        assert_non_null(B[k]);
+        for (size_t x = k; x < (1 << 16); x += 1 + k) {
+            bitset_container_set(B[k], x);
+        }
+        srcs[k] = B[k];
+    }
+
+    uint64_t* slices = (uint64_t*)malloc(
+        NSLICES * BITSET_CONTAINER_SIZE_IN_WORDS * sizeof(uint64_t));
+    for (size_t nslices = 1; nslices <= NSLICES; nslices++) {
+        // the second round adds the same counts again
+        for (uint32_t round = 1; round <= 2; round++) {
+            if (round == 1) {
+                bitset_container_count_many(srcs, N, slices, nslices);
+            } else {
+                bitset_container_count_many_add(srcs, N, slices, nslices);
+            }
+            for (uint32_t x = 0; x < (1 << 16); x++) {
+                uint32_t expected = 0;
+                for (int k = 0; k < N; k++) {
+                    expected += bitset_container_get(B[k], (uint16_t)x);
+                }
+                expected *= round;
+                uint32_t got = 0;
+                for (size_t s = 0; s < nslices; s++) {
+                    got |= (uint32_t)((slices[s * BITSET_CONTAINER_SIZE_IN_WORDS +
+                                              x / 64] >> (x % 64)) & 1) << s;
+                }
+                assert_int_equal(got, expected & ((1u << nslices) - 1));
+            }
+        }
+    }
+    free(slices);
+
+    for (int k = 0; k < N; k++) bitset_container_free(B[k]);
+}
+
 DEFINE_TEST(andnot_test) {
     bitset_container_t* B1 = bitset_container_create();
     bitset_container_t* B2 = bitset_container_create();
@@ -259,6 +340,8 @@ int main() {
         cmocka_unit_test(test_bitset_lenrange_cardinality),
         cmocka_unit_test(printf_test), cmocka_unit_test(set_get_test),
         cmocka_unit_test(and_or_test), cmocka_unit_test(xor_test),
+        cmocka_unit_test(xor_many_test),
+        cmocka_unit_test(count_many_test),
         cmocka_unit_test(andnot_test), cmocka_unit_test(to_uint32_array_test),
         cmocka_unit_test(select_test),
         cmocka_unit_test(test_bitset_compute_cardinality),
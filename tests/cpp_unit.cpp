@@ -9,12 +9,18 @@
 #include <string.h>
 #include <time.h>
 #include <iostream>
+#include <vector>
+#ifndef ROARING_DISABLE_THREADS
+#include <atomic>
+#include <thread>
+#endif
 #include <roaring/misc/configreport.h>
 
 #include <roaring/roaring.h>  // access to pure C exported API for testing
 
 #include "roaring.hh"
 using roaring::Roaring;  // the C++ wrapper class
+using roaring::RoaringIntersectionIterator;
 
 #include "roaring64map.hh"
 using roaring::Roaring64Map;  // C++ class extended for 64-bit numbers
@@ -596,6 +602,196 @@ DEFINE_TEST(test_cpp_bidirectional_iterator_64) {
 	assert_true(i == roaring.begin());
 }
 
+DEFINE_TEST(test_cpp_cardinality_index_64) {
+    Roaring64Map roaring;
+    roaring.setCardinalityIndex(true);
+    for (uint64_t i = 0; i < 5; ++i) {
+        for (uint64_t x = 0; x < 100000; x += 3) roaring.add((i << 32) | x);
+    }
+    assert_true(roaring.getCardinalityIndex());
+    assert_int_equal(roaring.cardinality(), 5 * 33334);
+    roaring.remove(UINT64_C(3));
+    roaring.add(UINT64_C(0xF00000001));
+    // the cached total follows insertions and removals
+    const uint64_t card = roaring.cardinality();
+    roaring.add(UINT64_C(0x300000001));
+    roaring.add(UINT64_C(0x300000003));  // already there
+    assert_false(roaring.addChecked(UINT64_C(0x300000006)));
+    assert_true(roaring.removeChecked(UINT64_C(0x300000006)));
+    assert_false(roaring.removeChecked(UINT64_C(0x700000000)));
+    roaring.remove(UINT64_C(0x400000000));
+    const uint64_t more[] = {UINT64_C(0x800000000), UINT64_C(0x800000001)};
+    roaring.addMany(2, more);
+    assert_int_equal(roaring.cardinality(), card + 1);
+    roaring.flip(0x100000000ULL, 0x100000010ULL);
+
+    Roaring64Map copy(roaring);
+    assert_true(copy.getCardinalityIndex());
+    Roaring64Map plain;
+    plain |= roaring;
+    assert_false(plain.getCardinalityIndex());
+    assert_int_equal(roaring.cardinality(), plain.cardinality());
+    assert_int_equal(copy.cardinality(), plain.cardinality());
+    assert_true(copy == plain);
+
+    roaring.setCardinalityIndex(false);
+    assert_int_equal(roaring.cardinality(), plain.cardinality());
+}
+
+DEFINE_TEST(test_cpp_bulk) {
+    Roaring r;
+    Roaring::BulkContext context{};
+    for (uint32_t v = 0; v < 300000; v += 7) r.addBulk(context, v);
+    assert_true(r.cardinality() == (300000 + 6) / 7);
+    Roaring::BulkContext lookup{};
+    for (uint32_t v = 0; v < 310000; v++) {
+        assert_true(r.containsBulk(lookup, v) == (v < 300000 && v % 7 == 0));
+    }
+}
+
+DEFINE_TEST(test_cpp_contains_many) {
+    Roaring r;
+    for (uint32_t v = 0; v < 300000; v += 7) r.add(v);
+    std::vector<uint32_t> vals;
+    for (uint32_t v = 0; v < 310000; v += 3) vals.push_back(v);
+    std::vector<uint64_t> bits((vals.size() + 63) / 64);
+    r.containsMany(vals.size(), vals.data(), bits.data());
+    for (size_t i = 0; i < vals.size(); i++) {
+        assert_true(((bits[i / 64] >> (i % 64)) & 1) == r.contains(vals[i]));
+    }
+}
+
+DEFINE_TEST(test_cpp_intersection_iterator) {
+    Roaring r1, r2, r3;
+    for (uint32_t v = 0; v < 1000000; v += 3) r1.add(v);
+    for (uint32_t v = 0; v < 1000000; v += 5) r2.add(v);
+    r3.addRange(100000, 900000);
+    const Roaring *inputs[] = {&r1, &r2, &r3};
+    Roaring expected = r1 & r2 & r3;
+    RoaringIntersectionIterator it(3, inputs);
+    for (Roaring::const_iterator e = expected.begin(); e != expected.end();
+         ++e) {
+        assert_true(it != RoaringIntersectionIterator());
+        assert_int_equal(*it, *e);
+        ++it;
+    }
+    assert_true(it == RoaringIntersectionIterator());
+    RoaringIntersectionIterator again(3, inputs);
+    again.equalorlarger(500001);
+    RoaringIntersectionIterator copy = again;
+    ++again;
+    assert_int_equal(*copy, 500010);
+    assert_int_equal(*again, 500025);
+}
+
+DEFINE_TEST(test_cpp_iterate_template) {
+    Roaring r;
+    for (uint32_t v = 0; v < 500000; v += 3) r.add(v);
+    r.addRange(1000000, 1100000);
+    uint64_t sum = 0, count = 0;
+    assert_true(r.iterate([&](uint32_t v) {
+        sum += v;
+        count++;
+        return true;
+    }));
+    uint64_t expected_sum = 0;
+    for (Roaring::const_iterator i = r.begin(); i != r.end(); ++i) {
+        expected_sum += *i;
+    }
+    assert_int_equal(count, r.cardinality());
+    assert_int_equal(sum, expected_sum);
+    count = 0;
+    assert_false(r.iterate([&](uint32_t) { return ++count < 1000; }));
+    assert_int_equal(count, 1000);
+}
+
+#ifndef ROARING_DISABLE_THREADS
+DEFINE_TEST(test_cpp_cow_copies_across_threads) {
+    roaring_bitmap_t *base = roaring_bitmap_from_range(0, 1 << 20, 3);
+    roaring_bitmap_add_range(base, 1 << 21, 1 << 22);
+    for (uint32_t v = 1 << 23; v < (1 << 24); v += 1000) {
+        roaring_bitmap_add(base, v);
+    }
+    roaring_bitmap_set_copy_on_write(base, true);
+    const uint64_t card = roaring_bitmap_get_cardinality(base);
+
+    for (int round = 0; round < 10; round++) {
+        const int number = 8;
+        std::vector<roaring_bitmap_t *> copies;
+        for (int i = 0; i < number; i++) {  // copies share the containers
+            copies.push_back(roaring_bitmap_copy(base));
+        }
+        std::vector<char> ok(number, 0);  // not vector<bool>: bits would race
+        std::vector<std::thread> threads;
+        for (int i = 0; i < number; i++) {
+            threads.emplace_back([&copies, &ok, card, i]() {
+                roaring_bitmap_t *r = copies[i];
+                bool good = roaring_bitmap_get_cardinality(r) == card;
+                if (i % 2 == 0) {  // writes, detaching the containers
+                    for (uint32_t v = 1; v < (1 << 24); v += 4099) {
+                        roaring_bitmap_add(r, v);
+                    }
+                    roaring_bitmap_remove_range(r, 0, 1 << 20);
+                    good = good && !roaring_bitmap_contains(r, 3) &&
+                           roaring_bitmap_contains(r, 1 << 21);
+                }
+                roaring_bitmap_free(r);
+                ok[i] = good;
+            });
+        }
+        for (std::thread &t : threads) t.join();
+        for (int i = 0; i < number; i++) assert_true(ok[i]);
+        assert_int_equal(roaring_bitmap_get_cardinality(base), card);
+    }
+    roaring_bitmap_free(base);
+}
+
+DEFINE_TEST(test_cpp_versioned_bitmap_across_threads) {
+    const uint32_t steps = 3000;
+    const int number = 4;
+    roaring_versioned_bitmap_t *v =
+        roaring_versioned_bitmap_create(roaring_bitmap_create(), number);
+    std::atomic<bool> done(false);
+    std::vector<char> ok(number, 0);
+    std::vector<std::thread> readers;
+    for (int i = 0; i < number; i++) {
+        readers.emplace_back([v, &done, &ok, i]() {
+            bool good = true;
+            uint64_t last_card = 0;
+            while (good && !done.load()) {
+                const roaring_bitmap_t *r = roaring_versioned_bitmap_pin(v, i);
+                // version s holds s * 7919 for s in [1, s], and 3 if s is odd
+                uint64_t card = roaring_bitmap_get_cardinality(r);
+                uint32_t s = roaring_bitmap_is_empty(r)
+                                 ? 0 : roaring_bitmap_maximum(r) / 7919;
+                good = card == s + (s % 2) &&
+                       roaring_bitmap_contains(r, 3) == (s % 2 == 1) &&
+                       card >= last_card;
+                last_card = card;
+                roaring_versioned_bitmap_unpin(v, i);
+            }
+            ok[i] = good;
+        });
+    }
+    roaring_bitmap_t *working = roaring_versioned_bitmap_working(v);
+    for (uint32_t s = 1; s <= steps; s++) {  // the writer
+        roaring_bitmap_add(working, s * 7919);
+        if (s % 2 == 1) {
+            roaring_bitmap_add(working, 3);
+        } else {
+            roaring_bitmap_remove(working, 3);
+        }
+        assert_true(roaring_versioned_bitmap_publish(v));
+    }
+    done.store(true);
+    for (std::thread &t : readers) t.join();
+    for (int i = 0; i < number; i++) assert_true(ok[i]);
+    assert_true(roaring_versioned_bitmap_publish(v));
+    assert_int_equal(roaring_versioned_bitmap_retired_count(v), 0);
+    roaring_versioned_bitmap_free(v);
+}
+#endif
+
 int main() {
     roaring::misc::tellmeall();
     const struct CMUnitTest tests[] = {
@@ -614,7 +810,17 @@ int main() {
         cmocka_unit_test(test_run_compression_cpp_false),
 		cmocka_unit_test(test_cpp_clear_64),
 		cmocka_unit_test(test_cpp_move_64),
-		cmocka_unit_test(test_cpp_bidirectional_iterator_64)};
+		cmocka_unit_test(test_cpp_bidirectional_iterator_64),
+        cmocka_unit_test(test_cpp_cardinality_index_64),
+        cmocka_unit_test(test_cpp_bulk),
+        cmocka_unit_test(test_cpp_contains_many),
+        cmocka_unit_test(test_cpp_intersection_iterator),
+        cmocka_unit_test(test_cpp_iterate_template),
+#ifndef ROARING_DISABLE_THREADS
+        cmocka_unit_test(test_cpp_cow_copies_across_threads),
+        cmocka_unit_test(test_cpp_versioned_bitmap_across_threads),
+#endif
+    };
 
     return cmocka_run_group_tests(tests, NULL, NULL);
 }
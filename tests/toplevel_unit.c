@@ -4148,6 +4148,1379 @@ DEFINE_TEST(test_frozen_serialization_max_containers) {
     frozen_serialization_compare(r);
 }
 
+void test_and_many_with_cow(bool copy_on_write) {
+    roaring_bitmap_t *r[4];
+    for (int k = 0; k < 4; k++) {
+        r[k] = roaring_bitmap_create();
+        roaring_bitmap_set_copy_on_write(r[k], copy_on_write);
+    }
+    for (uint32_t i = 0; i < 1000000; i += 3) roaring_bitmap_add(r[0], i);
+    for (uint32_t i = 0; i < 1000000; i += 5) roaring_bitmap_add(r[1], i);
+    roaring_bitmap_add_range(r[2], 100000, 700000);
+    roaring_bitmap_add_range(r[2], 800000, 900000);
+    for (uint32_t i = 0; i < 2000000; i += 7) roaring_bitmap_add(r[3], i);
+    roaring_bitmap_run_optimize(r[2]);
+
+    roaring_bitmap_t *expected = roaring_bitmap_copy(r[0]);
+    for (int k = 1; k < 4; k++) {
+        roaring_bitmap_and_inplace(expected, r[k]);
+    }
+    roaring_bitmap_t *actual =
+        roaring_bitmap_and_many(4, (const roaring_bitmap_t **)r);
+    assert_true(roaring_bitmap_equals(expected, actual));
+    assert_true(roaring_bitmap_get_cardinality(actual) > 0);
+    roaring_bitmap_free(actual);
+    roaring_bitmap_free(expected);
+
+    // single input is a copy, disjoint and empty inputs give empty results
+    actual = roaring_bitmap_and_many(1, (const roaring_bitmap_t **)r);
+    assert_true(roaring_bitmap_equals(r[0], actual));
+    roaring_bitmap_free(actual);
+
+    roaring_bitmap_t *disjoint = roaring_bitmap_from_range(3000000, 3001000, 1);
+    const roaring_bitmap_t *withdisjoint[] = {r[0], r[3], disjoint};
+    actual = roaring_bitmap_and_many(3, withdisjoint);
+    assert_true(roaring_bitmap_is_empty(actual));
+    roaring_bitmap_free(actual);
+    roaring_bitmap_free(disjoint);
+
+    roaring_bitmap_t *empty = roaring_bitmap_create();
+    const roaring_bitmap_t *withempty[] = {r[0], empty, r[1]};
+    actual = roaring_bitmap_and_many(3, withempty);
+    assert_true(roaring_bitmap_is_empty(actual));
+    roaring_bitmap_free(actual);
+    roaring_bitmap_free(empty);
+
+    actual = roaring_bitmap_and_many(0, NULL);
+    assert_true(roaring_bitmap_is_empty(actual));
+    roaring_bitmap_free(actual);
+
+    for (int k = 0; k < 4; k++) roaring_bitmap_free(r[k]);
+}
+
+DEFINE_TEST(test_and_many) {
+    test_and_many_with_cow(false);
+    test_and_many_with_cow(true);
+}
+
+void test_or_many_with_cow(bool copy_on_write) {
+    enum { N = 6 };
+    roaring_bitmap_t *r[N];
+    for (int k = 0; k < N; k++) {
+        r[k] = roaring_bitmap_create();
+        roaring_bitmap_set_copy_on_write(r[k], copy_on_write);
+    }
+    // key 0: small arrays only; key 1: arrays adding up to a bitset;
+    // key 2: runs only; key 3: a mix of everything; key 4: a full container;
+    // key 5: present in a single input
+    for (uint32_t i = 0; i < 100; i++) {
+        roaring_bitmap_add(r[0], i * 7);
+        roaring_bitmap_add(r[1], i * 11);
+    }
+    for (int k = 0; k < N; k++) {
+        for (uint32_t i = k; i < 3000; i += 3) {
+            roaring_bitmap_add(r[k], 65536 + i * 19);
+        }
+    }
+    roaring_bitmap_add_range(r[2], 2 * 65536 + 10, 2 * 65536 + 500);
+    roaring_bitmap_add_range(r[3], 2 * 65536 + 400, 2 * 65536 + 900);
+    roaring_bitmap_add_range(r[4], 2 * 65536 + 5000, 2 * 65536 + 6000);
+    for (uint32_t i = 0; i < 65536; i += 2) {
+        roaring_bitmap_add(r[0], 3 * 65536 + i);
+    }
+    roaring_bitmap_add(r[1], 3 * 65536 + 1);
+    roaring_bitmap_add_range(r[2], 3 * 65536 + 101, 3 * 65536 + 301);
+    roaring_bitmap_add_range(r[4], 4 * 65536, 5 * 65536);
+    roaring_bitmap_add(r[5], 4 * 65536 + 3);
+    roaring_bitmap_add(r[5], 5 * 65536 + 3);
+    for (int k = 0; k < N; k++) {
+        roaring_bitmap_run_optimize(r[k]);
+    }
+    // sharing containers must not affect the union
+    roaring_bitmap_t *copy = roaring_bitmap_copy(r[2]);
+
+    roaring_bitmap_t *expected = roaring_bitmap_copy(r[0]);
+    for (int k = 1; k < N; k++) {
+        roaring_bitmap_or_inplace(expected, r[k]);
+    }
+    roaring_bitmap_t *actual =
+        roaring_bitmap_or_many(N, (const roaring_bitmap_t **)r);
+    assert_true(roaring_bitmap_equals(expected, actual));
+    roaring_bitmap_t *heap =
+        roaring_bitmap_or_many_heap(N, (const roaring_bitmap_t **)r);
+    assert_true(roaring_bitmap_equals(heap, actual));
+
+    roaring_bitmap_free(heap);
+    roaring_bitmap_free(actual);
+    roaring_bitmap_free(expected);
+    roaring_bitmap_free(copy);
+    for (int k = 0; k < N; k++) roaring_bitmap_free(r[k]);
+}
+
+DEFINE_TEST(test_or_many) {
+    test_or_many_with_cow(false);
+    test_or_many_with_cow(true);
+}
+
+DEFINE_TEST(test_xor_many) {
+    enum { N = 6 };
+    roaring_bitmap_t *r[N];
+    for (int k = 0; k < N; k++) {
+        r[k] = roaring_bitmap_create();
+        // arrays, then bitsets, for each input
+        for (uint32_t i = k; i < 2000; i += 5) {
+            roaring_bitmap_add(r[k], i * 13);
+        }
+        for (uint32_t i = k; i < 65536; i += k + 2) {
+            roaring_bitmap_add(r[k], 2 * 65536 + i);
+        }
+    }
+    roaring_bitmap_add_range(r[1], 100, 30000);
+    roaring_bitmap_add_range(r[2], 2 * 65536 + 1000, 2 * 65536 + 9000);
+    roaring_bitmap_add_range(r[3], 5 * 65536, 5 * 65536 + 300);
+    roaring_bitmap_add_range(r[4], 5 * 65536 + 200, 5 * 65536 + 400);
+    roaring_bitmap_add_range(r[5], 7 * 65536, 7 * 65536 + 10);
+    for (int k = 1; k < N; k += 2) {
+        roaring_bitmap_run_optimize(r[k]);
+    }
+    // identical inputs cancel out
+    roaring_bitmap_add(r[0], 9 * 65536 + 5);
+    roaring_bitmap_add(r[1], 9 * 65536 + 5);
+
+    roaring_bitmap_t *expected = roaring_bitmap_copy(r[0]);
+    for (int k = 1; k < N; k++) {
+        roaring_bitmap_xor_inplace(expected, r[k]);
+    }
+    roaring_bitmap_t *actual =
+        roaring_bitmap_xor_many(N, (const roaring_bitmap_t **)r);
+    assert_true(roaring_bitmap_equals(expected, actual));
+    assert_false(roaring_bitmap_contains(actual, 9 * 65536 + 5));
+
+    roaring_bitmap_free(actual);
+    roaring_bitmap_free(expected);
+    for (int k = 0; k < N; k++) roaring_bitmap_free(r[k]);
+}
+
+// checks the expression against its eager evaluation
+static void check_expr(roaring_expr_t *e, const roaring_bitmap_t *expected) {
+    roaring_bitmap_t *actual = roaring_expr_evaluate(e);
+    assert_true(roaring_bitmap_equals(expected, actual));
+    assert_int_equal(roaring_expr_cardinality(e),
+                     roaring_bitmap_get_cardinality(expected));
+    assert_true(roaring_expr_is_nonempty(e) ==
+                !roaring_bitmap_is_empty(expected));
+    roaring_bitmap_free(actual);
+}
+
+DEFINE_TEST(test_expr) {
+    roaring_bitmap_t *a = roaring_bitmap_create();
+    roaring_bitmap_t *b = roaring_bitmap_create();
+    roaring_bitmap_t *c = roaring_bitmap_create();
+    roaring_bitmap_t *d = roaring_bitmap_create();
+    for (uint32_t i = 0; i < 1000000; i += 3) roaring_bitmap_add(a, i);
+    for (uint32_t i = 500000; i < 2000000; i += 5) roaring_bitmap_add(b, i);
+    roaring_bitmap_add_range(c, 0, 300000);
+    roaring_bitmap_add_range(c, 1500000, 1600000);
+    roaring_bitmap_run_optimize(c);
+    for (uint32_t i = 0; i < 3000000; i += 65536) roaring_bitmap_add(d, i);
+
+    // (a | b) & ~c & d
+    roaring_expr_t *e = roaring_expr_and(
+        roaring_expr_andnot(
+            roaring_expr_or(roaring_expr_leaf(a), roaring_expr_leaf(b)),
+            roaring_expr_leaf(c)),
+        roaring_expr_leaf(d));
+    roaring_bitmap_t *t1 = roaring_bitmap_or(a, b);
+    roaring_bitmap_andnot_inplace(t1, c);
+    roaring_bitmap_and_inplace(t1, d);
+    check_expr(e, t1);
+    // evaluating twice gives the same result
+    check_expr(e, t1);
+    roaring_expr_free(e);
+    roaring_bitmap_free(t1);
+
+    // (a ^ c) | (b & c), with an operand that is a leaf on the root
+    e = roaring_expr_or(
+        roaring_expr_xor(roaring_expr_leaf(a), roaring_expr_leaf(c)),
+        roaring_expr_and(roaring_expr_leaf(b), roaring_expr_leaf(c)));
+    t1 = roaring_bitmap_xor(a, c);
+    roaring_bitmap_t *t2 = roaring_bitmap_and(b, c);
+    roaring_bitmap_or_inplace(t1, t2);
+    check_expr(e, t1);
+    roaring_expr_free(e);
+    roaring_bitmap_free(t1);
+    roaring_bitmap_free(t2);
+
+    // root operations over leaves
+    e = roaring_expr_xor(roaring_expr_leaf(b), roaring_expr_leaf(c));
+    t1 = roaring_bitmap_xor(b, c);
+    check_expr(e, t1);
+    roaring_expr_free(e);
+    roaring_bitmap_free(t1);
+
+    e = roaring_expr_andnot(roaring_expr_leaf(c), roaring_expr_leaf(a));
+    t1 = roaring_bitmap_andnot(c, a);
+    check_expr(e, t1);
+    roaring_expr_free(e);
+    roaring_bitmap_free(t1);
+
+    // an empty result: a & ~a & b
+    e = roaring_expr_and(
+        roaring_expr_andnot(roaring_expr_leaf(a), roaring_expr_leaf(a)),
+        roaring_expr_leaf(b));
+    t1 = roaring_bitmap_create();
+    check_expr(e, t1);
+    roaring_expr_free(e);
+
+    // an inner AND that is empty on its key, under an OR and a XOR root:
+    // ({1} & {2}) op {1 << 20}
+    roaring_bitmap_t *x = roaring_bitmap_of(1, 1);
+    roaring_bitmap_t *y = roaring_bitmap_of(1, 2);
+    roaring_bitmap_t *z = roaring_bitmap_of(1, 1 << 20);
+    e = roaring_expr_or(
+        roaring_expr_and(roaring_expr_leaf(x), roaring_expr_leaf(y)),
+        roaring_expr_leaf(z));
+    check_expr(e, z);
+    roaring_expr_free(e);
+    e = roaring_expr_xor(
+        roaring_expr_and(roaring_expr_leaf(x), roaring_expr_leaf(y)),
+        roaring_expr_leaf(z));
+    check_expr(e, z);
+    roaring_expr_free(e);
+    // and with both operands of the root empty
+    e = roaring_expr_or(
+        roaring_expr_and(roaring_expr_leaf(x), roaring_expr_leaf(y)),
+        roaring_expr_and(roaring_expr_leaf(y), roaring_expr_leaf(z)));
+    check_expr(e, t1);
+    roaring_expr_free(e);
+    roaring_bitmap_free(x);
+    roaring_bitmap_free(y);
+    roaring_bitmap_free(z);
+
+    e = roaring_expr_leaf(d);
+    check_expr(e, d);
+    roaring_expr_free(e);
+    roaring_bitmap_free(t1);
+
+    roaring_bitmap_free(a);
+    roaring_bitmap_free(b);
+    roaring_bitmap_free(c);
+    roaring_bitmap_free(d);
+}
+
+void test_parallel_ops_with_cow(bool copy_on_write) {
+    roaring_bitmap_t *r1 = roaring_bitmap_create();
+    roaring_bitmap_t *r2 = roaring_bitmap_create();
+    roaring_bitmap_set_copy_on_write(r1, copy_on_write);
+    roaring_bitmap_set_copy_on_write(r2, copy_on_write);
+    // enough containers to use several threads, with keys in only one input
+    for (uint32_t k = 0; k < 12000; k++) {
+        for (uint32_t i = 0; i < 8; i++) {
+            if (k % 7 != 0) roaring_bitmap_add(r1, k * 65536 + i * 3);
+            if (k % 5 != 0) roaring_bitmap_add(r2, k * 65536 + i * 5);
+        }
+    }
+    roaring_bitmap_add_range(r1, 600 * 65536, 700 * 65536);
+    roaring_bitmap_run_optimize(r1);
+
+    for (uint32_t threads = 0; threads <= 8; threads += 4) {
+        roaring_bitmap_t *expected = roaring_bitmap_and(r1, r2);
+        roaring_bitmap_t *actual = roaring_bitmap_and_parallel(r1, r2, threads);
+        assert_true(roaring_bitmap_equals(expected, actual));
+        roaring_bitmap_free(expected);
+        roaring_bitmap_free(actual);
+
+        expected = roaring_bitmap_or(r1, r2);
+        actual = roaring_bitmap_or_parallel(r1, r2, threads);
+        assert_true(roaring_bitmap_equals(expected, actual));
+        assert_true(roaring_bitmap_get_copy_on_write(actual) == copy_on_write);
+        roaring_bitmap_free(expected);
+        roaring_bitmap_free(actual);
+
+        expected = roaring_bitmap_xor(r1, r2);
+        actual = roaring_bitmap_xor_parallel(r1, r2, threads);
+        assert_true(roaring_bitmap_equals(expected, actual));
+        roaring_bitmap_free(expected);
+        roaring_bitmap_free(actual);
+
+        expected = roaring_bitmap_andnot(r1, r2);
+        actual = roaring_bitmap_andnot_parallel(r1, r2, threads);
+        assert_true(roaring_bitmap_equals(expected, actual));
+        roaring_bitmap_free(expected);
+        roaring_bitmap_free(actual);
+    }
+    roaring_bitmap_free(r1);
+    roaring_bitmap_free(r2);
+}
+
+DEFINE_TEST(test_parallel_ops) {
+    test_parallel_ops_with_cow(false);
+    test_parallel_ops_with_cow(true);
+}
+
+DEFINE_TEST(test_threshold_many) {
+    enum { N = 5 };
+    roaring_bitmap_t *r[N];
+    for (int k = 0; k < N; k++) {
+        r[k] = roaring_bitmap_create();
+        for (uint32_t i = 0; i < 300000; i += k + 2) {
+            roaring_bitmap_add(r[k], i);
+        }
+    }
+    roaring_bitmap_add_range(r[0], 70000, 90000);
+    roaring_bitmap_add_range(r[1], 85000, 140000);
+    roaring_bitmap_add_range(r[2], 500000, 501000);
+    roaring_bitmap_add_range(r[3], 500500, 502000);
+    roaring_bitmap_run_optimize(r[1]);
+    roaring_bitmap_run_optimize(r[3]);
+
+    for (size_t t = 0; t <= N + 1; t++) {
+        roaring_bitmap_t *expected = roaring_bitmap_create();
+        for (uint32_t v = 0; v < 600000; v++) {
+            size_t count = 0;
+            for (int k = 0; k < N; k++) {
+                count += roaring_bitmap_contains(r[k], v);
+            }
+            if (count > 0 && count >= t) roaring_bitmap_add(expected, v);
+        }
+        roaring_bitmap_t *actual =
+            roaring_bitmap_threshold_many(N, (const roaring_bitmap_t **)r, t);
+        assert_true(roaring_bitmap_equals(expected, actual));
+        roaring_bitmap_free(actual);
+        roaring_bitmap_free(expected);
+    }
+    for (int k = 0; k < N; k++) roaring_bitmap_free(r[k]);
+
+    // more inputs than are counted in one batch, of every container type
+    enum { M = 70 };
+    roaring_bitmap_t *m[M];
+    for (int k = 0; k < M; k++) {
+        m[k] = roaring_bitmap_create();
+        for (uint32_t i = k; i < 150000; i += k % 40 + 1) {
+            roaring_bitmap_add(m[k], i);
+        }
+        if (k % 5 == 0) {
+            roaring_bitmap_add_range(m[k], 1000 * k, 1000 * k + 30000);
+            roaring_bitmap_run_optimize(m[k]);
+        }
+    }
+    const size_t thresholds[] = {2, 33, M - 1};
+    for (size_t t = 0; t < sizeof(thresholds) / sizeof(thresholds[0]); t++) {
+        roaring_bitmap_t *expected = roaring_bitmap_create();
+        for (uint32_t v = 0; v < 150000; v++) {
+            size_t count = 0;
+            for (int k = 0; k < M; k++) {
+                count += roaring_bitmap_contains(m[k], v);
+            }
+            if (count >= thresholds[t]) roaring_bitmap_add(expected, v);
+        }
+        roaring_bitmap_t *actual = roaring_bitmap_threshold_many(
+            M, (const roaring_bitmap_t **)m, thresholds[t]);
+        assert_true(roaring_bitmap_equals(expected, actual));
+        roaring_bitmap_free(actual);
+        roaring_bitmap_free(expected);
+    }
+    for (int k = 0; k < M; k++) roaring_bitmap_free(m[k]);
+}
+
+DEFINE_TEST(test_bulk) {
+    roaring_bitmap_t *expected = roaring_bitmap_create();
+    roaring_bitmap_t *actual = roaring_bitmap_create();
+    roaring_bulk_context_t context = {0};
+    // clustered batches, revisiting keys and growing arrays into bitsets
+    for (uint32_t batch = 0; batch < 400; batch++) {
+        const uint32_t key = (batch * 7) % 23;
+        for (uint32_t i = 0; i < 50; i++) {
+            const uint32_t v = (key << 16) | ((batch * 131 + i * 17) & 0xFFFF);
+            roaring_bitmap_add(expected, v);
+            roaring_bitmap_add_bulk(actual, &context, v);
+        }
+    }
+    assert_true(roaring_bitmap_equals(expected, actual));
+
+    // lookups on a copy-on-write clone, in increasing and in random order
+    roaring_bitmap_set_copy_on_write(actual, true);
+    roaring_bitmap_t *clone = roaring_bitmap_copy(actual);
+    roaring_bulk_context_t lookup = {0};
+    for (uint32_t v = 0; v < (24u << 16); v += 3) {
+        assert_true(roaring_bitmap_contains_bulk(clone, &lookup, v) ==
+                    roaring_bitmap_contains(expected, v));
+    }
+    memset(&lookup, 0, sizeof(lookup));
+    uint32_t v = 1;
+    for (int i = 0; i < 100000; i++) {
+        v = v * 1103515245 + 12345;
+        const uint32_t x = v % (25u << 16);
+        assert_true(roaring_bitmap_contains_bulk(clone, &lookup, x) ==
+                    roaring_bitmap_contains(expected, x));
+    }
+
+    // the context of a lookup holds a shared container: adding through it
+    // must detach the container from the original only once
+    memset(&lookup, 0, sizeof(lookup));
+    roaring_bitmap_contains_bulk(clone, &lookup, 5);
+    roaring_bitmap_add_bulk(clone, &lookup, 5000);
+    roaring_bitmap_add_bulk(clone, &lookup, 5001);
+    assert_true(roaring_bitmap_contains(clone, 5000));
+    assert_false(roaring_bitmap_contains(actual, 5000));
+    roaring_bitmap_free(clone);
+    assert_true(roaring_bitmap_equals(expected, actual));
+    assert_int_equal(roaring_bitmap_get_cardinality(actual),
+                     roaring_bitmap_get_cardinality(expected));
+
+    clone = roaring_bitmap_copy(actual);
+    roaring_bitmap_free(actual);
+    roaring_bitmap_free(expected);
+}
+
+DEFINE_TEST(test_add_many_sorted) {
+    enum { N = 400000 };
+    uint32_t *vals = (uint32_t *)malloc(N * sizeof(uint32_t));
+    size_t n = 0;
+    // runs, then a dense chunk, then sparse values across many keys
+    for (uint32_t v = 10; v < 70000; v++) vals[n++] = v;
+    for (uint32_t v = 200000; v < 260000; v += 3) vals[n++] = v;
+    for (uint32_t v = 300000; n < N; v += 997) vals[n++] = v;
+
+    for (int prefix = 0; prefix < 3; prefix++) {
+        roaring_bitmap_t *expected = roaring_bitmap_create();
+        roaring_bitmap_t *actual = roaring_bitmap_create();
+        if (prefix == 1) {  // content before the sorted values
+            roaring_bitmap_add(expected, 5);
+            roaring_bitmap_add(actual, 5);
+        } else if (prefix == 2) {  // content after them: general path
+            roaring_bitmap_add(expected, UINT32_MAX);
+            roaring_bitmap_add(actual, UINT32_MAX);
+        }
+        for (size_t i = 0; i < n; i++) roaring_bitmap_add(expected, vals[i]);
+        roaring_bitmap_add_many(actual, n, vals);
+        assert_true(roaring_bitmap_equals(expected, actual));
+        assert_true(roaring_bitmap_get_cardinality(actual) ==
+                    roaring_bitmap_get_cardinality(expected));
+        roaring_bitmap_free(actual);
+        roaring_bitmap_free(expected);
+    }
+
+    // one run container holds the first chunk
+    roaring_bitmap_t *r = roaring_bitmap_of_ptr(n, vals);
+    roaring_statistics_t stats;
+    roaring_bitmap_statistics(r, &stats);
+    assert_true(stats.n_run_containers > 0);
+    assert_true(stats.n_bitset_containers > 0);
+    assert_true(stats.n_array_containers > 0);
+    roaring_bitmap_free(r);
+
+    // duplicates and unsorted input are handled by the general path
+    vals[1000] = vals[999];
+    vals[5000] = 3;
+    r = roaring_bitmap_of_ptr(n, vals);
+    roaring_bitmap_t *expected = roaring_bitmap_create();
+    for (size_t i = 0; i < n; i++) roaring_bitmap_add(expected, vals[i]);
+    assert_true(roaring_bitmap_equals(expected, r));
+    roaring_bitmap_free(expected);
+    roaring_bitmap_free(r);
+    free(vals);
+}
+
+static void check_contains_many(const roaring_bitmap_t *r, size_t n,
+                                const uint32_t *values) {
+    uint64_t *bits = (uint64_t *)malloc(((n + 63) / 64 + 1) * sizeof(uint64_t));
+    bits[(n + 63) / 64] = 0xDEADBEEF;  // must stay untouched
+    roaring_bitmap_contains_many(r, n, values, bits);
+    for (size_t i = 0; i < n; i++) {
+        const bool found = (bits[i / 64] >> (i % 64)) & 1;
+        assert_true(found == roaring_bitmap_contains(r, values[i]));
+    }
+    if (n % 64 != 0) assert_true((bits[n / 64] >> (n % 64)) == 0);
+    assert_true(bits[(n + 63) / 64] == 0xDEADBEEF);
+    free(bits);
+}
+
+DEFINE_TEST(test_contains_many) {
+    roaring_bitmap_t *r = roaring_bitmap_create();
+    for (uint32_t v = 0; v < 2000000; v += 37) roaring_bitmap_add(r, v);
+    roaring_bitmap_add_range(r, 300000, 500000);
+    for (uint32_t v = 700000; v < 770000; v += 2) roaring_bitmap_add(r, v);
+    roaring_bitmap_run_optimize(r);
+    roaring_bitmap_set_copy_on_write(r, true);
+    roaring_bitmap_t *clone = roaring_bitmap_copy(r);  // shared containers
+
+    enum { N = 20000 };
+    uint32_t *values = (uint32_t *)malloc(N * sizeof(uint32_t));
+    uint32_t x = 7;
+    for (size_t i = 0; i < N; i++) {
+        x = x * 1103515245 + 12345;
+        values[i] = x % 2100000;
+    }
+    // unsorted: large enough to be grouped by key, and small
+    check_contains_many(clone, N, values);
+    check_contains_many(clone, 100, values);
+    check_contains_many(clone, 0, values);
+    // sorted, with duplicates
+    for (size_t i = 0; i < N; i++) values[i] = (uint32_t)(i * 105);
+    values[10] = values[11];
+    check_contains_many(clone, N, values);
+    check_contains_many(clone, 77, values);
+    for (size_t i = 0; i < N; i++) values[i] = 290000 + (uint32_t)i * 11;
+    check_contains_many(clone, N, values);
+
+    free(values);
+    roaring_bitmap_free(clone);
+    roaring_bitmap_free(r);
+}
+
+
+// compares the indexed queries of 'r' with those of a plain copy of it
+static void check_cardinality_index(const roaring_bitmap_t *r) {
+    roaring_bitmap_t *plain = roaring_bitmap_copy(r);
+    roaring_bitmap_set_cardinality_index(plain, false);
+    const uint64_t card = roaring_bitmap_get_cardinality(plain);
+    assert_int_equal(roaring_bitmap_get_cardinality(r), card);
+    uint32_t x = 17;
+    for (int i = 0; i < 2000; i++) {
+        x = x * 1103515245 + 12345;
+        const uint32_t v = x % 4000000;
+        assert_int_equal(roaring_bitmap_rank(r, v),
+                         roaring_bitmap_rank(plain, v));
+        const uint32_t v2 = v + x % 300000;
+        assert_int_equal(roaring_bitmap_range_cardinality(r, v, v2),
+                         roaring_bitmap_range_cardinality(plain, v, v2));
+        if (card == 0) continue;
+        const uint32_t rank = (uint32_t)(x % (card + 10));
+        uint32_t e1 = 0, e2 = 0;
+        assert_true(roaring_bitmap_select(r, rank, &e1) ==
+                    roaring_bitmap_select(plain, rank, &e2));
+        assert_int_equal(e1, e2);
+        if (i % 50 == 0) {
+            const size_t len = 1 + x % 70000;
+            uint32_t *a1 = (uint32_t *)malloc(len * sizeof(uint32_t));
+            uint32_t *a2 = (uint32_t *)malloc(len * sizeof(uint32_t));
+            const bool ok1 = roaring_bitmap_range_uint32_array(r, rank, len, a1);
+            const bool ok2 =
+                roaring_bitmap_range_uint32_array(plain, rank, len, a2);
+            assert_true(ok1 == ok2);
+            if (ok1 && rank < card) {
+                const size_t n = (card - rank < len) ? card - rank : len;
+                assert_true(memcmp(a1, a2, n * sizeof(uint32_t)) == 0);
+            }
+            free(a1);
+            free(a2);
+        }
+    }
+    roaring_bitmap_free(plain);
+}
+
+DEFINE_TEST(test_cardinality_index) {
+    roaring_bitmap_t *r = roaring_bitmap_create();
+    roaring_bitmap_set_cardinality_index(r, true);
+    assert_true(roaring_bitmap_get_cardinality_index(r));
+    check_cardinality_index(r);  // empty
+    for (uint32_t v = 0; v < 3000000; v += 61) roaring_bitmap_add(r, v);
+    roaring_bitmap_add_range(r, 400000, 900000);
+    for (uint32_t v = 1200000; v < 1400000; v += 3) roaring_bitmap_add(r, v);
+    roaring_bitmap_run_optimize(r);
+    check_cardinality_index(r);
+
+    // values added to or removed from existing containers adjust the index
+    roaring_bitmap_add(r, 1200001);
+    assert_true(roaring_bitmap_add_checked(r, 62));
+    roaring_bitmap_remove(r, 1200003);
+    assert_false(roaring_bitmap_remove_checked(r, 1200004));
+    roaring_bitmap_remove(r, 500000);
+    assert_non_null(r->high_low_container.card_index);
+    check_cardinality_index(r);
+
+    // other modifications must drop it
+    roaring_bitmap_add(r, 3500000);
+    check_cardinality_index(r);
+    roaring_bitmap_remove_range(r, 600000, 700000);
+    check_cardinality_index(r);
+    roaring_bitmap_remove(r, 0);
+    check_cardinality_index(r);
+    roaring_bitmap_t *other = roaring_bitmap_from_range(100000, 2500000, 5);
+    roaring_bitmap_and_inplace(r, other);
+    check_cardinality_index(r);
+    roaring_bitmap_xor_inplace(r, other);
+    check_cardinality_index(r);
+    roaring_bitmap_flip_inplace(r, 50000, 1000000);
+    check_cardinality_index(r);
+
+    // frozen views always carry an index
+    const size_t num_bytes = roaring_bitmap_frozen_size_in_bytes(r);
+    char *buf = (char *)roaring_bitmap_aligned_malloc(32, num_bytes);
+    roaring_bitmap_frozen_serialize(r, buf);
+    const roaring_bitmap_t *view = roaring_bitmap_frozen_view(buf, num_bytes);
+    assert_non_null(view);
+    assert_true(roaring_bitmap_get_cardinality_index(view));
+    check_cardinality_index(view);
+    // which lives in the buffer and cannot be dropped
+    roaring_bitmap_set_cardinality_index((roaring_bitmap_t *)view, false);
+    assert_true(roaring_bitmap_get_cardinality_index(view));
+    check_cardinality_index(view);
+    roaring_bitmap_free(view);
+    roaring_bitmap_aligned_free(buf);
+
+    roaring_bitmap_set_cardinality_index(r, false);
+    assert_false(roaring_bitmap_get_cardinality_index(r));
+    check_cardinality_index(r);
+    roaring_bitmap_free(other);
+    roaring_bitmap_free(r);
+}
+
+// the cached total of 'r' must have been kept, and be right
+static void check_cached_cardinality(const roaring_bitmap_t *r) {
+    assert_true(r->high_low_container.cardinality != UINT64_MAX);
+    roaring_bitmap_t *plain = roaring_bitmap_copy(r);
+    assert_int_equal(r->high_low_container.cardinality,
+                     roaring_bitmap_get_cardinality(plain));
+    roaring_bitmap_free(plain);
+}
+
+DEFINE_TEST(test_cached_cardinality) {
+    roaring_bitmap_t *r = roaring_bitmap_from_range(0, 1000000, 3);
+    roaring_bitmap_set_cardinality_index(r, true);
+    uint64_t card = roaring_bitmap_get_cardinality(r);
+    assert_int_equal(card, 333334);
+    // the checked variants keep the cached total up to date
+    assert_true(roaring_bitmap_add_checked(r, 1));
+    assert_false(roaring_bitmap_add_checked(r, 3));
+    assert_true(roaring_bitmap_add_checked(r, 5000000));
+    assert_true(roaring_bitmap_remove_checked(r, 0));
+    assert_false(roaring_bitmap_remove_checked(r, 2));
+    card += 1;
+    assert_int_equal(r->high_low_container.cardinality, card);
+    assert_int_equal(roaring_bitmap_get_cardinality(r), card);
+    // and so do the plain, bulk and many variants
+    roaring_bitmap_add(r, 7);
+    roaring_bitmap_add(r, 9);
+    roaring_bitmap_remove(r, 6);
+    roaring_bitmap_remove(r, 8);
+    assert_int_equal(r->high_low_container.cardinality, card);
+    check_cached_cardinality(r);
+    roaring_bulk_context_t context = {0};
+    for (uint32_t v = 2000000; v < 2100000; v += 7) {
+        roaring_bitmap_add_bulk(r, &context, v);
+    }
+    check_cached_cardinality(r);
+    uint32_t vals[1000];
+    for (uint32_t i = 0; i < 1000; i++) vals[i] = 6000000 + i * i;  // sorted
+    roaring_bitmap_add_many(r, 1000, vals);
+    check_cached_cardinality(r);
+    for (uint32_t i = 0; i < 1000; i++) vals[i] = (i * 7919) % 3000000;
+    roaring_bitmap_add_many(r, 1000, vals);
+    check_cached_cardinality(r);
+    roaring_bitmap_remove_many(r, 1000, vals);
+    check_cached_cardinality(r);
+    // as well as the inplace operations
+    roaring_bitmap_t *other = roaring_bitmap_from_range(500000, 8000000, 5);
+    roaring_bitmap_add_range(other, 9000000, 9100000);
+    roaring_bitmap_run_optimize(other);
+    roaring_bitmap_t *sparse = roaring_bitmap_from_range(0, 9500000, 11);
+    roaring_bitmap_or_inplace(r, other);
+    check_cached_cardinality(r);
+    roaring_bitmap_andnot_inplace(r, sparse);
+    check_cached_cardinality(r);
+    roaring_bitmap_xor_inplace(r, sparse);
+    check_cached_cardinality(r);
+    roaring_bitmap_and_inplace(r, other);
+    check_cached_cardinality(r);
+    assert_true(roaring_bitmap_get_cardinality(r) > 0);
+    // starting from an empty bitmap
+    roaring_bitmap_t *empty = roaring_bitmap_create();
+    roaring_bitmap_set_cardinality_index(empty, true);
+    assert_int_equal(roaring_bitmap_get_cardinality(empty), 0);
+    roaring_bitmap_or_inplace(empty, other);
+    check_cached_cardinality(empty);
+    roaring_bitmap_free(empty);
+    roaring_bitmap_free(sparse);
+    roaring_bitmap_free(other);
+    // the other modifications drop it
+    card = roaring_bitmap_get_cardinality(r);
+    roaring_bitmap_remove_range(r, 0, 3000000);
+    assert_int_equal(r->high_low_container.cardinality, UINT64_MAX);
+    assert_true(roaring_bitmap_get_cardinality(r) < card);
+    roaring_bitmap_clear(r);
+    assert_int_equal(roaring_bitmap_get_cardinality(r), 0);
+    roaring_bitmap_free(r);
+}
+
+// checks roaring_bitmap_add_offset against adding the values one by one
+static void check_add_offset(const roaring_bitmap_t *r, int64_t offset) {
+    roaring_bitmap_t *expected = roaring_bitmap_create();
+    roaring_uint32_iterator_t *it = roaring_create_iterator(r);
+    for (; it->has_value; roaring_advance_uint32_iterator(it)) {
+        const int64_t v = (int64_t)it->current_value + offset;
+        if (v >= 0 && v <= UINT32_MAX) roaring_bitmap_add(expected, v);
+    }
+    roaring_free_uint32_iterator(it);
+    roaring_bitmap_t *shifted = roaring_bitmap_add_offset(r, offset);
+    assert_true(roaring_bitmap_equals(shifted, expected));
+    roaring_bitmap_free(shifted);
+    roaring_bitmap_free(expected);
+}
+
+DEFINE_TEST(test_add_offset) {
+    roaring_bitmap_t *r = roaring_bitmap_create();
+    check_add_offset(r, 12345);
+    for (uint32_t v = 0; v < 200000; v += 7) roaring_bitmap_add(r, v);  // arrays
+    for (uint32_t v = 300000; v < 500000; v += 3) roaring_bitmap_add(r, v);  // bitsets
+    roaring_bitmap_add_range(r, 700000, 800000);
+    roaring_bitmap_add_range(r, 810000, 810100);
+    roaring_bitmap_add_range(r, UINT32_MAX - 100000, UINT64_C(0x100000000));
+    roaring_bitmap_add(r, 0x1FFFF);
+    roaring_bitmap_run_optimize(r);
+    const int64_t offsets[] = {0, 1, 63, 64, 100, 65535, 65536, 65537, 131072,
+                               1000003, -1, -64, -65536, -65537, -1000003,
+                               (int64_t)UINT32_MAX, -(int64_t)UINT32_MAX,
+                               INT64_C(1) << 32, -(INT64_C(1) << 32),
+                               INT64_C(1) << 40, -(INT64_C(1) << 40),
+                               INT64_MIN};
+    for (size_t i = 0; i < sizeof(offsets) / sizeof(offsets[0]); i++) {
+        check_add_offset(r, offsets[i]);
+    }
+    roaring_bitmap_set_copy_on_write(r, true);
+    check_add_offset(r, 65536 * 3);
+    check_add_offset(r, -65536 * 3);
+    roaring_bitmap_free(r);
+}
+
+typedef roaring_bitmap_t *(*binary_op_t)(const roaring_bitmap_t *,
+                                          const roaring_bitmap_t *);
+
+// checks the range-restricted operations against the full ones followed by
+// a removal of the values outside the range
+static void check_in_range(const roaring_bitmap_t *r1,
+                           const roaring_bitmap_t *r2, uint64_t start,
+                           uint64_t end) {
+    const binary_op_t full_ops[] = {roaring_bitmap_and, roaring_bitmap_or,
+                                    roaring_bitmap_xor, roaring_bitmap_andnot};
+    roaring_bitmap_t *(*const range_ops[])(
+        const roaring_bitmap_t *, const roaring_bitmap_t *, uint64_t,
+        uint64_t) = {roaring_bitmap_and_in_range, roaring_bitmap_or_in_range,
+                     roaring_bitmap_xor_in_range,
+                     roaring_bitmap_andnot_in_range};
+    uint64_t (*const card_ops[])(const roaring_bitmap_t *,
+                                 const roaring_bitmap_t *, uint64_t,
+                                 uint64_t) = {
+        roaring_bitmap_and_cardinality_in_range,
+        roaring_bitmap_or_cardinality_in_range,
+        roaring_bitmap_xor_cardinality_in_range,
+        roaring_bitmap_andnot_cardinality_in_range};
+    for (int op = 0; op < 4; op++) {
+        roaring_bitmap_t *expected = full_ops[op](r1, r2);
+        roaring_bitmap_remove_range(expected, 0, start);
+        if (end < UINT64_C(0x100000000)) {
+            roaring_bitmap_remove_range(expected, end, UINT64_C(0x100000000));
+        }
+        if (start >= end) roaring_bitmap_clear(expected);
+        roaring_bitmap_t *actual = range_ops[op](r1, r2, start, end);
+        assert_true(roaring_bitmap_equals(actual, expected));
+        assert_int_equal(card_ops[op](r1, r2, start, end),
+                         roaring_bitmap_get_cardinality(expected));
+        roaring_bitmap_free(actual);
+        roaring_bitmap_free(expected);
+    }
+}
+
+DEFINE_TEST(test_binary_ops_in_range) {
+    roaring_bitmap_t *r1 = roaring_bitmap_from_range(0, 2000000, 3);
+    roaring_bitmap_add_range(r1, 2500000, 2700000);
+    roaring_bitmap_add(r1, UINT32_MAX);
+    roaring_bitmap_t *r2 = roaring_bitmap_from_range(100000, 3000000, 5);
+    for (uint32_t v = 1000000; v < 1300000; v += 2) roaring_bitmap_add(r2, v);
+    roaring_bitmap_run_optimize(r1);
+    const uint64_t bounds[][2] = {
+        {0, UINT64_C(0x100000000)}, {0, 0}, {10, 5}, {1, 2},
+        {65535, 65537}, {65536, 131072}, {99999, 1234567},
+        {1100001, 2600003}, {2650000, 5000000}, {UINT32_MAX, UINT64_MAX},
+        {3000000, 4000000}};
+    for (size_t i = 0; i < sizeof(bounds) / sizeof(bounds[0]); i++) {
+        check_in_range(r1, r2, bounds[i][0], bounds[i][1]);
+        check_in_range(r2, r1, bounds[i][0], bounds[i][1]);
+    }
+    roaring_bitmap_free(r1);
+    roaring_bitmap_free(r2);
+}
+
+DEFINE_TEST(test_and_to_uint32_array) {
+    roaring_bitmap_t *r1 = roaring_bitmap_from_range(0, 3000000, 3);
+    roaring_bitmap_add_range(r1, 4000000, 4100000);
+    roaring_bitmap_t *r2 = roaring_bitmap_from_range(0, 5000000, 2);
+    for (uint32_t v = 500000; v < 700000; v++) roaring_bitmap_add(r2, v);
+    roaring_bitmap_run_optimize(r2);
+    roaring_bitmap_t *inter = roaring_bitmap_and(r1, r2);
+    const uint64_t card = roaring_bitmap_get_cardinality(inter);
+    uint32_t *expected = (uint32_t *)malloc(card * sizeof(uint32_t));
+    roaring_bitmap_to_uint32_array(inter, expected);
+    uint32_t *ans = (uint32_t *)malloc(card * sizeof(uint32_t));
+    const size_t offsets[] = {0, 1, 10921, 10922, 100000, 555555, card - 1,
+                              card, card + 7};
+    const size_t limits[] = {0, 1, 5, 10922, 70000, card};
+    for (size_t i = 0; i < sizeof(offsets) / sizeof(offsets[0]); i++) {
+        for (size_t j = 0; j < sizeof(limits) / sizeof(limits[0]); j++) {
+            const size_t offset = offsets[i], limit = limits[j];
+            const size_t n = roaring_bitmap_and_to_uint32_array(
+                r1, r2, offset, limit, ans);
+            const size_t want =
+                offset >= card ? 0
+                               : (card - offset < limit ? card - offset : limit);
+            assert_int_equal(n, want);
+            assert_true(memcmp(ans, expected + offset,
+                               n * sizeof(uint32_t)) == 0);
+        }
+    }
+    free(ans);
+    free(expected);
+    roaring_bitmap_free(inter);
+    roaring_bitmap_free(r1);
+    roaring_bitmap_free(r2);
+}
+
+DEFINE_TEST(test_intersection_iterator) {
+    roaring_bitmap_t *r1 = roaring_bitmap_from_range(0, 5000000, 3);
+    roaring_bitmap_t *r2 = roaring_bitmap_from_range(1000000, 9000000, 5);
+    roaring_bitmap_t *r3 = roaring_bitmap_create();
+    roaring_bitmap_add_range(r3, 2000000, 2500000);
+    for (uint32_t v = 3000000; v < 7000000; v += 2) roaring_bitmap_add(r3, v);
+    roaring_bitmap_add(r3, UINT32_MAX);
+    roaring_bitmap_run_optimize(r3);
+    const roaring_bitmap_t *inputs[] = {r1, r2, r3};
+
+    roaring_bitmap_t *expected = roaring_bitmap_and(r1, r2);
+    roaring_bitmap_and_inplace(expected, r3);
+    roaring_intersection_iterator_t *it =
+        roaring_create_intersection_iterator(3, inputs);
+    roaring_uint32_iterator_t *eit = roaring_create_iterator(expected);
+    for (; eit->has_value; roaring_advance_uint32_iterator(eit)) {
+        assert_true(it->has_value);
+        assert_int_equal(it->current_value, eit->current_value);
+        roaring_advance_intersection_iterator(it);
+    }
+    assert_false(it->has_value);
+
+    // jumps, including backward ones
+    const uint32_t targets[] = {4000000, 0, 2222222, 6999999, 2500000, 7000000};
+    for (size_t i = 0; i < sizeof(targets) / sizeof(targets[0]); i++) {
+        const bool found =
+            roaring_move_intersection_iterator_equalorlarger(it, targets[i]);
+        roaring_move_uint32_iterator_equalorlarger(eit, targets[i]);
+        assert_true(found == eit->has_value);
+        if (found) assert_int_equal(it->current_value, eit->current_value);
+    }
+
+    // batches
+    roaring_move_intersection_iterator_equalorlarger(it, 0);
+    const uint64_t card = roaring_bitmap_get_cardinality(expected);
+    uint32_t *all = (uint32_t *)malloc(card * sizeof(uint32_t));
+    roaring_bitmap_to_uint32_array(expected, all);
+    uint32_t buf[1000];
+    uint64_t total = 0;
+    uint32_t n;
+    roaring_intersection_iterator_t *copy =
+        roaring_copy_intersection_iterator(it);
+    while ((n = roaring_read_intersection_iterator(copy, buf, 1000)) > 0) {
+        assert_true(memcmp(buf, all + total, n * sizeof(uint32_t)) == 0);
+        total += n;
+    }
+    assert_int_equal(total, card);
+    assert_true(it->has_value);  // the copy is independent
+    free(all);
+    roaring_free_intersection_iterator(copy);
+    roaring_free_intersection_iterator(it);
+    roaring_free_uint32_iterator(eit);
+
+    // empty inputs
+    it = roaring_create_intersection_iterator(0, NULL);
+    assert_false(it->has_value);
+    roaring_free_intersection_iterator(it);
+    roaring_bitmap_t *empty = roaring_bitmap_create();
+    inputs[1] = empty;
+    it = roaring_create_intersection_iterator(3, inputs);
+    assert_false(it->has_value);
+    roaring_free_intersection_iterator(it);
+
+    roaring_bitmap_free(empty);
+    roaring_bitmap_free(expected);
+    roaring_bitmap_free(r1);
+    roaring_bitmap_free(r2);
+    roaring_bitmap_free(r3);
+}
+
+typedef struct batch_check_s {
+    const uint32_t *expected;
+    size_t seen;
+    size_t buf_size;
+    size_t calls;
+    size_t stop_after;  // calls
+} batch_check_t;
+
+static bool batch_check_fnc(const uint32_t *values, size_t count,
+                            void *param) {
+    batch_check_t *bc = (batch_check_t *)param;
+    assert_true(count > 0 && count <= bc->buf_size);
+    assert_true(memcmp(values, bc->expected + bc->seen,
+                       count * sizeof(uint32_t)) == 0);
+    bc->seen += count;
+    return ++bc->calls != bc->stop_after;
+}
+
+DEFINE_TEST(test_iterate_batch) {
+    roaring_bitmap_t *r = roaring_bitmap_from_range(0, 1000000, 7);
+    roaring_bitmap_add_range(r, 2000000, 2300000);
+    for (uint32_t v = 3000000; v < 3200000; v += 2) roaring_bitmap_add(r, v);
+    for (uint32_t v = 4000000; v < 4012000; v += 3) roaring_bitmap_add(r, v);
+    roaring_bitmap_run_optimize(r);
+    const uint64_t card = roaring_bitmap_get_cardinality(r);
+    uint32_t *all = (uint32_t *)malloc(card * sizeof(uint32_t));
+    roaring_bitmap_to_uint32_array(r, all);
+    // sizes that split containers, including within bitset words and runs
+    const size_t sizes[] = {1,     3,      63,     100,     1000,
+                            9363,  65536,  100000, 10000000};
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        batch_check_t bc = {all, 0, sizes[i], 0, 0};
+        assert_true(roaring_iterate_batch(r, batch_check_fnc, sizes[i], &bc));
+        assert_int_equal(bc.seen, card);
+        batch_check_t stop = {all, 0, sizes[i], 0, 1};
+        assert_false(roaring_iterate_batch(r, batch_check_fnc, sizes[i], &stop));
+        assert_int_equal(stop.calls, 1);
+    }
+    assert_false(roaring_iterate_batch(r, batch_check_fnc, 0, NULL));
+    roaring_bitmap_t *empty = roaring_bitmap_create();
+    assert_true(roaring_iterate_batch(empty, batch_check_fnc, 10, NULL));
+    roaring_bitmap_free(empty);
+    free(all);
+    roaring_bitmap_free(r);
+}
+
+typedef struct visit_check_s {
+    roaring_bitmap_t *rebuilt;
+    const char *buf;  // of a frozen view, if any
+    size_t buf_size;
+    int kinds[4];
+} visit_check_t;
+
+static bool visit_check_fnc(const roaring_container_view_t *view,
+                            void *param) {
+    visit_check_t *vc = (visit_check_t *)param;
+    const uint32_t base = (uint32_t)view->key << 16;
+    const void *storage = NULL;
+    int32_t card = 0;
+    vc->kinds[view->kind]++;
+    switch (view->kind) {
+        case ROARING_CONTAINER_VIEW_ARRAY:
+            assert_true(view->words == NULL && view->runs == NULL);
+            for (int32_t i = 0; i < view->length; i++) {
+                roaring_bitmap_add(vc->rebuilt, base | view->array[i]);
+            }
+            card = view->length;
+            storage = view->array;
+            break;
+        case ROARING_CONTAINER_VIEW_BITSET:
+            assert_int_equal(view->length, 1024);
+            for (uint32_t v = 0; v < 65536; v++) {
+                if ((view->words[v / 64] >> (v % 64)) & 1) {
+                    roaring_bitmap_add(vc->rebuilt, base | v);
+                    card++;
+                }
+            }
+            storage = view->words;
+            break;
+        case ROARING_CONTAINER_VIEW_RUN:
+            for (int32_t i = 0; i < view->length; i++) {
+                const uint64_t start = base | view->runs[i].value;
+                roaring_bitmap_add_range(vc->rebuilt, start,
+                                         start + view->runs[i].length + 1);
+                card += view->runs[i].length + 1;
+            }
+            storage = view->runs;
+            break;
+        default:
+            fail();
+    }
+    assert_int_equal(card, view->cardinality);
+    if (vc->buf != NULL) {  // zero-copy
+        assert_true((const char *)storage >= vc->buf &&
+                    (const char *)storage < vc->buf + vc->buf_size);
+    }
+    return true;
+}
+
+DEFINE_TEST(test_visit_containers) {
+    roaring_bitmap_t *r = roaring_bitmap_from_range(0, 300000, 11);
+    for (uint32_t v = 500000; v < 600000; v += 2) roaring_bitmap_add(r, v);
+    roaring_bitmap_add_range(r, 1000000, 1200000);
+    roaring_bitmap_run_optimize(r);
+
+    visit_check_t vc = {roaring_bitmap_create(), NULL, 0, {0, 0, 0, 0}};
+    assert_true(roaring_visit_containers(r, visit_check_fnc, &vc));
+    assert_true(roaring_bitmap_equals(r, vc.rebuilt));
+    assert_true(vc.kinds[ROARING_CONTAINER_VIEW_ARRAY] > 0);
+    assert_true(vc.kinds[ROARING_CONTAINER_VIEW_BITSET] > 0);
+    assert_true(vc.kinds[ROARING_CONTAINER_VIEW_RUN] > 0);
+    roaring_bitmap_free(vc.rebuilt);
+
+    const size_t num_bytes = roaring_bitmap_frozen_size_in_bytes(r);
+    char *buf = (char *)roaring_bitmap_aligned_malloc(32, num_bytes);
+    roaring_bitmap_frozen_serialize(r, buf);
+    const roaring_bitmap_t *view = roaring_bitmap_frozen_view(buf, num_bytes);
+    visit_check_t fvc = {roaring_bitmap_create(), buf, num_bytes, {0, 0, 0, 0}};
+    assert_true(roaring_visit_containers(view, visit_check_fnc, &fvc));
+    assert_true(roaring_bitmap_equals(r, fvc.rebuilt));
+    roaring_bitmap_free(fvc.rebuilt);
+    roaring_bitmap_free(view);
+    roaring_bitmap_aligned_free(buf);
+    roaring_bitmap_free(r);
+}
+
+static int64_t hooked_live_allocations;
+static int64_t hooked_calls;
+static int64_t hooked_aligned_mallocs;
+
+static void *counting_malloc(size_t size) {
+    hooked_live_allocations++;
+    hooked_calls++;
+    return malloc(size);
+}
+
+static void *counting_realloc(void *p, size_t new_size) {
+    if (p == NULL) hooked_live_allocations++;
+    hooked_calls++;
+    return realloc(p, new_size);
+}
+
+static void *counting_calloc(size_t n_elements, size_t element_size) {
+    hooked_live_allocations++;
+    hooked_calls++;
+    return calloc(n_elements, element_size);
+}
+
+static void counting_free(void *p) {
+    if (p != NULL) hooked_live_allocations--;
+    hooked_calls++;
+    free(p);
+}
+
+static void *counting_aligned_malloc(size_t alignment, size_t size) {
+    hooked_live_allocations++;
+    hooked_calls++;
+    hooked_aligned_mallocs++;
+    return roaring_bitmap_aligned_malloc(alignment, size);
+}
+
+static void counting_aligned_free(void *p) {
+    if (p != NULL) hooked_live_allocations--;
+    hooked_calls++;
+    roaring_bitmap_aligned_free(p);
+}
+
+static void default_aligned_free_hook(void *p) {
+    roaring_bitmap_aligned_free(p);
+}
+
+static void *default_aligned_malloc_hook(size_t alignment, size_t size) {
+    return roaring_bitmap_aligned_malloc(alignment, size);
+}
+
+DEFINE_TEST(test_memory_hook) {
+    roaring_memory_t counting = {counting_malloc,  counting_realloc,
+                                 counting_calloc,  counting_free,
+                                 counting_aligned_malloc,
+                                 counting_aligned_free};
+    hooked_live_allocations = 0;
+    hooked_calls = 0;
+    roaring_init_memory_hook(counting);
+
+    roaring_bitmap_t *r1 = roaring_bitmap_from_range(0, 200000, 3);
+    roaring_bitmap_t *r2 = roaring_bitmap_create();
+    for (uint32_t v = 100000; v < 400000; v += 7) roaring_bitmap_add(r2, v);
+    roaring_bitmap_add_range(r2, 1000000, 1100000);
+    roaring_bitmap_run_optimize(r2);
+    assert_true(hooked_live_allocations > 0);
+
+    roaring_bitmap_t *ored = roaring_bitmap_or(r1, r2);
+    roaring_bitmap_t *xored = roaring_bitmap_xor(r1, r2);
+    roaring_bitmap_and_inplace(ored, xored);
+    const roaring_bitmap_t *all[] = {r1, r2, xored};
+    roaring_bitmap_t *heap = roaring_bitmap_or_many_heap(3, all);
+
+    roaring_uint32_iterator_t *it = roaring_create_iterator(heap);
+    roaring_free_uint32_iterator(it);
+
+    size_t size = roaring_bitmap_frozen_size_in_bytes(r2);
+    char *buf = (char *)roaring_aligned_malloc(32, size);
+    roaring_bitmap_frozen_serialize(r2, buf);
+    const roaring_bitmap_t *frozen = roaring_bitmap_frozen_view(buf, size);
+    assert_true(frozen != NULL);
+    assert_true(roaring_bitmap_equals(frozen, r2));
+    roaring_bitmap_free(frozen);
+    roaring_aligned_free(buf);
+
+    roaring_bitmap_free(heap);
+    roaring_bitmap_free(xored);
+    roaring_bitmap_free(ored);
+    roaring_bitmap_free(r2);
+    roaring_bitmap_free(r1);
+    assert_true(hooked_calls > 0);
+    assert_int_equal(hooked_live_allocations, 0);
+
+    roaring_memory_t defaults = {malloc, realloc, calloc, free,
+                                 default_aligned_malloc_hook,
+                                 default_aligned_free_hook};
+    roaring_init_memory_hook(defaults);
+}
+
+// fails the failing_malloc_countdown-th allocation, once
+static int failing_malloc_countdown;
+
+static void *failing_malloc(size_t size) {
+    if (failing_malloc_countdown > 0 && --failing_malloc_countdown == 0) {
+        return NULL;
+    }
+    return malloc(size);
+}
+
+DEFINE_TEST(test_add_many_sorted_out_of_memory) {
+    enum { N = 3000 };
+    uint32_t vals[N];
+    for (uint32_t i = 0; i < N; i++) vals[i] = i * 131;  // 6 array containers
+    roaring_bitmap_t *expected = roaring_bitmap_of_ptr(N, vals);
+    roaring_memory_t failing = {failing_malloc, realloc, calloc, free,
+                                default_aligned_malloc_hook,
+                                default_aligned_free_hook};
+    roaring_memory_t defaults = {malloc, realloc, calloc, free,
+                                 default_aligned_malloc_hook,
+                                 default_aligned_free_hook};
+    for (int fail_at = 1; fail_at <= 12; fail_at++) {
+        roaring_bitmap_t *r = roaring_bitmap_create();
+        roaring_bitmap_set_cardinality_index(r, true);
+        roaring_init_memory_hook(failing);
+        failing_malloc_countdown = fail_at;
+        // the values left over by a failed container are added one by one
+        roaring_bitmap_add_many(r, N, vals);
+        roaring_init_memory_hook(defaults);
+        assert_true(roaring_bitmap_equals(r, expected));
+        assert_true(roaring_bitmap_get_cardinality(r) == N);
+        roaring_bitmap_free(r);
+    }
+    roaring_bitmap_free(expected);
+}
+
+DEFINE_TEST(test_arena) {
+    roaring_bitmap_t *long_lived = roaring_bitmap_from_range(0, 100000, 5);
+    roaring_bitmap_t *r1 = roaring_bitmap_from_range(0, 300000, 3);
+    roaring_bitmap_t *r2 = roaring_bitmap_from_range(50000, 250000, 2);
+    roaring_bitmap_t *expected = roaring_bitmap_xor(r1, r2);
+    roaring_bitmap_or_inplace(expected, long_lived);
+
+    // small enough that the arena has to grow, repeatedly
+    size_t buf_size = 4096;
+    char *buf = (char *)malloc(buf_size);
+    roaring_arena_t arena;
+    roaring_arena_init(&arena, buf, buf_size);
+    for (int round = 0; round < 3; round++) {
+        roaring_bitmap_t *outside = roaring_bitmap_copy(expected);
+        assert_true(roaring_set_thread_arena(&arena) == NULL);
+        roaring_bitmap_t *a = roaring_bitmap_xor(r1, r2);
+        const char *keys = (const char *)a->high_low_container.keys;
+        assert_true(keys >= buf && keys < buf + buf_size);
+        roaring_bitmap_t *b = roaring_bitmap_create();
+        for (uint32_t v = 0; v < 100000; v += 5) {  // reallocates in place
+            roaring_bitmap_add(b, v);
+        }
+        roaring_bitmap_t *c = roaring_bitmap_or(a, b);
+        roaring_bitmap_free(b);  // a no-op
+        roaring_bitmap_run_optimize(c);
+        roaring_bitmap_t *copy = roaring_bitmap_copy(c);
+        roaring_bitmap_free(c);
+
+        roaring_set_thread_arena(NULL);
+        roaring_bitmap_t *result = roaring_bitmap_copy(copy);
+        roaring_set_thread_arena(&arena);
+        // allocations from outside the arena may still be released
+        roaring_bitmap_remove_range(outside, 0, 1 << 16);
+        roaring_bitmap_free(outside);
+        assert_true(roaring_set_thread_arena(NULL) == &arena);
+
+        assert_true(roaring_bitmap_equals(copy, expected));
+        roaring_arena_reset(&arena);
+        assert_true(roaring_bitmap_equals(result, expected));
+        roaring_bitmap_free(result);
+    }
+    free(buf);
+
+    // a copy-on-write result is copied out with copy-on-write disabled
+    roaring_arena_t cow_arena;
+    roaring_arena_init(&cow_arena, NULL, 0);
+    roaring_set_thread_arena(&cow_arena);
+    roaring_bitmap_t *cow = roaring_bitmap_xor(r1, r2);
+    roaring_bitmap_set_copy_on_write(cow, true);
+    roaring_bitmap_or_inplace(cow, long_lived);
+    roaring_set_thread_arena(NULL);
+    roaring_bitmap_set_copy_on_write(cow, false);
+    roaring_bitmap_t *kept = roaring_bitmap_copy(cow);
+    roaring_bitmap_set_copy_on_write(kept, true);
+    roaring_arena_reset(&cow_arena);
+    assert_true(roaring_bitmap_equals(kept, expected));
+    roaring_bitmap_free(kept);
+
+    // copy-on-write inputs from outside the arena, whose containers may be
+    // shared already, are cloned into its results, on this thread only
+    roaring_bitmap_t *shared = roaring_bitmap_copy(long_lived);
+    roaring_bitmap_set_copy_on_write(shared, true);
+    roaring_bitmap_t *sibling = roaring_bitmap_copy(shared);  // now shared
+    roaring_bitmap_t *other = roaring_bitmap_from_range(0, 50000, 7);
+    roaring_bitmap_t *many = roaring_bitmap_from_range(0, 9000u << 16, 1 << 16);
+    roaring_bitmap_set_copy_on_write(many, true);
+    roaring_arena_t share_arena;
+    roaring_arena_init(&share_arena, NULL, 0);
+    roaring_set_thread_arena(&share_arena);
+    roaring_bitmap_t *both = roaring_bitmap_or(shared, other);
+    roaring_bitmap_t *copied = roaring_bitmap_copy(shared);
+    roaring_bitmap_t *par = roaring_bitmap_or_parallel(many, shared, 4);
+    assert_int_equal(roaring_bitmap_get_cardinality(both),
+                     roaring_bitmap_or_cardinality(long_lived, other));
+    assert_true(roaring_bitmap_equals(copied, long_lived));
+    assert_int_equal(roaring_bitmap_get_cardinality(par),
+                     roaring_bitmap_or_cardinality(many, long_lived));
+    roaring_arena_reset(&share_arena);
+    roaring_set_thread_arena(NULL);
+    assert_true(roaring_bitmap_equals(shared, long_lived));
+    assert_int_equal(roaring_bitmap_get_cardinality(many), 9000);
+    roaring_bitmap_free(many);
+    roaring_bitmap_free(other);
+    roaring_bitmap_free(sibling);
+    roaring_bitmap_free(shared);
+
+    // a growing arena without buffer, nested in another one
+    roaring_arena_t outer, inner;
+    roaring_arena_init(&outer, NULL, 0);
+    roaring_arena_init(&inner, NULL, 0);
+    roaring_set_thread_arena(&outer);
+    roaring_bitmap_t *x = roaring_bitmap_or(r1, r2);
+    assert_true(roaring_set_thread_arena(&inner) == &outer);
+    roaring_bitmap_t *y = roaring_bitmap_and(r1, r2);
+    assert_int_equal(roaring_bitmap_get_cardinality(y), 33333);
+    roaring_arena_reset(&inner);
+    assert_true(roaring_set_thread_arena(&outer) == &inner);
+    assert_int_equal(roaring_bitmap_get_cardinality(x), 166667);
+    roaring_set_thread_arena(NULL);
+    roaring_arena_reset(&outer);
+
+    roaring_bitmap_free(expected);
+    roaring_bitmap_free(r2);
+    roaring_bitmap_free(r1);
+    roaring_bitmap_free(long_lived);
+}
+
+DEFINE_TEST(test_container_pool) {
+    roaring_memory_t counting = {counting_malloc,  counting_realloc,
+                                 counting_calloc,  counting_free,
+                                 counting_aligned_malloc,
+                                 counting_aligned_free};
+    roaring_memory_t defaults = {malloc, realloc, calloc, free,
+                                 default_aligned_malloc_hook,
+                                 default_aligned_free_hook};
+    roaring_bitmap_t *dense = roaring_bitmap_from_range(0, 1 << 20, 3);
+    roaring_bitmap_t *sparse = roaring_bitmap_from_range(0, 1 << 20, 1000);
+    roaring_bitmap_t *runs = roaring_bitmap_from_range(1 << 19, 1 << 21, 1);
+    roaring_bitmap_t *expected = roaring_bitmap_or(dense, sparse);
+    roaring_bitmap_xor_inplace(expected, runs);
+    uint64_t expected_card = roaring_bitmap_get_cardinality(expected);
+
+    hooked_live_allocations = 0;
+    hooked_aligned_mallocs = 0;
+    roaring_init_memory_hook(counting);
+    roaring_set_container_pool_limit(1 << 20);
+    int64_t aligned_mallocs[3];
+    for (int round = 0; round < 3; round++) {
+        int64_t before = hooked_aligned_mallocs;
+        roaring_bitmap_t *a = roaring_bitmap_lazy_or(dense, sparse, true);
+        roaring_bitmap_repair_after_lazy(a);
+        roaring_bitmap_t *b = roaring_bitmap_xor(a, runs);
+        roaring_bitmap_t *c = roaring_bitmap_copy(sparse);
+        for (uint32_t v = 1; v < (1 << 20); v += 999) {  // grows the arrays
+            roaring_bitmap_add(c, v);
+        }
+        roaring_bitmap_andnot_inplace(c, sparse);
+        assert_true(roaring_bitmap_equals(b, expected));
+        assert_int_equal(roaring_bitmap_get_cardinality(b), expected_card);
+        roaring_bitmap_free(c);
+        roaring_bitmap_free(b);
+        roaring_bitmap_free(a);
+        aligned_mallocs[round] = hooked_aligned_mallocs - before;
+        assert_true(roaring_container_pool_size_in_bytes() > 0);
+        assert_true(roaring_container_pool_size_in_bytes() <= (1 << 20));
+    }
+    assert_true(aligned_mallocs[0] > 0);
+    assert_int_equal(aligned_mallocs[1], 0);  // bitsets come from the pool
+    assert_int_equal(aligned_mallocs[2], 0);
+
+    roaring_set_container_pool_limit(8192);
+    assert_true(roaring_container_pool_size_in_bytes() <= 8192);
+    roaring_flush_container_pool();
+    assert_int_equal(roaring_container_pool_size_in_bytes(), 0);
+    roaring_set_container_pool_limit(0);
+    assert_int_equal(hooked_live_allocations, 0);
+    roaring_init_memory_hook(defaults);
+
+    roaring_bitmap_free(expected);
+    roaring_bitmap_free(runs);
+    roaring_bitmap_free(sparse);
+    roaring_bitmap_free(dense);
+}
+
+DEFINE_TEST(test_versioned_bitmap) {
+    roaring_bitmap_t *r = roaring_bitmap_from_range(0, 1000000, 7);
+    roaring_bitmap_t *expected = roaring_bitmap_copy(r);
+    roaring_versioned_bitmap_t *v = roaring_versioned_bitmap_create(r, 4);
+    assert_true(v != NULL);
+    roaring_bitmap_t *working = roaring_versioned_bitmap_working(v);
+    assert_true(working == r);
+
+    const roaring_bitmap_t *first = roaring_versioned_bitmap_pin(v, 0);
+    assert_true(roaring_bitmap_equals(first, expected));
+    roaring_bitmap_add(working, 1);
+    roaring_bitmap_remove(working, 7);
+    assert_true(roaring_bitmap_equals(first, expected));  // not published
+    assert_true(roaring_versioned_bitmap_publish(v));
+    assert_true(roaring_bitmap_equals(first, expected));  // still pinned
+    assert_int_equal(roaring_versioned_bitmap_retired_count(v), 1);
+
+    const roaring_bitmap_t *second = roaring_versioned_bitmap_pin(v, 1);
+    assert_true(roaring_bitmap_contains(second, 1));
+    assert_false(roaring_bitmap_contains(second, 7));
+    assert_true(roaring_bitmap_contains(second, 14));
+    roaring_versioned_bitmap_unpin(v, 0);
+
+    roaring_bitmap_set_cardinality_index(working, true);
+    roaring_bitmap_add_range(working, 2000000, 3000000);
+    assert_true(roaring_versioned_bitmap_publish(v));
+    // the first version is freed, the second is still held by reader 1
+    assert_int_equal(roaring_versioned_bitmap_retired_count(v), 1);
+    assert_int_equal(roaring_bitmap_get_cardinality(second),
+                     roaring_bitmap_get_cardinality(expected));
+
+    const roaring_bitmap_t *third = roaring_versioned_bitmap_pin(v, 2);
+    assert_true(roaring_bitmap_get_cardinality_index(third));
+    // readers may copy a version: its containers are cloned, not shared
+    assert_false(roaring_bitmap_get_copy_on_write(third));
+    roaring_bitmap_t *copied = roaring_bitmap_copy(third);
+    roaring_bitmap_t *unioned = roaring_bitmap_or(third, expected);
+    assert_true(roaring_bitmap_equals(copied, third));
+    assert_int_equal(roaring_bitmap_get_cardinality(unioned),
+                     roaring_bitmap_get_cardinality(third) + 1);  // 7
+    roaring_bitmap_free(unioned);
+    roaring_bitmap_free(copied);
+    assert_int_equal(roaring_bitmap_rank(third, 2000000),
+                     roaring_bitmap_get_cardinality(expected) + 1);
+    roaring_versioned_bitmap_unpin(v, 1);
+    roaring_versioned_bitmap_unpin(v, 2);
+    assert_true(roaring_versioned_bitmap_publish(v));
+    assert_int_equal(roaring_versioned_bitmap_retired_count(v), 0);
+
+    roaring_versioned_bitmap_free(v);
+    roaring_bitmap_free(expected);
+}
 
 int main() {
     tellmeall();
@@ -4276,6 +5649,28 @@ int main() {
         cmocka_unit_test(test_range_cardinality),
         cmocka_unit_test(test_frozen_serialization),
         cmocka_unit_test(test_frozen_serialization_max_containers),
+        cmocka_unit_test(test_and_many),
+        cmocka_unit_test(test_or_many),
+        cmocka_unit_test(test_xor_many),
+        cmocka_unit_test(test_expr),
+        cmocka_unit_test(test_parallel_ops),
+        cmocka_unit_test(test_threshold_many),
+        cmocka_unit_test(test_bulk),
+        cmocka_unit_test(test_add_many_sorted),
+        cmocka_unit_test(test_contains_many),
+        cmocka_unit_test(test_cardinality_index),
+        cmocka_unit_test(test_cached_cardinality),
+        cmocka_unit_test(test_add_offset),
+        cmocka_unit_test(test_binary_ops_in_range),
+        cmocka_unit_test(test_and_to_uint32_array),
+        cmocka_unit_test(test_intersection_iterator),
+        cmocka_unit_test(test_iterate_batch),
+        cmocka_unit_test(test_visit_containers),
+        cmocka_unit_test(test_memory_hook),
+        cmocka_unit_test(test_add_many_sorted_out_of_memory),
+        cmocka_unit_test(test_arena),
+        cmocka_unit_test(test_container_pool),
+        cmocka_unit_test(test_versioned_bitmap),
     };
 
     return cmocka_run_group_tests(tests, NULL, NULL);
@@ -23,6 +23,12 @@ if(ROARING_DISABLE_AVX)
    # we can manually disable AVX by defining DISABLEAVX
    set (OPT_FLAGS "${OPT_FLAGS} -DROARING_DISABLE_AVX" )
  endif()
+if(ROARING_DISABLE_AVX512)
+   set (OPT_FLAGS "${OPT_FLAGS} -DROARING_DISABLE_AVX512" )
+endif()
+if(ROARING_DISABLE_THREADS)
+  set (OPT_FLAGS "${OPT_FLAGS} -DROARING_DISABLE_THREADS" )
+endif()
 if(ROARING_DISABLE_NEON)
   set (OPT_FLAGS "${OPT_FLAGS} -DDISABLENEON" )
 endif()